@@ -0,0 +1,105 @@
+#ifndef BLOCK_DESCRIPTORS_HPP
+#define BLOCK_DESCRIPTORS_HPP
+
+#include <vector>
+#include "CellHistograms.hpp"
+
+/// @file
+/// @brief Interface for the block normalization stage of the HOG extractor
+
+/// @brief Normalized, overlapping blocks of cell histograms.
+///
+/// A block is a rectangle of blockCellsX by blockCellsY cells. Blocks are
+/// placed every strideCellsX cells horizontally and strideCellsY cells
+/// vertically, starting at the top left cell, so with a stride of half a
+/// block (the layout used by Dalal and Triggs) every interior cell
+/// contributes to four blocks. The cell histograms are computed once by
+/// CellHistograms and are only copied into each block that contains them.
+///
+/// The descriptor of a block is the concatenation of the histograms of its
+/// cells, row by row, followed by the normalization of the whole block.
+/// The descriptor of an image is the concatenation of its block
+/// descriptors, row by row.
+class BlockDescriptors
+{
+public:
+  /// How the descriptor of a block is normalized
+  enum Normalization
+  {
+    /// v / sqrt(|v|_2^2 + e^2)
+    L2,
+    /// L2 followed by clipping at L2_HYS_CLIP and renormalizing
+    L2_HYS,
+    /// sqrt(v / (|v|_1 + e))
+    L1_SQRT
+  };
+
+  /// @brief Constructor
+  /// @param blockCellsX
+  ///        Width of a block in cells
+  /// @param blockCellsY
+  ///        Height of a block in cells
+  /// @param strideCellsX
+  ///        Horizontal distance between neighbouring blocks in cells
+  /// @param strideCellsY
+  ///        Vertical distance between neighbouring blocks in cells
+  /// @param normalization
+  ///        How each block is normalized
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if a block size or stride is not positive.
+  BlockDescriptors(int blockCellsX, int blockCellsY, int strideCellsX, int strideCellsY, Normalization normalization);
+
+  /// @brief Compute the descriptor of an image
+  /// @param cells
+  ///        The histograms of all cells of the image
+  /// @param descriptors
+  ///        Receives blocksX() * blocksY() * blockLength() values
+  void compute(const CellHistograms& cells, std::vector<float>& descriptors) const;
+
+  /// @brief Returns the number of blocks in the horizontal direction
+  /// @param cells
+  ///        The histograms of all cells of an image
+  int blocksX(const CellHistograms& cells) const;
+
+  /// @brief Returns the number of blocks in the vertical direction
+  /// @param cells
+  ///        The histograms of all cells of an image
+  int blocksY(const CellHistograms& cells) const;
+
+  /// @brief Returns the number of values in the descriptor of one block
+  /// @param cells
+  ///        The histograms of all cells of an image
+  int blockLength(const CellHistograms& cells) const;
+
+  /// @brief Normalize the descriptor of a single block in place
+  /// @param block
+  ///        The concatenated cell histograms of the block
+  /// @param length
+  ///        The number of values in the block
+  void normalize(float* block, int length) const;
+
+  /// Largest value of an L2 normalized block before renormalizing for L2-Hys
+  static const float L2_HYS_CLIP;
+
+  /// Regularization added to the norm so empty blocks stay finite
+  static const float EPSILON;
+
+private:
+  /// Width of a block in cells
+  int blockCellsX;
+
+  /// Height of a block in cells
+  int blockCellsY;
+
+  /// Horizontal distance between neighbouring blocks in cells
+  int strideCellsX;
+
+  /// Vertical distance between neighbouring blocks in cells
+  int strideCellsY;
+
+  /// How each block is normalized
+  Normalization normalization;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <pthread.h>
+#include <deque>
+#include <stdexcept>
+
+/// @file
+/// @brief Blocking first in, first out queue with a fixed capacity
+
+/// @brief Thread safe first in, first out queue with a fixed capacity.
+///
+/// The queue connects the stages of a pipeline. A producer blocks while
+/// the queue is full, so a fast stage cannot run ahead of a slow one and
+/// the number of items in flight stays bounded. A consumer blocks while
+/// the queue is empty.
+///
+/// Closing the queue wakes every waiting thread. No more items are
+/// accepted after it is closed, but the items already queued can still be
+/// taken out, so consumers keep popping until pop returns false.
+template <class T>
+class BoundedQueue
+{
+public:
+  /// @brief Constructor
+  /// @param capacity
+  ///        The largest number of items held by the queue
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if capacity is 0.
+  explicit BoundedQueue(size_t capacity)
+  : maxItems(capacity), closed(false)
+  {
+    if (capacity == 0)
+    {
+      throw std::invalid_argument("Queue capacity must be positive");
+    }
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&notFull, NULL);
+    pthread_cond_init(&notEmpty, NULL);
+  }
+
+  /// Destructor
+  ~BoundedQueue()
+  {
+    pthread_cond_destroy(&notEmpty);
+    pthread_cond_destroy(&notFull);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  /// Returns the largest number of items held by the queue
+  size_t capacity() const { return maxItems; }
+
+  /// @brief Add an item, waiting while the queue is full
+  /// @param item
+  ///        The item to add
+  ///
+  /// Returns false, without adding the item, if the queue is closed.
+  bool push(const T& item)
+  {
+    pthread_mutex_lock(&mutex);
+    while (!closed && (items.size() >= maxItems))
+    {
+      pthread_cond_wait(&notFull, &mutex);
+    }
+
+    if (closed)
+    {
+      pthread_mutex_unlock(&mutex);
+      return false;
+    }
+
+    items.push_back(item);
+    pthread_cond_signal(&notEmpty);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  /// @brief Take the oldest item, waiting while the queue is empty
+  /// @param item
+  ///        Receives the item
+  ///
+  /// Returns false once the queue is closed and empty.
+  bool pop(T& item)
+  {
+    pthread_mutex_lock(&mutex);
+    while (!closed && items.empty())
+    {
+      pthread_cond_wait(&notEmpty, &mutex);
+    }
+
+    if (items.empty())
+    {
+      pthread_mutex_unlock(&mutex);
+      return false;
+    }
+
+    item = items.front();
+    items.pop_front();
+    pthread_cond_signal(&notFull);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  /// @brief Take the oldest item if there is one, without waiting
+  /// @param item
+  ///        Receives the item
+  ///
+  /// Returns false if the queue is empty.
+  bool tryPop(T& item)
+  {
+    pthread_mutex_lock(&mutex);
+    if (items.empty())
+    {
+      pthread_mutex_unlock(&mutex);
+      return false;
+    }
+
+    item = items.front();
+    items.pop_front();
+    pthread_cond_signal(&notFull);
+    pthread_mutex_unlock(&mutex);
+    return true;
+  }
+
+  /// @brief Stop accepting items and wake every waiting thread
+  void close()
+  {
+    pthread_mutex_lock(&mutex);
+    closed = true;
+    pthread_cond_broadcast(&notFull);
+    pthread_cond_broadcast(&notEmpty);
+    pthread_mutex_unlock(&mutex);
+  }
+
+private:
+  /// The queued items, oldest first
+  std::deque<T> items;
+
+  /// The largest number of items held by the queue
+  size_t maxItems;
+
+  /// Set once the queue no longer accepts items
+  bool closed;
+
+  /// Protects the items and the closed flag
+  pthread_mutex_t mutex;
+
+  /// Signalled when an item is taken out or the queue is closed
+  pthread_cond_t notFull;
+
+  /// Signalled when an item is added or the queue is closed
+  pthread_cond_t notEmpty;
+
+  /// Not copyable
+  BoundedQueue(const BoundedQueue&);
+
+  /// Not assignable
+  BoundedQueue& operator=(const BoundedQueue&);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef CELL_HISTOGRAMS_HPP
+#define CELL_HISTOGRAMS_HPP
+
+#include <vector>
+#include "opencv2/core/core.hpp"
+
+/// @file
+/// @brief Interface for the cell histogram stage of the HOG extractor
+
+/// @brief Orientation histograms of every cell of an image.
+///
+/// The image is divided into a grid of cellSizeX by cellSizeY pixel cells,
+/// starting at the top left corner. Pixels to the right of or below the
+/// last complete cell are ignored. All histograms are computed in one sweep
+/// over the gradient planes and stored as a structure of arrays: one plane
+/// of cellsY() x cellsX() values per orientation bin.
+///
+/// Votes are weighted by the gradient magnitude and are either cast into
+/// the single bin and cell containing the pixel (hard binning) or shared
+/// between the two nearest orientation bins and the four nearest cell
+/// centres (trilinear interpolation, as described by Dalal and Triggs).
+class CellHistograms
+{
+public:
+  /// How the votes of a pixel are distributed
+  enum Interpolation
+  {
+    /// Vote into the bin and cell that contain the pixel
+    HARD,
+    /// Interpolate the vote in orientation and in both spatial directions
+    TRILINEAR
+  };
+
+  /// Default constructor. The histograms are empty until compute is called.
+  CellHistograms();
+
+  /// @brief Compute the histograms of all cells of an image
+  /// @param gradMag
+  ///        CV_32F matrix of gradient magnitudes
+  /// @param gradOrient
+  ///        Either a CV_8U matrix of orientation bin indices (hard binning
+  ///        only) or a CV_32F matrix of unsigned orientations in degrees
+  /// @param cellSizeX
+  ///        Width of a cell in pixels
+  /// @param cellSizeY
+  ///        Height of a cell in pixels
+  /// @param nbins
+  ///        The number of orientation bins evenly spanning [0,180) degrees
+  /// @param interpolation
+  ///        How the votes of a pixel are distributed
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the matrices do not match in size or type, if the cell size
+  /// or number of bins is not positive, or if trilinear interpolation is
+  /// requested with orientation bin indices.
+  void compute(const cv::Mat& gradMag, const cv::Mat& gradOrient, int cellSizeX, int cellSizeY, int nbins, Interpolation interpolation);
+
+  /// Returns the number of cells in the horizontal direction
+  int cellsX() const { return numCellsX; }
+
+  /// Returns the number of cells in the vertical direction
+  int cellsY() const { return numCellsY; }
+
+  /// Returns the number of orientation bins
+  int bins() const { return numBins; }
+
+  /// @brief Returns the plane of a single orientation bin
+  /// @param bin
+  ///        The orientation bin
+  ///
+  /// The plane holds cellsY() rows of cellsX() values.
+  const float* plane(int bin) const
+  {
+    return &data[(size_t) bin * numCellsY * numCellsX];
+  }
+
+  /// @brief Returns the value of a single bin of a cell
+  /// @param cellY
+  ///        Row of the cell
+  /// @param cellX
+  ///        Column of the cell
+  /// @param bin
+  ///        The orientation bin
+  float value(int cellY, int cellX, int bin) const
+  {
+    return plane(bin)[cellY * numCellsX + cellX];
+  }
+
+  /// @brief Copy the histogram of a cell
+  /// @param cellY
+  ///        Row of the cell
+  /// @param cellX
+  ///        Column of the cell
+  /// @param histogram
+  ///        Receives bins() values
+  void histogram(int cellY, int cellX, float* histogram) const;
+
+private:
+  /// @brief Accumulate hard votes given orientation bin indices or
+  /// orientations in degrees
+  void accumulateHard(const cv::Mat& gradMag, const cv::Mat& gradOrient, int cellSizeX, int cellSizeY);
+
+  /// @brief Accumulate trilinear votes given orientations in degrees
+  void accumulateTrilinear(const cv::Mat& gradMag, const cv::Mat& gradOrient, int cellSizeX, int cellSizeY);
+
+  /// @brief Add per bin column sums of a band of rows into the bin planes
+  void collapseColumns(const std::vector<float>& columns, int cellY, int cellSizeX);
+
+  /// Number of cells in the horizontal direction
+  int numCellsX;
+
+  /// Number of cells in the vertical direction
+  int numCellsY;
+
+  /// Number of orientation bins
+  int numBins;
+
+  /// The bin planes, one after another
+  std::vector<float> data;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#ifndef DESCRIPTOR_CACHE_HPP
+#define DESCRIPTOR_CACHE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <mutex.hpp>
+
+/// @file
+/// @brief Interface for the persistent cache of image descriptors
+
+/// @brief Persistent cache of the descriptors of images.
+///
+/// The descriptors of an image are stored under a key made of a hash of
+/// the bytes of the image file, the size of the file and a hash of the
+/// settings used to extract them. An image whose contents and extraction
+/// settings have not changed is found again without decoding it, under
+/// any file name.
+///
+/// The cache is a single file of records that are only ever appended. When
+/// the cache is opened, the existing records are mapped into memory and
+/// indexed; a record cut short by an interrupted write is dropped. Records
+/// added while the cache is open are written to the end of the file.
+///
+/// Lookups and insertions may be made from several threads at once. The
+/// file must not be shared with another process writing to it.
+class DescriptorCache
+{
+public:
+  /// @brief Identifies the descriptors of one image
+  struct Key
+  {
+    /// FNV-1a hash of the bytes of the image file
+    uint64_t contentHash;
+
+    /// Size of the image file in bytes
+    uint64_t fileSize;
+
+    /// Hash of the settings used to extract the descriptors
+    uint64_t configHash;
+
+    /// Orders keys so they can be indexed
+    bool operator<(const Key& other) const
+    {
+      if (contentHash != other.contentHash)
+        return contentHash < other.contentHash;
+      if (fileSize != other.fileSize)
+        return fileSize < other.fileSize;
+      return configHash < other.configHash;
+    }
+  };
+
+  /// @brief Open a cache file, creating it if it does not exist
+  /// @param path
+  ///        Full or relative path to the cache file
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the file cannot be opened or created, or if it is not a
+  /// descriptor cache.
+  explicit DescriptorCache(const std::string& path);
+
+  /// Destructor. Unmaps and closes the cache file.
+  ~DescriptorCache();
+
+  /// Returns the path of the cache file
+  const std::string& path() const { return filePath; }
+
+  /// Returns the number of cached images
+  size_t size();
+
+  /// @brief Build the key of an image
+  /// @param fileBytes
+  ///        The contents of the image file
+  /// @param length
+  ///        The number of bytes in the file
+  /// @param configHash
+  ///        Hash of the settings used to extract the descriptors
+  static Key makeKey(const void* fileBytes, size_t length, uint64_t configHash);
+
+  /// @brief 64 bit FNV-1a hash
+  /// @param data
+  ///        The bytes to hash
+  /// @param length
+  ///        The number of bytes
+  /// @param seed
+  ///        Hash of the preceding bytes, to hash data in pieces
+  static uint64_t hash(const void* data, size_t length, uint64_t seed = FNV_OFFSET_BASIS);
+
+  /// @brief Look up the descriptors of an image
+  /// @param key
+  ///        The key of the image
+  /// @param descriptors
+  ///        Receives the descriptors if they are cached
+  ///
+  /// Returns true if the descriptors were found.
+  bool lookup(const Key& key, std::vector<float>& descriptors);
+
+  /// @brief Add the descriptors of an image
+  /// @param key
+  ///        The key of the image
+  /// @param descriptors
+  ///        The descriptors of the image
+  ///
+  /// Does nothing if the key is already cached. The cache only speeds up
+  /// extraction, so a failed write is not an error: the descriptors are
+  /// simply not cached and false is returned.
+  bool insert(const Key& key, const std::vector<float>& descriptors);
+
+  /// Offset basis of the 64 bit FNV-1a hash
+  static const uint64_t FNV_OFFSET_BASIS;
+
+  /// Prime of the 64 bit FNV-1a hash
+  static const uint64_t FNV_PRIME;
+
+private:
+  /// @brief Where the descriptors of a key are stored
+  struct Location
+  {
+    /// Offset of the first descriptor value in the file
+    uint64_t offset;
+
+    /// Number of descriptor values
+    uint32_t count;
+  };
+
+  /// Index the records of the mapped part of the file
+  void indexRecords();
+
+  /// Path of the cache file
+  std::string filePath;
+
+  /// Descriptor of the cache file
+  int fd;
+
+  /// The file as it was when the cache was opened, or NULL
+  const unsigned char* mapped;
+
+  /// Number of bytes mapped
+  size_t mappedLength;
+
+  /// Offset at which the next record is written
+  uint64_t fileEnd;
+
+  /// Location of the descriptors of every cached image
+  std::map<Key, Location> index;
+
+  /// Protects the index and the end of the file
+  Mutex cacheMutex;
+
+  /// Not copyable
+  DescriptorCache(const DescriptorCache&);
+
+  /// Not assignable
+  DescriptorCache& operator=(const DescriptorCache&);
+};
+
+#endif
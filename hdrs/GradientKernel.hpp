@@ -0,0 +1,120 @@
+#ifndef GRADIENT_KERNEL_HPP
+#define GRADIENT_KERNEL_HPP
+
+#include "opencv2/core/core.hpp"
+
+/// @file
+/// @brief Interface for the fused gradient kernel used by the HOG extractor
+
+/// @brief Single pass gradient computation for 8-bit images.
+///
+/// The kernel reads an interleaved 8-bit BGR (or single channel) image
+/// once. For every pixel it applies the centered [-1,0,1] derivative in
+/// the horizontal and vertical direction to each channel, keeps the
+/// channel with the largest gradient magnitude and writes the magnitude
+/// and the unsigned orientation of that channel.
+///
+/// Pixels outside the image are reflected (the 101 border used by
+/// cv::filter2D), so the derivatives along the image border are 0.
+///
+/// The derivatives, magnitude and orientation are computed with SSE2 when
+/// available and with an equivalent scalar loop otherwise.
+class GradientKernel
+{
+public:
+  /// @brief Determine the gradient magnitudes and orientations for an image
+  /// @param image
+  ///        A CV_8UC3 or CV_8UC1 matrix of pixel values
+  /// @param gradMag
+  ///        CV_32F matrix of gradient magnitudes, the size of the image
+  /// @param gradOrient
+  ///        CV_32F matrix of gradient orientations in degrees, in the
+  ///        range [0,180], the size of the image
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the image is empty or is not an 8-bit 1 or 3 channel image.
+  static void compute(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradOrient);
+
+  /// @brief Determine the gradient magnitudes and orientation bins for an
+  /// image
+  /// @param image
+  ///        A CV_8UC3 or CV_8UC1 matrix of pixel values
+  /// @param gradMag
+  ///        CV_32F matrix of gradient magnitudes, the size of the image
+  /// @param gradBin
+  ///        CV_8U matrix of orientation bin indices, the size of the image
+  /// @param nbins
+  ///        The number of orientation bins evenly spanning [0,180) degrees
+  ///
+  /// Instead of an angle, the orientation of each pixel is reported as the
+  /// index of the bin that contains it. The bin is found without any
+  /// trigonometry: the gradient is mirrored into the upper half plane and
+  /// compared against the nbins-1 bin boundaries with a cross product, so
+  /// the bin index is the number of boundaries the gradient lies past.
+  /// Pixels without a gradient are assigned to bin 0.
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the image is empty or is not an 8-bit 1 or 3 channel image,
+  /// or if nbins is not in the range [1,255].
+  static void computeBinned(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradBin, int nbins);
+
+private:
+  /// @brief Check that an image can be handled by the kernel
+  /// @param image
+  ///        The image to check
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the image is empty or is not an 8-bit 1 or 3 channel image.
+  static void checkImage(const cv::Mat& image);
+
+  /// @brief Compute the derivatives of the strongest channel for one row
+  /// @param prev
+  ///        The row above the current row (reflected at the border)
+  /// @param cur
+  ///        The current row
+  /// @param next
+  ///        The row below the current row (reflected at the border)
+  /// @param cols
+  ///        The number of pixels in a row
+  /// @param channels
+  ///        The number of interleaved channels in a row
+  /// @param gradX
+  ///        Horizontal derivative of the strongest channel of each pixel
+  /// @param gradY
+  ///        Vertical derivative of the strongest channel of each pixel
+  static void rowDerivatives(const uchar* prev, const uchar* cur, const uchar* next, int cols, int channels, float* gradX, float* gradY);
+
+  /// @brief Convert one row of derivatives to magnitudes and orientations
+  /// @param gradX
+  ///        Horizontal derivatives
+  /// @param gradY
+  ///        Vertical derivatives
+  /// @param cols
+  ///        The number of values in the row
+  /// @param mag
+  ///        The gradient magnitudes
+  /// @param orient
+  ///        The unsigned gradient orientations in degrees
+  static void rowMagnitudeOrientation(const float* gradX, const float* gradY, int cols, float* mag, float* orient);
+
+  /// @brief Convert one row of derivatives to magnitudes and orientation bins
+  /// @param gradX
+  ///        Horizontal derivatives
+  /// @param gradY
+  ///        Vertical derivatives
+  /// @param cols
+  ///        The number of values in the row
+  /// @param boundaryCos
+  ///        Cosines of the nbins-1 inner bin boundaries
+  /// @param boundarySin
+  ///        Sines of the nbins-1 inner bin boundaries
+  /// @param nbins
+  ///        The number of orientation bins
+  /// @param mag
+  ///        The gradient magnitudes
+  /// @param bin
+  ///        The orientation bin indices
+  static void rowMagnitudeBin(const float* gradX, const float* gradY, int cols, const float* boundaryCos, const float* boundarySin, int nbins, float* mag, uchar* bin);
+};
+
+#endif
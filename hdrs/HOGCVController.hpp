@@ -2,10 +2,16 @@
 #define HOGCV_CONTROLLER_H
 
 #include <string>
+#include <vector>
+#include <stdint.h>
 #include "objdetect/objdetect.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 #include "svm.h"
+#include "IntegralHistogram.hpp"
+
+class ThreadPool;
+class DescriptorCache;
 
 /// @file
 /// @brief Interface for the applications main controlling class 
@@ -63,6 +69,39 @@ public:
   /// change training and model parameters is implemented.
   void train(std::vector<std::string> fileNames, std::vector<int> labels); 
 
+  /// @brief Search a grid of SVM parameters and train the best model
+  /// @param fileNames 
+  ///        Vector of full or relative paths to image files
+  /// @param labels    
+  ///        Vector of labels indicating if a person is in the image or not.
+  /// @param cValues
+  ///        Values of C to try, or none to keep the one of the Parameters
+  /// @param gammaValues
+  ///        Values of gamma to try, or none to keep the one train uses
+  /// @param nuValues
+  ///        Values of nu to try, or none to keep the one of the Parameters
+  /// @param numFolds
+  ///        Number of folds each point of the grid is cross validated on
+  /// @param scores
+  ///        Receives the cross validation accuracy of each point, C varying
+  ///        fastest, then gamma, then nu
+  ///
+  /// The images are extracted as for train. Every point of the grid is then
+  /// cross validated on folds drawn from GRID_SEARCH_SEED with
+  /// svm_grid_search_on, which runs the points at once on as many threads
+  /// of the extraction pool as set in the Parameters and starts each C_SVC
+  /// solve from the solution for the previous C. When a
+  /// single gamma is tried, the folds read one kernel of the cv cache size
+  /// of the Parameters. The model is trained on every image with the best
+  /// point, whose parameters are kept.
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if numFolds is less than 2, or for the same reasons as train
+  ///
+  /// @exception std::logic_error
+  /// Thrown if the parameters of a point of the grid are not valid.
+  void gridSearch(const std::vector<std::string>& fileNames, const std::vector<int>& labels, const std::vector<double>& cValues, const std::vector<double>& gammaValues, const std::vector<double>& nuValues, int numFolds, std::vector<double>& scores);
+
   ///  @brief Predict the labels for a set of images based on a trained SVM 
   ///  model.
   /// @param fileNames 
@@ -91,6 +130,48 @@ public:
   /// Thrown if the method is called but a model has not been trained.
   void classify(const std::vector<std::string>& fileNames, const std::vector<int>& actualLabels, float& percentageCorrect, std::vector<int>& predictedLabels);
 
+  /// @brief Build the integral orientation histograms of an image
+  /// @param image
+  ///        A matrix of pixel values for an image
+  /// @param integral
+  ///        Receives the integral histograms of the image
+  ///
+  /// The gradients are computed the same way as for training and
+  /// classifying. The histogram of any rectangle of the image can then be
+  /// queried from the integral in constant time.
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the image is empty or is not an 8-bit 1 or 3 channel image.
+  void buildIntegralHistogram(const cv::Mat& image, IntegralHistogram& integral);
+
+  /// @brief Keep the descriptors of the images in a cache file
+  /// @param path
+  ///        Full or relative path to the cache file, or an empty string to
+  ///        stop using a cache
+  ///
+  /// The descriptors of every image trained or classified are stored in
+  /// the file, keyed by the contents of the image file and the extraction
+  /// settings. An image found in the cache is neither decoded nor
+  /// extracted again, even after the application is restarted.
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the file cannot be opened or created, or if it is not a
+  /// descriptor cache. The previous cache is kept.
+  void setDescriptorCache(const std::string& path);
+
+  /// @brief Predict the labels of several images from their descriptors
+  /// @param descriptors
+  ///        The descriptors of each image, as retrieved for training
+  /// @param predictedLabels
+  ///        Receives the predicted label of each image
+  ///
+  /// The images are predicted together with svm_predict_batch, which
+  /// reuses the support vectors while they are in cache.
+  ///
+  /// @exception std::logic_error
+  /// Thrown if a model has not been trained.
+  void predictBatch(const std::vector<std::vector<float> >& descriptors, std::vector<int>& predictedLabels);
+
   /// @brief Frees any data allocated to an SVM model
   void freeModelContent();
 
@@ -114,6 +195,14 @@ protected:
   /// The SVM model
   struct svm_model *model;               
 
+  /// The nodes of every row of the problem, stored back to back in one
+  /// block so the problem is allocated and freed at once
+  struct svm_node *problemNodes;
+
+  /// Offset of each row of the problem in problemNodes, followed by the
+  /// total number of nodes
+  std::vector<size_t> problemOffsets;
+
   /// Default constructor
   HOGCVController();
 
@@ -122,100 +211,210 @@ protected:
 
 private:
 
+  /// Number of orientation bins spanning [0,180) degrees in a histogram
+  static const int ORIENTATION_BINS;
+
+  /// Width and height of a cell in pixels
+  static const int CELL_SIZE;
+
+  /// Width and height of a block in cells
+  static const int BLOCK_SIZE;
+
+  /// Seed the folds of a grid search are drawn from, so searching the same
+  /// images always scores the points on the same folds
+  static const unsigned int GRID_SEARCH_SEED;
+
+  /// Threads used to extract descriptors, created on first use, and
+  /// passed to each libsvm call that trains a model
+  ThreadPool* pool;
+
+  /// Cache of the descriptors of previously extracted images, or NULL
+  DescriptorCache* cache;
+
+  /// @brief Returns a hash of the settings used to extract descriptors
+  ///
+  /// Descriptors cached with different settings are never returned.
+  static uint64_t configHash();
+
+  /// @brief The images of a parallel extraction and the results for each
+  /// of them, stored at the index of the image's file name
+  struct ExtractionJob
+  {
+    /// @brief Constructor
+    /// @param controller
+    ///        The controller extracting the descriptors
+    /// @param fileNames
+    ///        Full or relative paths to the images
+    /// @param model
+    ///        Model used to predict a label for each image, or NULL to keep
+    ///        the descriptors of each image instead
+    ExtractionJob(HOGCVController* controller, const std::vector<std::string>& fileNames, const struct svm_model* model);
+
+    /// The controller extracting the descriptors
+    HOGCVController* controller;
+
+    /// Full or relative paths to the images
+    const std::vector<std::string>& fileNames;
+
+    /// Model used to predict the labels, or NULL
+    const struct svm_model* model;
+
+    /// Sparse descriptors of each image when no model is given
+    std::vector<struct svm_node*> nodes;
+
+    /// Number of descriptor values of each image, including zeros
+    std::vector<size_t> featureCounts;
+
+    /// Predicted label of each image when a model is given
+    std::vector<double> predictions;
+
+    /// True to build dense rows instead of sparse nodes
+    bool dense;
+  };
+
   /// Free memory allocated for the svm_problem struct
   void cleanUpSvmModel();
 
+  /// @brief Build the problem and the parameters used to train a model
+  /// @param fileNames
+  ///        Vector of full or relative paths to image files
+  /// @param labels
+  ///        Vector of labels indicating if a person is in the image or not
+  ///
+  /// The descriptors of every image are extracted before the current
+  /// problem is freed, so the previous model is kept if an image cannot be
+  /// read. The parameters are taken from the Parameters, except for gamma
+  /// which is one over the largest number of features of an image.
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if no filenames or labels are supplied, an invalid file name or 
+  /// label is given or if the number of file names and labels are not equal
+  void buildProblem(const std::vector<std::string>& fileNames, const std::vector<int>& labels);
+
+  /// @brief Move the rows of a job into the problem
+  /// @param job
+  ///        A finished training job; its rows are freed
+  ///
+  /// The rows are copied into problemNodes, one after the other, and
+  /// problem.x points at each of them.
+  void packProblemRows(ExtractionJob& job);
+
+  /// @brief Returns the number of nodes of a row, including the last one
+  /// @param row
+  ///        A sparse or dense row ending with a node of index -1
+  static size_t rowNodes(const struct svm_node* row);
+
+  /// @brief Check that every label is a valid label
+  /// @param labels
+  ///        Labels indicating if a person is in an image or not
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if a label is neither PERSON_IN_IMAGE nor NO_PERSON_IN_IMAGE.
+  static void validateLabels(const std::vector<int>& labels);
+
+  /// @brief Returns the thread pool, with a thread for every decoding,
+  /// extracting and predicting worker set in the Parameters
+  ///
+  /// The pool is only made again when those numbers change, so training
+  /// and classifying share it.
+  ThreadPool* threadPool();
+
+  /// @brief Extract the descriptors of all images of a job
+  /// @param job
+  ///        The images and the results for each of them
+  ///
+  /// The images run through a pipeline of three stages connected by
+  /// bounded queues: decoding the files, extracting the descriptors and,
+  /// when the job has a model, predicting the labels. Each stage has its
+  /// own number of threads, set in the Parameters, so reading files
+  /// overlaps with computing descriptors and the number of images in
+  /// memory is capped by the queue capacity.
+  ///
+  /// Each file is decoded exactly once, which also checks that it can be
+  /// read. If an image fails, the pipeline stops and the descriptors of the
+  /// other images are freed.
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if a file cannot be read using the OpenCV2 library.
+  ///
+  /// @exception std::runtime_error
+  /// Thrown if the descriptors of an image cannot be extracted.
+  void extractDescriptors(ExtractionJob& job);
+
+  /// The state of a running extraction pipeline
+  struct Pipeline;
+
+  /// @brief Run one worker of an extraction pipeline
+  /// @param pipeline
+  ///        The Pipeline
+  /// @param worker
+  ///        Index of the worker; the decoding workers come first, then the
+  ///        extracting and the predicting workers
+  static void runStage(void* pipeline, int worker);
+
+  /// @brief Decode image files until every file is claimed
+  ///
+  /// With a descriptor cache, the file is read once to build its key and
+  /// is only decoded if its descriptors are not cached.
+  /// @param pipeline
+  ///        The running pipeline
+  static void decodeStage(Pipeline& pipeline);
+
+  /// @brief Extract the descriptors of decoded images until the decoders
+  /// are done
+  /// @param pipeline
+  ///        The running pipeline
+  static void extractStage(Pipeline& pipeline);
+
+  /// @brief Predict the labels of extracted images until the extractors
+  /// are done
+  /// @param pipeline
+  ///        The running pipeline
+  ///
+  /// The images waiting in the queue are predicted together, up to
+  /// PREDICT_BATCH_SIZE at a time.
+  static void predictStage(Pipeline& pipeline);
+
+  /// Largest number of images predicted by one call to svm_predict_batch
+  static const int PREDICT_BATCH_SIZE;
+
+  /// @brief Build an svm_node vector from descriptor values
+  /// @param descriptorValues
+  ///        The descriptors of an image
+  /// @param dense
+  ///        True to build a dense row holding every value as a float
+  ///
+  /// Returns an array allocated with new[]. A sparse vector holds the
+  /// nonzero values and is terminated by a node with index -1; a dense row
+  /// is built with svm_fill_dense_row.
+  static struct svm_node* buildNodes(const std::vector<float>& descriptorValues, bool dense);
+
   /// @brief Retrieve descriptors for an image
   /// @param image 
   ///        A matrix of pixel values for an image
   /// @param allDescriptorValues 
   ///        The descriptors related to the image
   /// @param blockSizeX 
-  ///        The number of blocks to break the image into in the horizontal 
-  ///        direction
+  ///        The width of a block in cells
   /// @param blockSizeY 
-  ///        The number of blocks to break the image into in the vertical 
-  ///        direction
+  ///        The height of a block in cells
   /// @param cellSizeX 
-  ///        The number of cells to break each block into in the horizontal 
-  ///        direction
-  /// @param cellSizeY The number of cells to break each block into in the 
-  ///        vertical direction
-  void retrieveDescriptors(cv::Mat image,std::vector<float> &allDescriptorValues,int blockSizeX, int blockSizeY, int cellSizeX, int cellSizeY);
-
-  /// @brief Retrieve descriptors from a block in an image
-  /// @param gradMag 
-  ///        A matrix of pixel gradients magnitudes for an image 
-  /// @param gradOrient 
-  ///        A matrix of pixel gradient orientations for an image 
-  /// @param allCellDescriptorValues 
-  ///        Descriptors for each cell in the block
-  /// @param startX 
-  ///        The horizontal pixel location in the gradient and orientation 
-  ///        matrices to start using when determining the descriptors
-  /// @param startY 
-  ///        The vertical pixel location in the gradient and orientation 
-  ///        matrices to start using when determining the descriptors
-  /// @param blockSizeX 
-  ///        The number of blocks to break the image into in the horizontal 
-  ///        direction
-  /// @param blockSizeY 
-  ///        The number of blocks to break the image into in the vertical 
-  ///        direction
-  /// @param cellSizeX 
-  ///        The number of cells to break each block into in the horizontal 
-  ///        direction
+  ///        The width of a cell in pixels
   /// @param cellSizeY 
-  ///        The number of cells to break each block into in the vertical 
-  ///        direction
-  void retrieveDescriptorsFromBlock(cv::Mat gradMag, cv::Mat gradOrient,std::vector<float> &allCellDescriptorValues,int startX, int startY, int blockSizeX, int blockSizeY, int cellSizeX, int cellSizeY);
+  ///        The height of a cell in pixels
+  ///
+  /// Blocks overlap by half their size and are L2-Hys normalized.
+  void retrieveDescriptors(cv::Mat image,std::vector<float> &allDescriptorValues,int blockSizeX, int blockSizeY, int cellSizeX, int cellSizeY);
 
-  /// @brief Retrieve descriptors from a cell
-  /// @param gradMag 
-  ///        A matrix of pixel gradient magnitudes for an image
-  /// @param gradOrient 
-  ///        A matrix of pixel gradient orientations for an image
-  /// @param cellDescriptorValues 
-  ///        Descriptors for a given cell
-  /// @param startX 
-  ///        The horizontal pixel location in the gradient and orientation matrices to start using when determining the descriptors
-  /// @param startY 
-  ///        The vertical pixel location in the gradient and orientation 
-  ///        matrices to start using when determining the descriptors
-  /// @param cellSizeX 
-  ///        The number of cells to break each block into in the horizontal 
-  ///        direction
-  /// @param cellSizeY 
-  ///        The number of cells to break each block into in the vertical 
-  ///        direction
-  void retrieveDescriptorsFromCell(cv::Mat gradMag, cv::Mat gradOrient, std::vector<float> &cellDescriptorValues, int startX, int startY, int cellSizeX, int cellSizeY);
-
-  /// @brief Given two matrices of the gradient magnitudes in the x and y directions for an image, determine the overall gradient magnitudes.
-  /// @param gradX 
-  ///        A matrix of gradient magnitudes in the x direction 
-  /// @param gradY 
-  ///        A matrix of gradient magnitudes in the y direction 
-  /// @param gradMagnitude 
-  ///        A matrix of the overall gradient magnitudes 
-  void calculateGradMagnitude(const cv::Mat& gradX, const cv::Mat& gradY, cv::Mat& gradMagnitude);
-
-  /// @brief Given two matrices of the gradient orientations in the x and y directions for an image, determine the overall gradient orientations.
-  /// @param gradX 
-  ///        A matrix of gradient orientations in the x direction 
-  /// @param gradY 
-  ///        A matrix of gradient orientations in the y direction 
-  /// @param gradMagnitude 
-  ///        A matrix of the overall gradient magnitudes 
-  void calculateGradOrientation(const cv::Mat& gradX, const cv::Mat& gradY, cv::Mat& gradOrientation);
-
-  /// @brief Determine the gradient magnitudes and orientations for an image
+  /// @brief Determine the gradient magnitudes and orientation bins for an 
+  /// image
   /// @param image 
   ///        A matrix of pixel values for an image
   /// @param gradMag 
   ///        Gradient magnitudes for an image
-  /// @param gradOrient 
-  ///        Gradient orientations for an image
-  void calculateGradients(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradOrient);
+  /// @param gradBin 
+  ///        Index of the orientation bin of each pixel gradient (CV_8U)
+  void calculateGradients(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradBin);
 };
 #endif
 
@@ -0,0 +1,75 @@
+#ifndef INTEGRAL_HISTOGRAM_HPP
+#define INTEGRAL_HISTOGRAM_HPP
+
+#include <vector>
+#include "opencv2/core/core.hpp"
+
+/// @file
+/// @brief Interface for integral orientation histograms
+
+/// @brief Per bin integral images of the gradient magnitudes of an image.
+///
+/// Entry (i,j,b) holds the sum of the magnitudes of all pixels above and
+/// to the left of pixel (i,j) whose orientation falls into bin b. The
+/// orientation histogram of any rectangle of the image is then found with
+/// four lookups per bin, independent of the size of the rectangle, so one
+/// image can be queried many times for overlapping cells, blocks or regions
+/// of interest.
+///
+/// The sums are kept in double precision so that large images do not lose
+/// the contribution of small regions, and the bins of an entry are stored
+/// next to each other so a query reads four contiguous runs of values.
+class IntegralHistogram
+{
+public:
+  /// Default constructor. The integral is empty until compute is called.
+  IntegralHistogram();
+
+  /// @brief Build the integral histograms of an image
+  /// @param gradMag
+  ///        CV_32F matrix of gradient magnitudes
+  /// @param gradOrient
+  ///        Either a CV_8U matrix of orientation bin indices or a CV_32F
+  ///        matrix of unsigned orientations in degrees
+  /// @param nbins
+  ///        The number of orientation bins evenly spanning [0,180) degrees
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the matrices do not match in size or type, or if nbins is
+  /// not in the range [1,255].
+  void compute(const cv::Mat& gradMag, const cv::Mat& gradOrient, int nbins);
+
+  /// Returns the number of rows of the image
+  int rows() const { return numRows; }
+
+  /// Returns the number of columns of the image
+  int cols() const { return numCols; }
+
+  /// Returns the number of orientation bins
+  int bins() const { return numBins; }
+
+  /// @brief Compute the orientation histogram of a rectangle
+  /// @param region
+  ///        The rectangle in pixel coordinates
+  /// @param histogram
+  ///        Receives bins() values
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if the rectangle does not lie inside the image.
+  void histogram(const cv::Rect& region, float* histogram) const;
+
+private:
+  /// Number of rows of the image
+  int numRows;
+
+  /// Number of columns of the image
+  int numCols;
+
+  /// Number of orientation bins
+  int numBins;
+
+  /// (rows+1) x (cols+1) entries of bins() sums each
+  std::vector<double> data;
+};
+
+#endif
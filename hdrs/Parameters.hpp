@@ -1,6 +1,7 @@
 #ifndef PARAMS_HPP
 #define PARAMS_HPP
 
+#include <unistd.h>
 #include <mutex.hpp>
 #include "svm.h"
 
@@ -140,6 +141,70 @@ public:
     paramsMutex.unlock();
   }
 
+  /// @brief Sets the number of threads used to extract image descriptors
+  /// @param newVal
+  ///        Number of threads, including the calling thread. Values below
+  ///        1 are treated as 1.
+  void setNumThreads(int newVal)
+  {
+    paramsMutex.lock();
+    numThreads = (newVal < 1) ? 1 : newVal;
+    paramsMutex.unlock();
+  }
+
+  /// @brief Sets the number of threads decoding image files
+  /// @param newVal
+  ///        Number of threads. Values below 1 are treated as 1.
+  void setDecodeThreads(int newVal)
+  {
+    paramsMutex.lock();
+    decodeThreads = (newVal < 1) ? 1 : newVal;
+    paramsMutex.unlock();
+  }
+
+  /// @brief Sets the number of threads predicting labels when classifying
+  /// @param newVal
+  ///        Number of threads. Values below 1 are treated as 1.
+  void setPredictThreads(int newVal)
+  {
+    paramsMutex.lock();
+    predictThreads = (newVal < 1) ? 1 : newVal;
+    paramsMutex.unlock();
+  }
+
+  /// @brief Sets the number of images that may wait between two stages of
+  /// the extraction pipeline
+  /// @param newVal
+  ///        Queue capacity. Values below 1 are treated as 1.
+  void setQueueCapacity(int newVal)
+  {
+    paramsMutex.lock();
+    queueCapacity = (newVal < 1) ? 1 : newVal;
+    paramsMutex.unlock();
+  }
+
+  /// @brief Sets whether image descriptors are given to the SVM as dense
+  /// rows of floats instead of sparse nodes
+  /// @param newVal
+  void setDenseFeatures(bool newVal)
+  {
+    paramsMutex.lock();
+    denseFeatures = newVal;
+    paramsMutex.unlock();
+  }
+
+  /// @brief Sets the size of the kernel shared by the folds of a grid
+  /// search, whose columns are computed once for all folds
+  /// @param newVal
+  ///        The unit of the new value is in Mbytes. 0 leaves each fold with
+  ///        its own cache only; values below 0 are treated as 0.
+  void setCvCacheSize(double newVal)
+  {
+    paramsMutex.lock();
+    cvCacheSize = (newVal < 0) ? 0 : newVal;
+    paramsMutex.unlock();
+  }
+
   /// @brief Returns the type of svm model to build
   int getSvmType()
   {
@@ -290,6 +355,69 @@ public:
     return retValue;
   } 
 
+  /// @brief Returns the number of threads used to extract image descriptors
+  int getNumThreads()
+  {
+    paramsMutex.lock();
+    int retValue = numThreads;
+    paramsMutex.unlock();
+
+    return retValue;
+  }
+
+  /// @brief Returns the number of threads decoding image files
+  int getDecodeThreads()
+  {
+    paramsMutex.lock();
+    int retValue = decodeThreads;
+    paramsMutex.unlock();
+
+    return retValue;
+  }
+
+  /// @brief Returns the number of threads predicting labels when classifying
+  int getPredictThreads()
+  {
+    paramsMutex.lock();
+    int retValue = predictThreads;
+    paramsMutex.unlock();
+
+    return retValue;
+  }
+
+  /// @brief Returns the number of images that may wait between two stages
+  /// of the extraction pipeline
+  int getQueueCapacity()
+  {
+    paramsMutex.lock();
+    int retValue = queueCapacity;
+    paramsMutex.unlock();
+
+    return retValue;
+  }
+
+  /// @brief Returns true if image descriptors are given to the SVM as dense
+  /// rows of floats
+  bool getDenseFeatures()
+  {
+    paramsMutex.lock();
+    bool retValue = denseFeatures;
+    paramsMutex.unlock();
+
+    return retValue;
+  }
+
+  /// @brief Returns the size of the kernel shared by the folds of a grid
+  /// search in Mbytes
+  double getCvCacheSize()
+  {
+    paramsMutex.lock();
+    double retValue = cvCacheSize;
+    paramsMutex.unlock();
+
+    return retValue;
+  }
+
 protected:
 
   /// Default constructor
@@ -315,6 +443,16 @@ protected:
     p = 0;       
     shrinking = 0;  
     probability = 0; 
+    numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads < 1)
+    {
+      numThreads = 1;
+    }
+    decodeThreads = 2;
+    predictThreads = 1;
+    queueCapacity = 16;
+    denseFeatures = true;
+    cvCacheSize = 200;
     paramsMutex.unlock();
   }
 
@@ -380,6 +518,26 @@ protected:
 
   /// Value used when probability estimates should be used when training
   int probability; 
+
+  /// Number of threads used to extract image descriptors. Defaults to the
+  /// number of online processors.
+  int numThreads;
+
+  /// Number of threads decoding image files
+  int decodeThreads;
+
+  /// Number of threads predicting labels when classifying
+  int predictThreads;
+
+  /// Number of images that may wait between two pipeline stages
+  int queueCapacity;
+
+  /// True to store descriptors as dense rows of floats, which take a
+  /// quarter of the memory of sparse nodes and use vectorized kernels
+  bool denseFeatures;
+
+  /// Size in Mbytes of the kernel shared by the folds of a grid search
+  double cvCacheSize;
 };
 
 #endif
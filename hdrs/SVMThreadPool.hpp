@@ -0,0 +1,29 @@
+#ifndef SVM_THREAD_POOL_HPP
+#define SVM_THREAD_POOL_HPP
+
+#include "svm.h"
+#include "ThreadPool.hpp"
+
+/// @file
+/// @brief Entry points of the svm library running on a thread pool owned
+/// by the caller
+
+/// @brief svm_train on up to numThreads threads of pool instead of the
+/// threads set by svm_set_num_threads, which are neither used nor changed.
+///
+/// The pool is only used during the call, so it may be shared with the
+/// rest of the application and with other calls running at once. A NULL
+/// pool, or fewer than two threads, trains on the calling thread alone.
+svm_model* svm_train_on(const svm_problem* prob, const svm_parameter* param,
+                        ThreadPool* pool, int numThreads);
+
+/// @brief svm_grid_search_seeded on up to numThreads threads of pool, like
+/// svm_train_on, with the folds sharing a kernel of cvCacheSize MB instead
+/// of the size set by svm_set_cv_cache_size, which is not used; 0 leaves
+/// each fold with its own cache only
+svm_model* svm_grid_search_on(const svm_problem* prob, const svm_parameter* param,
+                              const svm_grid* grid, int nr_fold, double* scores,
+                              unsigned int seed, double cvCacheSize,
+                              ThreadPool* pool, int numThreads);
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+/// @file
+/// @brief Interface for a fixed size pool of worker threads
+
+/// @brief Fixed size pool of persistent worker threads.
+///
+/// The pool runs loops whose iterations are independent of each other.
+/// The workers are started once by the constructor and wait for work
+/// between loops, so a loop does not pay for creating threads. The calling
+/// thread takes part in every loop, so a pool of n threads starts n-1
+/// workers.
+///
+/// Iterations are handed out one at a time, in increasing order, to
+/// whichever thread is free. Results should be written to a slot owned by
+/// the iteration index so they come out in the same order regardless of
+/// which thread ran them.
+///
+/// Several loops may run at once, including loops started from inside an
+/// iteration. A worker that is free joins the oldest loop that still has
+/// iterations to hand out and room for another thread, so a loop started
+/// while the others hold every worker runs on the calling thread alone
+/// instead of waiting for them. runConcurrently fails instead.
+class ThreadPool
+{
+public:
+  /// Function run for each iteration of a loop
+  typedef void (*Task)(void* context, int index);
+
+  /// @brief Constructor
+  /// @param numThreads
+  ///        The number of threads running a loop, including the caller
+  ///
+  /// @exception std::invalid_argument
+  /// Thrown if numThreads is not positive.
+  ///
+  /// @exception std::runtime_error
+  /// Thrown if a worker thread cannot be started.
+  explicit ThreadPool(int numThreads);
+
+  /// Destructor. Stops and joins the worker threads.
+  ~ThreadPool();
+
+  /// Returns the number of threads running a loop, including the caller
+  int size() const { return (int) workers.size() + 1; }
+
+  /// @brief Run task(context, i) for every i in [0,count)
+  /// @param count
+  ///        The number of iterations
+  /// @param task
+  ///        The function run for each iteration
+  /// @param context
+  ///        Passed unchanged to every iteration
+  ///
+  /// Returns once every iteration has finished. If iterations throw, the
+  /// remaining iterations still run.
+  ///
+  /// @exception std::runtime_error
+  /// Thrown after the loop if an iteration threw, with the message of the
+  /// first exception.
+  void parallelFor(int count, Task task, void* context);
+
+  /// @brief Run task(context, i) for every i in [0,count) on at most
+  /// maxThreads threads, the caller included
+  /// @param count
+  ///        The number of iterations
+  /// @param task
+  ///        The function run for each iteration
+  /// @param context
+  ///        Passed unchanged to every iteration
+  /// @param maxThreads
+  ///        The number of threads the loop may use; the loop runs on the
+  ///        calling thread alone if it is below 2
+  ///
+  /// Lets a caller keep threads of its own, such as a background thread,
+  /// within the size of the pool.
+  ///
+  /// @exception std::runtime_error
+  /// Thrown after the loop if an iteration threw, with the message of the
+  /// first exception.
+  void parallelFor(int count, Task task, void* context, int maxThreads);
+
+  /// @brief Run task(context, i) for every i in [0,count), each on a
+  /// thread of its own at the same time
+  /// @param count
+  ///        The number of iterations, at most size()
+  /// @param task
+  ///        The function run for each iteration
+  /// @param context
+  ///        Passed unchanged to every iteration
+  ///
+  /// For iterations that wait for each other, which would never finish if
+  /// run one after the other. Unlike parallelFor, the loop is never run
+  /// serially on the calling thread.
+  ///
+  /// @exception std::logic_error
+  /// Thrown before any iteration runs if count is larger than size(), or if
+  /// the pool is already running a loop, including when called from an
+  /// iteration of a loop of the pool.
+  ///
+  /// @exception std::runtime_error
+  /// Thrown after the loop if an iteration threw, with the message of the
+  /// first exception.
+  void runConcurrently(int count, Task task, void* context);
+
+  /// @brief Run functor(i) for every i in [0,count)
+  /// @param count
+  ///        The number of iterations
+  /// @param functor
+  ///        Object whose operator()(int) is called for each iteration
+  ///
+  /// @exception std::runtime_error
+  /// Thrown after the loop if an iteration threw.
+  template <class Functor>
+  void parallelFor(int count, Functor& functor)
+  {
+    parallelFor(count, &ThreadPool::invokeFunctor<Functor>, &functor);
+  }
+
+private:
+  /// Calls operator()(index) of the functor passed as the context
+  template <class Functor>
+  static void invokeFunctor(void* context, int index)
+  {
+    (*static_cast<Functor*>(context))(index);
+  }
+
+  /// Entry point of the worker threads
+  static void* workerMain(void* pool);
+
+  /// @brief A loop being run, owned by the thread that started it
+  struct Loop
+  {
+    /// The function run for each iteration
+    Task task;
+
+    /// Passed unchanged to every iteration
+    void* context;
+
+    /// The number of iterations
+    int count;
+
+    /// The next iteration to hand out
+    int next;
+
+    /// The number of workers that may join the loop
+    int maxWorkers;
+
+    /// The number of workers that joined the loop so far
+    int joinedWorkers;
+
+    /// The number of workers that have not yet left the loop
+    int activeWorkers;
+
+    /// Set when an iteration threw
+    bool failed;
+
+    /// Message of the first exception
+    std::string error;
+
+    /// The loop started after this one, or NULL
+    Loop* nextLoop;
+  };
+
+  /// Wait for loops and run their iterations until the pool is stopped
+  void workerLoop();
+
+  /// Returns the oldest loop a worker may join, or NULL; mutex must be held
+  Loop* findLoop();
+
+  /// Claim and run iterations of a loop until none are left
+  void runIterations(Loop& loop);
+
+  /// Run every iteration of a loop on the calling thread
+  void runSerially(int count, Task task, void* context);
+
+  /// Run a loop on the calling thread and at most maxWorkers workers; if
+  /// exclusive, fail unless no other loop is running
+  void runOnWorkers(int count, Task task, void* context, int maxWorkers,
+                    bool exclusive);
+
+  /// Stop and join the worker threads and release the synchronization
+  /// objects
+  void shutdown();
+
+  /// Remember the first error raised by an iteration of a loop
+  void recordError(Loop& loop, const std::string& message);
+
+  /// The worker threads
+  std::vector<pthread_t> workers;
+
+  /// Protects the loops and the state of each of them
+  pthread_mutex_t mutex;
+
+  /// Signalled when a loop is started or the pool is stopped
+  pthread_cond_t workAvailable;
+
+  /// Signalled when the last worker has left a loop
+  pthread_cond_t workDone;
+
+  /// The loops being run, oldest first
+  Loop* loops;
+
+  /// Set when the workers should exit
+  bool stopping;
+
+  /// Not copyable
+  ThreadPool(const ThreadPool&);
+
+  /// Not assignable
+  ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
@@ -51,6 +51,16 @@ struct svm_node
 	double value;
 };
 
+/*
+ * Dense rows. A row whose first node has index SVM_DENSE_INDEX holds
+ * (int) value float features, packed in the nodes that follow it and
+ * followed by a node of index -1. Feature k has index k, so a dense row
+ * can be used wherever a sparse row is and the two can be mixed in a
+ * problem and a model, except with the PRECOMPUTED kernel. Build them
+ * with svm_dense_row_nodes and svm_fill_dense_row.
+ */
+#define SVM_DENSE_INDEX (-2)
+
 struct svm_problem
 {
 	int l;
@@ -105,10 +115,46 @@ struct svm_model
 	/* XXX */
 	int free_sv;		/* 1 if svm_model is created by svm_load_model*/
 				/* 0 if svm_model is created by svm_train */
+
+	/* for the LINEAR kernel only, built by svm_train and svm_load_model */
+
+	double **w;		/* weight vector of each decision function (w[k*(k-1)/2][w_dim]) */
+				/* NULL to predict from the SVs, as for a model built by hand */
+	int w_dim;		/* length of each weight vector */
+
+	/* built by svm_train and svm_load_model, NULL for a model built by hand */
+
+	struct svm_node *sv_space;	/* rows of the SVs back to back when created by svm_train */
+	double *sv_square;	/* squared norm of each SV (sv_square[l]), for the RBF kernel */
 };
 
 struct svm_model *svm_train(const struct svm_problem *prob, const struct svm_parameter *param);
 void svm_cross_validation(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, double *target);
+/* as svm_cross_validation, with the folds and the random numbers of each fold drawn from seed instead of rand() */
+void svm_cross_validation_seeded(const struct svm_problem *prob, const struct svm_parameter *param, int nr_fold, double *target, unsigned int seed);
+
+/* values of C, gamma and nu tried by svm_grid_search; a parameter without
+   values keeps the one of the svm_parameter */
+struct svm_grid
+{
+	int nr_C;
+	double *C;
+	int nr_gamma;
+	double *gamma;
+	int nr_nu;
+	double *nu;
+};
+
+/* cross validates every point of the grid on the same folds, drawn from
+   rand(), and returns the model trained on the whole problem with the best
+   one. scores[(k*nr_gamma+j)*nr_C+i], a parameter without values counting
+   as one, receives the accuracy of classification or the mean squared error
+   of regression for C[i], gamma[j] and nu[k]. The points run at once, and
+   each C-SVC solve starts from the solution for the next smaller C;
+   probability estimates are only trained for the best point */
+struct svm_model *svm_grid_search(const struct svm_problem *prob, const struct svm_parameter *param, const struct svm_grid *grid, int nr_fold, double *scores);
+/* as svm_grid_search, with the folds, and those of the probability estimates of the best point, drawn from seed instead of rand() */
+struct svm_model *svm_grid_search_seeded(const struct svm_problem *prob, const struct svm_parameter *param, const struct svm_grid *grid, int nr_fold, double *scores, unsigned int seed);
 
 int svm_save_model(const char *model_file_name, const struct svm_model *model);
 struct svm_model *svm_load_model(const char *model_file_name);
@@ -122,6 +168,8 @@ double svm_get_svr_probability(const struct svm_model *model);
 
 double svm_predict_values(const struct svm_model *model, const struct svm_node *x, double* dec_values);
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
+/* labels[i], and dec_values[i*nr_decision...] if dec_values is not NULL, receive the results of x[i] */
+void svm_predict_batch(const struct svm_model *model, const struct svm_node * const *x, int n, double *labels, double *dec_values);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
 
 void svm_free_model_content(struct svm_model *model_ptr);
@@ -129,10 +177,33 @@ void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);
 void svm_destroy_param(struct svm_parameter *param);
 
 const char *svm_check_parameter(const struct svm_problem *prob, const struct svm_parameter *param);
+const char *svm_check_grid(const struct svm_problem *prob, const struct svm_parameter *param, const struct svm_grid *grid, int nr_fold);
 int svm_check_probability_model(const struct svm_model *model);
 
 void svm_set_print_string_function(void (*print_func)(const char *));
 
+/* threads used by svm_train and svm_cross_validation: independent folds,
+   one-vs-one problems and probability folds run at once and share
+   cache_size and the threads; the loops of each problem are split over its
+   share, with one of three or more threads computing kernel columns ahead
+   of the solver;
+   not to be changed during svm_train or svm_cross_validation. Calls on
+   several threads may run at once and share the threads */
+void svm_set_num_threads(int num_threads);
+int svm_get_num_threads(void);
+
+/* cache_size (in MB) of the kernel shared by the folds of
+   svm_cross_validation, whose columns are computed once for all folds;
+   0, the default, leaves each fold with its own cache only */
+void svm_set_cv_cache_size(double cache_size);
+double svm_get_cv_cache_size(void);
+
+int svm_dense_row_nodes(int dim);
+void svm_fill_dense_row(struct svm_node *row, const float *values, int dim);
+int svm_is_dense_row(const struct svm_node *x);
+int svm_dense_row_dim(const struct svm_node *x);
+const float *svm_dense_row_values(const struct svm_node *x);
+
 #ifdef __cplusplus
 }
 #endif
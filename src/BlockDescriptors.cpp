@@ -0,0 +1,132 @@
+#include "BlockDescriptors.hpp"
+#include <math.h>
+#include <vector>
+#include <stdexcept>
+
+const float BlockDescriptors::L2_HYS_CLIP = 0.2f;
+
+const float BlockDescriptors::EPSILON = 1e-3f;
+
+BlockDescriptors::BlockDescriptors(int blockCellsX, int blockCellsY, int strideCellsX, int strideCellsY, Normalization normalization)
+: blockCellsX(blockCellsX), blockCellsY(blockCellsY),
+  strideCellsX(strideCellsX), strideCellsY(strideCellsY),
+  normalization(normalization)
+{
+  if ((blockCellsX < 1) || (blockCellsY < 1))
+  {
+    throw std::invalid_argument("Block size must be positive");
+  }
+
+  if ((strideCellsX < 1) || (strideCellsY < 1))
+  {
+    throw std::invalid_argument("Block stride must be positive");
+  }
+}
+
+int BlockDescriptors::blocksX(const CellHistograms& cells) const
+{
+  if (cells.cellsX() < blockCellsX)
+  {
+    return 0;
+  }
+  return (cells.cellsX() - blockCellsX) / strideCellsX + 1;
+}
+
+int BlockDescriptors::blocksY(const CellHistograms& cells) const
+{
+  if (cells.cellsY() < blockCellsY)
+  {
+    return 0;
+  }
+  return (cells.cellsY() - blockCellsY) / strideCellsY + 1;
+}
+
+int BlockDescriptors::blockLength(const CellHistograms& cells) const
+{
+  return blockCellsX * blockCellsY * cells.bins();
+}
+
+void BlockDescriptors::compute(const CellHistograms& cells, std::vector<float>& descriptors) const
+{
+  int numBlocksX = blocksX(cells);
+  int numBlocksY = blocksY(cells);
+  int length = blockLength(cells);
+  int nbins = cells.bins();
+
+  descriptors.resize((size_t) numBlocksX * numBlocksY * length);
+
+  float* block = descriptors.empty() ? NULL : &descriptors[0];
+
+  for (int by = 0; by < numBlocksY; by++)
+  {
+    for (int bx = 0; bx < numBlocksX; bx++)
+    {
+      // overlapping blocks copy the shared cell histograms instead of
+      // binning their pixels again
+      float* cell = block;
+      for (int cy = by * strideCellsY; cy < by * strideCellsY + blockCellsY; cy++)
+      {
+        for (int cx = bx * strideCellsX; cx < bx * strideCellsX + blockCellsX; cx++)
+        {
+          cells.histogram(cy, cx, cell);
+          cell += nbins;
+        }
+      }
+
+      normalize(block, length);
+      block += length;
+    }
+  }
+}
+
+void BlockDescriptors::normalize(float* block, int length) const
+{
+  if (normalization == L1_SQRT)
+  {
+    float sum = 0.0f;
+    for (int k = 0; k < length; k++)
+    {
+      sum += fabsf(block[k]);
+    }
+
+    float scale = 1.0f / (sum + EPSILON);
+    for (int k = 0; k < length; k++)
+    {
+      block[k] = sqrtf(block[k] * scale);
+    }
+    return;
+  }
+
+  float sum = 0.0f;
+  for (int k = 0; k < length; k++)
+  {
+    sum += block[k] * block[k];
+  }
+
+  float scale = 1.0f / sqrtf(sum + EPSILON * EPSILON);
+  for (int k = 0; k < length; k++)
+  {
+    block[k] *= scale;
+  }
+
+  if (normalization == L2_HYS)
+  {
+    // clip the largest values so a few strong edges do not dominate the
+    // block, then renormalize
+    sum = 0.0f;
+    for (int k = 0; k < length; k++)
+    {
+      if (block[k] > L2_HYS_CLIP)
+      {
+        block[k] = L2_HYS_CLIP;
+      }
+      sum += block[k] * block[k];
+    }
+
+    scale = 1.0f / sqrtf(sum + EPSILON * EPSILON);
+    for (int k = 0; k < length; k++)
+    {
+      block[k] *= scale;
+    }
+  }
+}
@@ -0,0 +1,216 @@
+#include "CellHistograms.hpp"
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "opencv2/core/core.hpp"
+
+CellHistograms::CellHistograms()
+: numCellsX(0), numCellsY(0), numBins(0)
+{
+}
+
+void CellHistograms::compute(const cv::Mat& gradMag, const cv::Mat& gradOrient, int cellSizeX, int cellSizeY, int nbins, Interpolation interpolation)
+{
+  if ((gradMag.type() != CV_32F) ||
+      ((gradOrient.type() != CV_8U) && (gradOrient.type() != CV_32F)))
+  {
+    throw std::invalid_argument("Unsupported gradient matrix type");
+  }
+
+  if ((gradMag.rows != gradOrient.rows) || (gradMag.cols != gradOrient.cols))
+  {
+    throw std::invalid_argument("Gradient matrices must have the same size");
+  }
+
+  if ((cellSizeX < 1) || (cellSizeY < 1) || (nbins < 1))
+  {
+    throw std::invalid_argument("Cell size and number of bins must be positive");
+  }
+
+  if ((interpolation == TRILINEAR) && (gradOrient.type() != CV_32F))
+  {
+    throw std::invalid_argument("Trilinear interpolation needs orientations in degrees");
+  }
+
+  numCellsX = gradMag.cols / cellSizeX;
+  numCellsY = gradMag.rows / cellSizeY;
+  numBins = nbins;
+  data.assign((size_t) numBins * numCellsY * numCellsX, 0.0);
+
+  if ((numCellsX == 0) || (numCellsY == 0))
+  {
+    return;
+  }
+
+  if (interpolation == TRILINEAR)
+  {
+    accumulateTrilinear(gradMag, gradOrient, cellSizeX, cellSizeY);
+  }
+  else
+  {
+    accumulateHard(gradMag, gradOrient, cellSizeX, cellSizeY);
+  }
+}
+
+void CellHistograms::histogram(int cellY, int cellX, float* histogram) const
+{
+  size_t offset = (size_t) cellY * numCellsX + cellX;
+  size_t planeSize = (size_t) numCellsY * numCellsX;
+
+  for (int b = 0; b < numBins; b++)
+  {
+    histogram[b] = data[b * planeSize + offset];
+  }
+}
+
+void CellHistograms::accumulateHard(const cv::Mat& gradMag, const cv::Mat& gradOrient, int cellSizeX, int cellSizeY)
+{
+  int width = numCellsX * cellSizeX;
+  float binsPerDegree = numBins / 180.0f;
+
+  // per bin sums of each pixel column over the rows of one band of cells
+  std::vector<float> columns((size_t) numBins * width);
+  std::vector<uchar> binBuffer(width);
+
+  for (int cy = 0; cy < numCellsY; cy++)
+  {
+    std::fill(columns.begin(), columns.end(), 0.0f);
+
+    for (int r = 0; r < cellSizeY; r++)
+    {
+      int i = cy * cellSizeY + r;
+      const float* magRow = gradMag.ptr<float>(i);
+      const uchar* binRow;
+
+      if (gradOrient.type() == CV_8U)
+      {
+        binRow = gradOrient.ptr<uchar>(i);
+      }
+      else
+      {
+        const float* orientRow = gradOrient.ptr<float>(i);
+        for (int x = 0; x < width; x++)
+        {
+          int bin = (int) (orientRow[x] * binsPerDegree);
+          binBuffer[x] = (uchar) ((bin >= numBins) ? bin - numBins : bin);
+        }
+        binRow = &binBuffer[0];
+      }
+
+      // select and add with a compare instead of a data dependent store,
+      // so each bin is one vectorizable pass over the row
+      for (int b = 0; b < numBins; b++)
+      {
+        float* column = &columns[(size_t) b * width];
+        for (int x = 0; x < width; x++)
+        {
+          column[x] += (binRow[x] == b) ? magRow[x] : 0.0f;
+        }
+      }
+    }
+
+    collapseColumns(columns, cy, cellSizeX);
+  }
+}
+
+void CellHistograms::collapseColumns(const std::vector<float>& columns, int cellY, int cellSizeX)
+{
+  int width = numCellsX * cellSizeX;
+  size_t planeSize = (size_t) numCellsY * numCellsX;
+
+  for (int b = 0; b < numBins; b++)
+  {
+    const float* column = &columns[(size_t) b * width];
+    float* cells = &data[b * planeSize + (size_t) cellY * numCellsX];
+
+    for (int cx = 0; cx < numCellsX; cx++)
+    {
+      float sum = 0.0f;
+      for (int k = 0; k < cellSizeX; k++)
+      {
+        sum += column[cx * cellSizeX + k];
+      }
+      cells[cx] += sum;
+    }
+  }
+}
+
+void CellHistograms::accumulateTrilinear(const cv::Mat& gradMag, const cv::Mat& gradOrient, int cellSizeX, int cellSizeY)
+{
+  int width = numCellsX * cellSizeX;
+  int height = numCellsY * cellSizeY;
+  float binsPerDegree = numBins / 180.0f;
+  size_t planeSize = (size_t) numCellsY * numCellsX;
+
+  // the horizontal cell and weight of a pixel only depend on its column
+  std::vector<int> cellX0(width);
+  std::vector<float> weightX1(width);
+  for (int x = 0; x < width; x++)
+  {
+    float position = (x + 0.5f) / cellSizeX - 0.5f;
+    cellX0[x] = (int) floorf(position);
+    weightX1[x] = position - cellX0[x];
+  }
+
+  std::vector<int> bin0(width);
+  std::vector<float> weightBin1(width);
+
+  for (int i = 0; i < height; i++)
+  {
+    const float* magRow = gradMag.ptr<float>(i);
+    const float* orientRow = gradOrient.ptr<float>(i);
+
+    float positionY = (i + 0.5f) / cellSizeY - 0.5f;
+    int cellY0 = (int) floorf(positionY);
+    float weightY1 = positionY - cellY0;
+
+    // orientation bins and weights for the whole row; bin centres are at
+    // (b + 0.5) * 180 / nbins and the orientation wraps around at 180
+    for (int x = 0; x < width; x++)
+    {
+      float position = orientRow[x] * binsPerDegree - 0.5f;
+      float lower = floorf(position);
+      bin0[x] = (int) lower;
+      weightBin1[x] = position - lower;
+    }
+
+    for (int dy = 0; dy < 2; dy++)
+    {
+      int cy = cellY0 + dy;
+      if ((cy < 0) || (cy >= numCellsY))
+      {
+        continue;
+      }
+      float weightY = dy ? weightY1 : 1.0f - weightY1;
+      size_t rowOffset = (size_t) cy * numCellsX;
+
+      for (int x = 0; x < width; x++)
+      {
+        float vote = magRow[x] * weightY;
+        int b0 = bin0[x];
+        int b1 = b0 + 1;
+        b0 = (b0 < 0) ? b0 + numBins : b0;
+        b1 = (b1 >= numBins) ? b1 - numBins : b1;
+        float* plane0 = &data[b0 * planeSize + rowOffset];
+        float* plane1 = &data[b1 * planeSize + rowOffset];
+        float vote1 = vote * weightBin1[x];
+        float vote0 = vote - vote1;
+
+        int cx = cellX0[x];
+        float weightX1Value = weightX1[x];
+        if (cx >= 0)
+        {
+          plane0[cx] += vote0 * (1.0f - weightX1Value);
+          plane1[cx] += vote1 * (1.0f - weightX1Value);
+        }
+        if (cx + 1 < numCellsX)
+        {
+          plane0[cx + 1] += vote0 * weightX1Value;
+          plane1[cx + 1] += vote1 * weightX1Value;
+        }
+      }
+    }
+  }
+}
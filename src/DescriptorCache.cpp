@@ -0,0 +1,287 @@
+#include "DescriptorCache.hpp"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <stdexcept>
+
+const uint64_t DescriptorCache::FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+const uint64_t DescriptorCache::FNV_PRIME = 1099511628211ULL;
+
+// The file starts with this tag, followed by the records. Each record is a
+// header and the descriptor values, as 32-bit floats in native byte order.
+static const char CACHE_MAGIC[8] = {'H','O','G','C','V','D','C','1'};
+
+/// Header of a record in the cache file
+struct RecordHeader
+{
+  /// FNV-1a hash of the bytes of the image file
+  uint64_t contentHash;
+
+  /// Size of the image file in bytes
+  uint64_t fileSize;
+
+  /// Hash of the settings used to extract the descriptors
+  uint64_t configHash;
+
+  /// Number of descriptor values following the header
+  uint32_t count;
+
+  /// Keeps the descriptor values 8 byte aligned
+  uint32_t reserved;
+};
+
+/// Write a whole buffer at an offset, retrying short writes
+static bool writeAt(int fd, const void* data, size_t length, uint64_t offset)
+{
+  const char* bytes = static_cast<const char*>(data);
+  while (length > 0)
+  {
+    ssize_t written = pwrite(fd, bytes, length, (off_t) offset);
+    if (written <= 0)
+    {
+      return false;
+    }
+    bytes += written;
+    length -= written;
+    offset += written;
+  }
+  return true;
+}
+
+/// Read a whole buffer at an offset, retrying short reads
+static bool readAt(int fd, void* data, size_t length, uint64_t offset)
+{
+  char* bytes = static_cast<char*>(data);
+  while (length > 0)
+  {
+    ssize_t read = pread(fd, bytes, length, (off_t) offset);
+    if (read <= 0)
+    {
+      return false;
+    }
+    bytes += read;
+    length -= read;
+    offset += read;
+  }
+  return true;
+}
+
+DescriptorCache::DescriptorCache(const std::string& path)
+: filePath(path), fd(-1), mapped(NULL), mappedLength(0), fileEnd(0)
+{
+  fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+  {
+    throw std::invalid_argument("Descriptor cache could not be opened");
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+  {
+    close(fd);
+    throw std::invalid_argument("Descriptor cache could not be opened");
+  }
+
+  if (info.st_size == 0)
+  {
+    if (!writeAt(fd, CACHE_MAGIC, sizeof(CACHE_MAGIC), 0))
+    {
+      close(fd);
+      throw std::invalid_argument("Descriptor cache could not be created");
+    }
+    fileEnd = sizeof(CACHE_MAGIC);
+    return;
+  }
+
+  char magic[sizeof(CACHE_MAGIC)];
+  if (((size_t) info.st_size < sizeof(CACHE_MAGIC)) ||
+      !readAt(fd, magic, sizeof(magic), 0) ||
+      (memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0))
+  {
+    close(fd);
+    throw std::invalid_argument("File is not a descriptor cache");
+  }
+
+  // the existing records are read through the mapping; the pages are only
+  // loaded when a lookup touches them
+  mappedLength = (size_t) info.st_size;
+  void* address = mmap(NULL, mappedLength, PROT_READ, MAP_SHARED, fd, 0);
+  if (address == MAP_FAILED)
+  {
+    close(fd);
+    throw std::invalid_argument("Descriptor cache could not be mapped");
+  }
+  mapped = static_cast<const unsigned char*>(address);
+
+  indexRecords();
+
+  // drop a record cut short by an interrupted write so new records start
+  // at a record boundary, and only keep the complete records mapped
+  if (fileEnd < mappedLength)
+  {
+    munmap((void*) mapped, mappedLength);
+    mapped = NULL;
+    mappedLength = (size_t) fileEnd;
+
+    address = mmap(NULL, mappedLength, PROT_READ, MAP_SHARED, fd, 0);
+    if ((address == MAP_FAILED) || (ftruncate(fd, (off_t) fileEnd) != 0))
+    {
+      if (address != MAP_FAILED)
+      {
+        munmap(address, mappedLength);
+      }
+      close(fd);
+      throw std::invalid_argument("Descriptor cache could not be repaired");
+    }
+    mapped = static_cast<const unsigned char*>(address);
+  }
+}
+
+DescriptorCache::~DescriptorCache()
+{
+  if (NULL != mapped)
+  {
+    munmap((void*) mapped, mappedLength);
+  }
+  close(fd);
+}
+
+void DescriptorCache::indexRecords()
+{
+  uint64_t offset = sizeof(CACHE_MAGIC);
+
+  while (offset + sizeof(RecordHeader) <= mappedLength)
+  {
+    RecordHeader header;
+    memcpy(&header, mapped + offset, sizeof(header));
+
+    uint64_t values = offset + sizeof(RecordHeader);
+    uint64_t end = values + (uint64_t) header.count * sizeof(float);
+    if (end > mappedLength)
+    {
+      break;
+    }
+
+    Key key;
+    key.contentHash = header.contentHash;
+    key.fileSize = header.fileSize;
+    key.configHash = header.configHash;
+
+    Location location;
+    location.offset = values;
+    location.count = header.count;
+    index[key] = location;
+
+    offset = end;
+  }
+
+  fileEnd = offset;
+}
+
+size_t DescriptorCache::size()
+{
+  cacheMutex.lock();
+  size_t retValue = index.size();
+  cacheMutex.unlock();
+
+  return retValue;
+}
+
+uint64_t DescriptorCache::hash(const void* data, size_t length, uint64_t seed)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  uint64_t value = seed;
+
+  for (size_t i = 0; i < length; i++)
+  {
+    value ^= bytes[i];
+    value *= FNV_PRIME;
+  }
+
+  return value;
+}
+
+DescriptorCache::Key DescriptorCache::makeKey(const void* fileBytes, size_t length, uint64_t configHash)
+{
+  Key key;
+  key.contentHash = hash(fileBytes, length);
+  key.fileSize = length;
+  key.configHash = configHash;
+  return key;
+}
+
+bool DescriptorCache::lookup(const Key& key, std::vector<float>& descriptors)
+{
+  cacheMutex.lock();
+  std::map<Key, Location>::const_iterator it = index.find(key);
+  bool found = (it != index.end());
+  Location location;
+  if (found)
+  {
+    location = it->second;
+  }
+  cacheMutex.unlock();
+
+  if (!found)
+  {
+    return false;
+  }
+
+  size_t length = (size_t) location.count * sizeof(float);
+  descriptors.resize(location.count);
+  if (length == 0)
+  {
+    return true;
+  }
+
+  // records from before the cache was opened are mapped, newer ones are
+  // read from the file
+  if (location.offset + length <= mappedLength)
+  {
+    memcpy(&descriptors[0], mapped + location.offset, length);
+    return true;
+  }
+
+  return readAt(fd, &descriptors[0], length, location.offset);
+}
+
+bool DescriptorCache::insert(const Key& key, const std::vector<float>& descriptors)
+{
+  RecordHeader header;
+  header.contentHash = key.contentHash;
+  header.fileSize = key.fileSize;
+  header.configHash = key.configHash;
+  header.count = (uint32_t) descriptors.size();
+  header.reserved = 0;
+
+  size_t length = descriptors.size() * sizeof(float);
+
+  cacheMutex.lock();
+  if (index.find(key) != index.end())
+  {
+    cacheMutex.unlock();
+    return true;
+  }
+
+  uint64_t offset = fileEnd;
+  bool written = writeAt(fd, &header, sizeof(header), offset) &&
+                 ((length == 0) || writeAt(fd, &descriptors[0], length, offset + sizeof(header)));
+
+  // a partial record is overwritten by the next insertion, or dropped
+  // when the cache is opened again
+  if (written)
+  {
+    Location location;
+    location.offset = offset + sizeof(header);
+    location.count = header.count;
+    index[key] = location;
+    fileEnd = offset + sizeof(header) + length;
+  }
+  cacheMutex.unlock();
+
+  return written;
+}
@@ -0,0 +1,438 @@
+#include "GradientKernel.hpp"
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <stdexcept>
+#include "opencv2/core/core.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Coefficients of the polynomial approximation of atan(c) for c in [0,1],
+// scaled to degrees. These are the coefficients used by cv::fastAtan2, so
+// the orientations agree with the previous implementation to within its
+// accuracy (about 0.3 degrees).
+static const float ATAN_P1 = 0.9997878412794807f * (float)(180.0 / CV_PI);
+static const float ATAN_P3 = -0.3258083974640975f * (float)(180.0 / CV_PI);
+static const float ATAN_P5 = 0.1555786518463281f * (float)(180.0 / CV_PI);
+static const float ATAN_P7 = -0.04432655554792128f * (float)(180.0 / CV_PI);
+static const float ATAN_EPS = 2.2204460492503131e-16f;
+
+/// Index of a neighbouring pixel using the reflect 101 border
+static inline int reflect101(int i, int len)
+{
+  if (len == 1)
+  {
+    return 0;
+  }
+  if (i < 0)
+  {
+    return -i;
+  }
+  if (i >= len)
+  {
+    return 2*len - i - 2;
+  }
+  return i;
+}
+
+void GradientKernel::checkImage(const cv::Mat& image)
+{
+  if (image.empty())
+  {
+    throw std::invalid_argument("Image is empty");
+  }
+
+  if ((image.type() != CV_8UC3) && (image.type() != CV_8UC1))
+  {
+    throw std::invalid_argument("Image must be an 8-bit 1 or 3 channel image");
+  }
+}
+
+void GradientKernel::compute(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradOrient)
+{
+  checkImage(image);
+
+  int rows = image.rows;
+  int cols = image.cols;
+
+  gradMag.create(rows, cols, CV_32F);
+  gradOrient.create(rows, cols, CV_32F);
+
+  // the derivatives of the strongest channel of a row only live in these
+  // buffers, so the image is read once and the outputs are written once
+  std::vector<float> gradX(cols);
+  std::vector<float> gradY(cols);
+
+  for (int i = 0; i < rows; i++)
+  {
+    rowDerivatives(image.ptr<uchar>(reflect101(i-1, rows)),
+                   image.ptr<uchar>(i),
+                   image.ptr<uchar>(reflect101(i+1, rows)),
+                   cols, image.channels(), &gradX[0], &gradY[0]);
+
+    rowMagnitudeOrientation(&gradX[0], &gradY[0], cols,
+                            gradMag.ptr<float>(i), gradOrient.ptr<float>(i));
+  }
+}
+
+void GradientKernel::computeBinned(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradBin, int nbins)
+{
+  checkImage(image);
+
+  if ((nbins < 1) || (nbins > 255))
+  {
+    throw std::invalid_argument("Number of orientation bins must be between 1 and 255");
+  }
+
+  int rows = image.rows;
+  int cols = image.cols;
+
+  gradMag.create(rows, cols, CV_32F);
+  gradBin.create(rows, cols, CV_8U);
+
+  // boundary b separates bin b-1 from bin b
+  std::vector<float> boundaryCos(nbins);
+  std::vector<float> boundarySin(nbins);
+  for (int b = 1; b < nbins; b++)
+  {
+    double angle = CV_PI * b / nbins;
+    boundaryCos[b-1] = (float) cos(angle);
+    boundarySin[b-1] = (float) sin(angle);
+  }
+
+  std::vector<float> gradX(cols);
+  std::vector<float> gradY(cols);
+
+  for (int i = 0; i < rows; i++)
+  {
+    rowDerivatives(image.ptr<uchar>(reflect101(i-1, rows)),
+                   image.ptr<uchar>(i),
+                   image.ptr<uchar>(reflect101(i+1, rows)),
+                   cols, image.channels(), &gradX[0], &gradY[0]);
+
+    rowMagnitudeBin(&gradX[0], &gradY[0], cols, &boundaryCos[0], &boundarySin[0],
+                    nbins, gradMag.ptr<float>(i), gradBin.ptr<uchar>(i));
+  }
+}
+
+/// Derivatives of the strongest channel of one pixel from its neighbours
+static inline void strongestDerivatives(const uchar* left, const uchar* right, const uchar* up, const uchar* down, int channels, float* gradX, float* gradY)
+{
+  // the first channel (blue) wins ties, then green, then red
+  int bestX = right[0] - left[0];
+  int bestY = down[0] - up[0];
+  int bestMag = bestX*bestX + bestY*bestY;
+
+  for (int c = 1; c < channels; c++)
+  {
+    int dx = right[c] - left[c];
+    int dy = down[c] - up[c];
+    int mag = dx*dx + dy*dy;
+
+    if (mag > bestMag)
+    {
+      bestMag = mag;
+      bestX = dx;
+      bestY = dy;
+    }
+  }
+
+  *gradX = (float) bestX;
+  *gradY = (float) bestY;
+}
+
+#ifdef __SSE2__
+/// @brief Derivatives of the strongest channel of 8 pixels
+///
+/// Each register holds one channel of the 8 pixels in its low 8 bytes.
+/// The derivatives of a pixel are kept as a (dx,dy) pair of 16-bit values
+/// in one 32-bit lane, so _mm_madd_epi16 gives the squared magnitude of the
+/// lane and a compare selects the whole pair.
+static inline void strongestDerivatives8(const __m128i* left, const __m128i* right, const __m128i* up, const __m128i* down, int channels, float* gradX, float* gradY)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i bestLo = zero;
+  __m128i bestHi = zero;
+  __m128i bestMagLo = zero;
+  __m128i bestMagHi = zero;
+
+  for (int c = 0; c < channels; c++)
+  {
+    __m128i dx = _mm_sub_epi16(_mm_unpacklo_epi8(right[c], zero), _mm_unpacklo_epi8(left[c], zero));
+    __m128i dy = _mm_sub_epi16(_mm_unpacklo_epi8(down[c], zero), _mm_unpacklo_epi8(up[c], zero));
+    __m128i pairLo = _mm_unpacklo_epi16(dx, dy);
+    __m128i pairHi = _mm_unpackhi_epi16(dx, dy);
+    __m128i magLo = _mm_madd_epi16(pairLo, pairLo);
+    __m128i magHi = _mm_madd_epi16(pairHi, pairHi);
+
+    if (c == 0)
+    {
+      bestLo = pairLo;
+      bestHi = pairHi;
+      bestMagLo = magLo;
+      bestMagHi = magHi;
+      continue;
+    }
+
+    // the first channel wins ties, as in the scalar path
+    __m128i mask = _mm_cmpgt_epi32(magLo, bestMagLo);
+    bestLo = _mm_or_si128(_mm_and_si128(mask, pairLo), _mm_andnot_si128(mask, bestLo));
+    bestMagLo = _mm_or_si128(_mm_and_si128(mask, magLo), _mm_andnot_si128(mask, bestMagLo));
+    mask = _mm_cmpgt_epi32(magHi, bestMagHi);
+    bestHi = _mm_or_si128(_mm_and_si128(mask, pairHi), _mm_andnot_si128(mask, bestHi));
+    bestMagHi = _mm_or_si128(_mm_and_si128(mask, magHi), _mm_andnot_si128(mask, bestMagHi));
+  }
+
+  // dx is the sign extended low half of each pair, dy the high half
+  _mm_storeu_ps(gradX, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(bestLo, 16), 16)));
+  _mm_storeu_ps(gradX + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(bestHi, 16), 16)));
+  _mm_storeu_ps(gradY, _mm_cvtepi32_ps(_mm_srai_epi32(bestLo, 16)));
+  _mm_storeu_ps(gradY + 4, _mm_cvtepi32_ps(_mm_srai_epi32(bestHi, 16)));
+}
+
+/// @brief Load 16 interleaved BGR pixels as one register per channel
+static inline void loadDeinterleaved(const uchar* ptr, __m128i* channel)
+{
+  __m128i t00 = _mm_loadu_si128((const __m128i*) ptr);
+  __m128i t01 = _mm_loadu_si128((const __m128i*) (ptr + 16));
+  __m128i t02 = _mm_loadu_si128((const __m128i*) (ptr + 32));
+
+  // each round interleaves the bytes of the three registers, which after
+  // four rounds leaves every third byte, one channel, in each register
+  for (int round = 0; round < 4; round++)
+  {
+    __m128i t10 = _mm_unpacklo_epi8(t00, _mm_unpackhi_epi64(t01, t01));
+    __m128i t11 = _mm_unpacklo_epi8(_mm_unpackhi_epi64(t00, t00), t02);
+    __m128i t12 = _mm_unpacklo_epi8(t01, _mm_unpackhi_epi64(t02, t02));
+    t00 = t10;
+    t01 = t11;
+    t02 = t12;
+  }
+
+  channel[0] = t00;
+  channel[1] = t01;
+  channel[2] = t02;
+}
+#endif
+
+void GradientKernel::rowDerivatives(const uchar* prev, const uchar* cur, const uchar* next, int cols, int channels, float* gradX, float* gradY)
+{
+  // the border columns reflect onto the same neighbour on both sides, so
+  // only the interior needs the two neighbours of a pixel
+  if (cols == 1)
+  {
+    strongestDerivatives(cur, cur, prev, next, channels, gradX, gradY);
+    return;
+  }
+  strongestDerivatives(cur + channels, cur + channels, prev, next, channels, gradX, gradY);
+
+  int j = 1;
+
+#ifdef __SSE2__
+  if (channels == 1)
+  {
+    // 8 pixels at a time, reading up to the pixel after the last one
+    for (; j <= cols - 9; j += 8)
+    {
+      __m128i left = _mm_loadl_epi64((const __m128i*) (cur + j - 1));
+      __m128i right = _mm_loadl_epi64((const __m128i*) (cur + j + 1));
+      __m128i up = _mm_loadl_epi64((const __m128i*) (prev + j));
+      __m128i down = _mm_loadl_epi64((const __m128i*) (next + j));
+      strongestDerivatives8(&left, &right, &up, &down, 1, gradX + j, gradY + j);
+    }
+  }
+  else if (channels == 3)
+  {
+    // 16 pixels at a time, split into their channels
+    for (; j <= cols - 17; j += 16)
+    {
+      __m128i left[3], right[3], up[3], down[3];
+      loadDeinterleaved(cur + (j-1)*3, left);
+      loadDeinterleaved(cur + (j+1)*3, right);
+      loadDeinterleaved(prev + j*3, up);
+      loadDeinterleaved(next + j*3, down);
+      strongestDerivatives8(left, right, up, down, 3, gradX + j, gradY + j);
+
+      for (int c = 0; c < 3; c++)
+      {
+        left[c] = _mm_unpackhi_epi64(left[c], left[c]);
+        right[c] = _mm_unpackhi_epi64(right[c], right[c]);
+        up[c] = _mm_unpackhi_epi64(up[c], up[c]);
+        down[c] = _mm_unpackhi_epi64(down[c], down[c]);
+      }
+      strongestDerivatives8(left, right, up, down, 3, gradX + j + 8, gradY + j + 8);
+    }
+  }
+#endif
+
+  for (; j < cols - 1; j++)
+  {
+    int offset = j*channels;
+    strongestDerivatives(cur + offset - channels, cur + offset + channels,
+                         prev + offset, next + offset, channels, gradX + j, gradY + j);
+  }
+
+  int last = (cols-1)*channels;
+  strongestDerivatives(cur + last - channels, cur + last - channels,
+                       prev + last, next + last, channels, gradX + cols - 1, gradY + cols - 1);
+}
+
+void GradientKernel::rowMagnitudeOrientation(const float* gradX, const float* gradY, int cols, float* mag, float* orient)
+{
+  int j = 0;
+
+#ifdef __SSE2__
+  const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 eps = _mm_set1_ps(ATAN_EPS);
+  const __m128 p1 = _mm_set1_ps(ATAN_P1);
+  const __m128 p3 = _mm_set1_ps(ATAN_P3);
+  const __m128 p5 = _mm_set1_ps(ATAN_P5);
+  const __m128 p7 = _mm_set1_ps(ATAN_P7);
+  const __m128 deg90 = _mm_set1_ps(90.0f);
+  const __m128 deg180 = _mm_set1_ps(180.0f);
+  const __m128 deg360 = _mm_set1_ps(360.0f);
+
+  for (; j <= cols - 4; j += 4)
+  {
+    __m128 x = _mm_loadu_ps(gradX + j);
+    __m128 y = _mm_loadu_ps(gradY + j);
+
+    _mm_storeu_ps(mag + j, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+
+    __m128 ax = _mm_and_ps(x, signMask);
+    __m128 ay = _mm_and_ps(y, signMask);
+    __m128 xMajor = _mm_cmpge_ps(ax, ay);
+    __m128 c = _mm_div_ps(_mm_min_ps(ax, ay), _mm_add_ps(_mm_max_ps(ax, ay), eps));
+    __m128 c2 = _mm_mul_ps(c, c);
+    __m128 a = _mm_add_ps(_mm_mul_ps(p7, c2), p5);
+    a = _mm_add_ps(_mm_mul_ps(a, c2), p3);
+    a = _mm_add_ps(_mm_mul_ps(a, c2), p1);
+    a = _mm_mul_ps(a, c);
+
+    // a = xMajor ? a : 90 - a
+    a = _mm_or_ps(_mm_and_ps(xMajor, a), _mm_andnot_ps(xMajor, _mm_sub_ps(deg90, a)));
+    // a = (x < 0) ? 180 - a : a
+    __m128 mask = _mm_cmplt_ps(x, zero);
+    a = _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, _mm_sub_ps(deg180, a)));
+    // a = (y < 0) ? 360 - a : a
+    mask = _mm_cmplt_ps(y, zero);
+    a = _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, _mm_sub_ps(deg360, a)));
+    // fold the orientation into [0,180]
+    mask = _mm_cmpgt_ps(a, deg180);
+    a = _mm_sub_ps(a, _mm_and_ps(mask, deg180));
+
+    _mm_storeu_ps(orient + j, a);
+  }
+#endif
+
+  for (; j < cols; j++)
+  {
+    float x = gradX[j];
+    float y = gradY[j];
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float a;
+
+    mag[j] = sqrtf(x*x + y*y);
+
+    if (ax >= ay)
+    {
+      float c = ay / (ax + ATAN_EPS);
+      float c2 = c*c;
+      a = (((ATAN_P7*c2 + ATAN_P5)*c2 + ATAN_P3)*c2 + ATAN_P1)*c;
+    }
+    else
+    {
+      float c = ax / (ay + ATAN_EPS);
+      float c2 = c*c;
+      a = 90.0f - (((ATAN_P7*c2 + ATAN_P5)*c2 + ATAN_P3)*c2 + ATAN_P1)*c;
+    }
+
+    if (x < 0)
+    {
+      a = 180.0f - a;
+    }
+    if (y < 0)
+    {
+      a = 360.0f - a;
+    }
+    if (a > 180.0f)
+    {
+      a = a - 180.0f;
+    }
+
+    orient[j] = a;
+  }
+}
+
+void GradientKernel::rowMagnitudeBin(const float* gradX, const float* gradY, int cols, const float* boundaryCos, const float* boundarySin, int nbins, float* mag, uchar* bin)
+{
+  int j = 0;
+
+#ifdef __SSE2__
+  const __m128 signBit = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+  const __m128 zero = _mm_setzero_ps();
+
+  for (; j <= cols - 4; j += 4)
+  {
+    __m128 x = _mm_loadu_ps(gradX + j);
+    __m128 y = _mm_loadu_ps(gradY + j);
+
+    _mm_storeu_ps(mag + j, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+
+    // mirror gradients in the lower half plane (and along the negative
+    // x axis) so that every orientation lies in [0,180)
+    __m128 flip = _mm_or_ps(_mm_cmplt_ps(y, zero),
+                            _mm_and_ps(_mm_cmpeq_ps(y, zero), _mm_cmplt_ps(x, zero)));
+    x = _mm_xor_ps(x, _mm_and_ps(flip, signBit));
+    y = _mm_xor_ps(y, _mm_and_ps(flip, signBit));
+
+    // count the boundaries the gradient lies on or past: the sign of the
+    // cross product of the boundary direction and the gradient
+    __m128i count = _mm_setzero_si128();
+    for (int b = 0; b < nbins - 1; b++)
+    {
+      __m128 cross = _mm_sub_ps(_mm_mul_ps(y, _mm_set1_ps(boundaryCos[b])),
+                                _mm_mul_ps(x, _mm_set1_ps(boundarySin[b])));
+      count = _mm_sub_epi32(count, _mm_castps_si128(_mm_cmpge_ps(cross, zero)));
+    }
+
+    // a zero gradient lies on every boundary, report it as bin 0
+    __m128 none = _mm_and_ps(_mm_cmpeq_ps(x, zero), _mm_cmpeq_ps(y, zero));
+    count = _mm_andnot_si128(_mm_castps_si128(none), count);
+
+    count = _mm_packs_epi32(count, count);
+    count = _mm_packus_epi16(count, count);
+    int packed = _mm_cvtsi128_si32(count);
+    memcpy(bin + j, &packed, sizeof(packed));
+  }
+#endif
+
+  for (; j < cols; j++)
+  {
+    float x = gradX[j];
+    float y = gradY[j];
+
+    mag[j] = sqrtf(x*x + y*y);
+
+    if ((y < 0) || ((y == 0) && (x < 0)))
+    {
+      x = -x;
+      y = -y;
+    }
+
+    int count = 0;
+    if ((x != 0) || (y != 0))
+    {
+      for (int b = 0; b < nbins - 1; b++)
+      {
+        count += (y*boundaryCos[b] - x*boundarySin[b] >= 0);
+      }
+    }
+
+    bin[j] = (uchar) count;
+  }
+}
@@ -1,15 +1,24 @@
 #include "HOGCVController.hpp"
 #include "Parameters.hpp"
+#include "GradientKernel.hpp"
+#include "CellHistograms.hpp"
+#include "BlockDescriptors.hpp"
+#include "ThreadPool.hpp"
+#include "BoundedQueue.hpp"
+#include "DescriptorCache.hpp"
+#include "mutex.hpp"
 #include <math.h>
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <numeric>
 #include <algorithm>
 #include <stdexcept>
 #include "opencv2/core/core.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "svm.h"
+#include "SVMThreadPool.hpp"
 
 using namespace cv;
 using namespace std;
@@ -20,6 +29,16 @@ const int HOGCVController::PERSON_IN_IMAGE = 1;
 
 const int HOGCVController::NO_PERSON_IN_IMAGE = -1;
 
+const int HOGCVController::ORIENTATION_BINS = 9;
+
+const int HOGCVController::CELL_SIZE = 8;
+
+const int HOGCVController::BLOCK_SIZE = 2;
+
+const unsigned int HOGCVController::GRID_SEARCH_SEED = 1;
+
+const int HOGCVController::PREDICT_BATCH_SIZE = 32;
+
 HOGCVController* HOGCVController::instance()
 {
   if (NULL == HOGCVController::inst)
@@ -48,6 +67,60 @@ void HOGCVController::display(std::string fileName)
 }
 
 void HOGCVController::train(std::vector<string> fileNames, std::vector<int> labels)
+{
+  buildProblem(fileNames, labels);
+
+  // check the parameters
+  const char *error_msg = svm_check_parameter(&problem, &parameters);
+  if (NULL != error_msg)
+  {
+    throw std::logic_error(std::string("Error checking parameters " + std::string(error_msg)));
+//"Error when checking Parameters");
+  }
+
+  // train the model on the threads of the extraction pool, which are idle
+  // until the next extraction
+  model = svm_train_on(&problem, &parameters, pool, Parameters::instance()->getNumThreads());
+}
+
+void HOGCVController::gridSearch(const std::vector<std::string>& fileNames, const std::vector<int>& labels, const std::vector<double>& cValues, const std::vector<double>& gammaValues, const std::vector<double>& nuValues, int numFolds, std::vector<double>& scores)
+{
+  // each point is cross validated on at least two folds
+  if (numFolds < 2)
+  {
+    throw std::invalid_argument("Must use two or more folds");
+  }
+
+  buildProblem(fileNames, labels);
+
+  // the grid points at copies of the values, which svm_grid_search does
+  // not modify
+  std::vector<double> c(cValues), gamma(gammaValues), nu(nuValues);
+  struct svm_grid grid;
+  grid.nr_C = c.size();
+  grid.C = c.empty() ? NULL : &c[0];
+  grid.nr_gamma = gamma.size();
+  grid.gamma = gamma.empty() ? NULL : &gamma[0];
+  grid.nr_nu = nu.size();
+  grid.nu = nu.empty() ? NULL : &nu[0];
+
+  // check every point of the grid
+  const char *error_msg = svm_check_grid(&problem, &parameters, &grid, numFolds);
+  if (NULL != error_msg)
+  {
+    throw std::logic_error(std::string("Error checking grid ") + error_msg);
+  }
+
+  // search the grid on the threads of the extraction pool, with the folds
+  // sharing one kernel, and keep the parameters of the best point
+  scores.assign(std::max<size_t>(c.size(), 1) * std::max<size_t>(gamma.size(), 1) * std::max<size_t>(nu.size(), 1), 0.0);
+  model = svm_grid_search_on(&problem, &parameters, &grid, numFolds, &scores[0],
+                             GRID_SEARCH_SEED, Parameters::instance()->getCvCacheSize(),
+                             pool, Parameters::instance()->getNumThreads());
+  parameters = model->param;
+}
+
+void HOGCVController::buildProblem(const std::vector<std::string>& fileNames, const std::vector<int>& labels)
 {
   // the number of attributes for a given image
   double num_features;
@@ -64,21 +137,18 @@ void HOGCVController::train(std::vector<string> fileNames, std::vector<int> labe
     throw std::invalid_argument("Number of labels must equal number of files");
   }
 
-  // each file must be readable and valid for opencv
-  // and each label must be valid
-  for (unsigned int i=0;i < fileNames.size();i++)
-  {
-    cv::Mat image = imread(fileNames[i].c_str());
-    if (!image.data)
-    {
-      throw std::invalid_argument("An image could not be loaded");
-    }
+  // each label must be valid
+  validateLabels(labels);
 
-    if ((labels[i] != HOGCVController::PERSON_IN_IMAGE) && (labels[i] != HOGCVController::NO_PERSON_IN_IMAGE))
-    {
-      throw std::invalid_argument("Invalid label");
-    }
-  }
+  // extract the descriptors of every image before touching the current
+  // problem. Decoding and extraction run as a pipeline and each result is
+  // stored at the index of its file. Each file is decoded once: a file
+  // that is not readable by opencv stops the pipeline with
+  // std::invalid_argument while the previous model is still intact.
+  // Todo: send an async event back to view so that user can
+  //       have indication of progress
+  ExtractionJob job(this, fileNames, NULL);
+  extractDescriptors(job);
 
   // if a model was trained, the length of the svm_problem structure will be
   // greater than 0 (representing the number of data instances.
@@ -91,67 +161,19 @@ void HOGCVController::train(std::vector<string> fileNames, std::vector<int> labe
   // construct svm_problem
   problem.l = fileNames.size();
   problem.y = new double[labels.size()];
-  problem.x = new struct svm_node*[fileNames.size()];
-
-  for (int i = 0; i < problem.l;i++)
-  {
-    problem.y[i] = labels[i];
-  }
+  packProblemRows(job);
 
   num_features = 0;
 
   for (int i = 0; i < problem.l;i++)
   {
-    vector<float> descriptorValues;
-    string fileName = fileNames[i];
-    cv::Mat image = imread(fileName.c_str());
-
-    retrieveDescriptors(image,descriptorValues,6,6,3,3);
+    problem.y[i] = labels[i];
 
     // we want the largest descriptor value to describe our number of
     // features
-    if (num_features < descriptorValues.size())
-    {
-      num_features = descriptorValues.size();
-    }
-
-    vector<float>::const_iterator it;
-    it = max_element(descriptorValues.begin(),descriptorValues.end());
-    // Todo: send an async event back to view so that user can
-    //       have indication of progress
-    //       we can register a view to this class and have this
-    //       send a signal to the view class
-    //cout << "Processed fileNo " << fileNo++ << "; Descriptor size = " 
-    //  << descriptorValues.size() << "; max is " << *it << endl;
-
-    // build a sparse matrix of svm_nodes for each file
-    // each svm_node is associated with a descriptor value
-    vector<struct svm_node*> nonzero_nodes;
-    for (unsigned int j = 0; j < descriptorValues.size();j++)
-    {
-      if (descriptorValues[j] != 0)
-      {
-        struct svm_node *new_node = new struct svm_node;
-        new_node->index = j;
-        new_node->value = descriptorValues[j];
-        nonzero_nodes.push_back(new_node);
-      }
-    }
-
-    problem.x[i] = new struct svm_node[nonzero_nodes.size()+1];
-
-    for (unsigned int j = 0;j < nonzero_nodes.size();j++)
+    if (num_features < job.featureCounts[i])
     {
-      problem.x[i][j].index = nonzero_nodes[j]->index;
-      problem.x[i][j].value = nonzero_nodes[j]->value;
-    }
-    problem.x[i][nonzero_nodes.size()].index = -1;
-    problem.x[i][nonzero_nodes.size()].value = -1;
-
-    // clean up the temporary vector
-    for (unsigned int j=0;j<nonzero_nodes.size();j++)
-    {
-      delete nonzero_nodes[j];
+      num_features = job.featureCounts[i];
     }
   }
 
@@ -172,349 +194,619 @@ void HOGCVController::train(std::vector<string> fileNames, std::vector<int> labe
   parameters.p = Parameters::instance()->getP();;
   parameters.shrinking = Parameters::instance()->getShrinking();
   parameters.probability = Parameters::instance()->getProbability();
+}
 
-  // check the parameters
-  const char *error_msg = svm_check_parameter(&problem, &parameters);
-  if (NULL != error_msg)
+size_t HOGCVController::rowNodes(const struct svm_node* row)
+{
+  if (svm_is_dense_row(row))
   {
-    throw std::logic_error(std::string("Error checking parameters " + std::string(error_msg)));
-//"Error when checking Parameters");
+    return svm_dense_row_nodes(svm_dense_row_dim(row));
   }
 
-  // train the model
-  model = svm_train(&problem, &parameters);
+  size_t count = 1;
+  while (row[count-1].index != -1)
+  {
+    count++;
+  }
+  return count;
 }
 
-void HOGCVController::calculateGradOrientation(const cv::Mat& gradX, const cv::Mat& gradY, cv::Mat& gradOrientation)
+void HOGCVController::packProblemRows(ExtractionJob& job)
 {
-  float anOrientation;
-  float gradYVal;
-  float gradXVal;
+  size_t rows = job.nodes.size();
 
-  gradOrientation = cv::Mat::zeros(gradX.rows, gradX.cols, CV_32F);
+  problemOffsets.assign(rows + 1, 0);
+  for (size_t i = 0; i < rows; i++)
+  {
+    problemOffsets[i+1] = problemOffsets[i] + rowNodes(job.nodes[i]);
+  }
 
-  for (int i=0;i<gradOrientation.rows;i++)
+  // the block is only touched as the rows are copied in, and each row is
+  // freed right after, so the rows are not held twice in memory
+  problemNodes = new struct svm_node[problemOffsets[rows]];
+  problem.x = new struct svm_node*[rows];
+
+  for (size_t i = 0; i < rows; i++)
   {
-    for (int j=0;j<gradOrientation.cols;j++)
-    {
-      gradYVal = gradY.at<float>(i,j);
-      gradXVal = gradX.at<float>(i,j);
-      anOrientation = fastAtan2(gradYVal, gradXVal);
+    size_t length = problemOffsets[i+1] - problemOffsets[i];
+    problem.x[i] = problemNodes + problemOffsets[i];
+    std::copy(job.nodes[i], job.nodes[i] + length, problem.x[i]);
 
-      if (anOrientation > 180.0)
-      {
-        anOrientation = anOrientation - 180.0;
-      }
+    delete [] job.nodes[i];
+    job.nodes[i] = NULL;
+  }
+}
 
-      gradOrientation.at<float>(i,j) = anOrientation;
+void HOGCVController::validateLabels(const std::vector<int>& labels)
+{
+  for (unsigned int i=0;i < labels.size();i++)
+  {
+    if ((labels[i] != HOGCVController::PERSON_IN_IMAGE) && (labels[i] != HOGCVController::NO_PERSON_IN_IMAGE))
+    {
+      throw std::invalid_argument("Invalid label");
     }
   }
 }
 
-void HOGCVController::calculateGradMagnitude(const cv::Mat& gradX, const cv::Mat& gradY, cv::Mat& gradMagnitude)
+HOGCVController::ExtractionJob::ExtractionJob(HOGCVController* controller, const std::vector<std::string>& fileNames, const struct svm_model* model)
+: controller(controller), fileNames(fileNames), model(model),
+  nodes(fileNames.size(), (struct svm_node*) NULL),
+  featureCounts(fileNames.size(), 0),
+  predictions(model ? fileNames.size() : 0, 0.0),
+  dense(false)
 {
-  Mat gradXSquared = gradX.mul(gradX);
-  Mat gradYSquared = gradY.mul(gradY);
+}
+
+/// An image waiting to be processed and the index of its file
+struct DecodedImage
+{
+  /// Index of the image's file name
+  int index;
+
+  /// The decoded pixels, empty if the descriptors were cached
+  cv::Mat image;
+
+  /// Set if the descriptors were found in the cache
+  bool cached;
+
+  /// The cached descriptors
+  std::vector<float> descriptors;
+
+  /// Key of the image in the descriptor cache
+  DescriptorCache::Key key;
+};
+
+/// @brief Read the whole contents of a file
+/// @param fileName
+///        Full or relative path to the file
+/// @param bytes
+///        Receives the contents of the file
+///
+/// Returns false if the file cannot be read.
+static bool readFile(const std::string& fileName, std::vector<uchar>& bytes)
+{
+  std::ifstream file(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    return false;
+  }
 
-  gradMagnitude = gradXSquared + gradYSquared;
-  gradMagnitude.convertTo(gradMagnitude,CV_32F);
-  sqrt(gradMagnitude, gradMagnitude);
+  file.seekg(0, std::ios::end);
+  std::streamoff length = file.tellg();
+  if (length <= 0)
+  {
+    return false;
+  }
+  file.seekg(0, std::ios::beg);
+
+  bytes.resize((size_t) length);
+  file.read((char*) &bytes[0], length);
+
+  return (file.gcount() == length);
 }
 
-void HOGCVController::calculateGradients(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradOrient)
+struct HOGCVController::Pipeline
 {
-  vector<cv::Mat> bgr_planes;
-  float kernels[] = {-1.0,0.0,1.0};
-  cv::Mat kernelX; cv::Mat kernelY;
-  cv::Mat gradXB; cv::Mat gradYB;
-  cv::Mat gradXG; cv::Mat gradYG;
-  cv::Mat gradXR; cv::Mat gradYR;
-  cv::Mat gradMagR; cv::Mat gradMagG; cv::Mat gradMagB;
-  cv::Mat gradOrientR; cv::Mat gradOrientG; cv::Mat gradOrientB;
-
-  gradMagR = cv::Mat(image.size(),CV_32F);
-  gradMagG = cv::Mat(image.size(),CV_32F);
-  gradMagB = cv::Mat(image.size(),CV_32F);
-  gradMag = cv::Mat(image.size(),CV_32F);
-  gradOrientR = cv::Mat(image.size(),CV_32F);
-  gradOrientG = cv::Mat(image.size(),CV_32F);
-  gradOrientB = cv::Mat(image.size(),CV_32F);
-  gradOrient = cv::Mat(image.size(),CV_32F);
-
-  kernelX = cv::Mat::ones(1,3,CV_32F);
-  kernelX.at<float>(0) = kernels[0];
-  kernelX.at<float>(1) = kernels[1];
-  kernelX.at<float>(2) = kernels[2];
-
-  kernelY = Mat::ones(3,1,CV_32F);
-  kernelY.at<float>(0) = kernels[0];
-  kernelY.at<float>(1) = kernels[1];
-  kernelY.at<float>(2) = kernels[2];
-
-  split(image,bgr_planes);
-
-  filter2D(bgr_planes[0],gradXB,CV_32F,kernelX);
-  filter2D(bgr_planes[0],gradYB,CV_32F,kernelY);
-  filter2D(bgr_planes[1],gradXG,CV_32F,kernelX);
-  filter2D(bgr_planes[1],gradYG,CV_32F,kernelY);
-  filter2D(bgr_planes[2],gradXR,CV_32F,kernelX);
-  filter2D(bgr_planes[2],gradYR,CV_32F,kernelY);
-
-  calculateGradMagnitude(gradXR, gradYR, gradMagR); 
-  calculateGradMagnitude(gradXG, gradYG, gradMagG); 
-  calculateGradMagnitude(gradXB, gradYB, gradMagB); 
-  calculateGradOrientation(gradXR, gradYR, gradOrientR); 
-  calculateGradOrientation(gradXG, gradYG, gradOrientG); 
-  calculateGradOrientation(gradXB, gradYB, gradOrientB); 
-
-  for (int i=0;i < image.rows;i++)
-  {
-    for (int j=0;j < image.cols;j++)
+  /// @brief Constructor
+  Pipeline(ExtractionJob& job, int decodeWorkers, int extractWorkers, int predictWorkers, size_t capacity)
+  : job(job), decodeWorkers(decodeWorkers), extractWorkers(extractWorkers),
+    predictWorkers(predictWorkers), decoded(capacity), extracted(capacity),
+    nextImage(0), activeDecoders(decodeWorkers), activeExtractors(extractWorkers),
+    aborted(false), invalidImage(false)
+  {
+  }
+
+  /// @brief Stop the pipeline after an image failed
+  /// @param message
+  ///        Describes the failure
+  /// @param unreadable
+  ///        True if the image file could not be decoded
+  void abort(const std::string& message, bool unreadable)
+  {
+    mutex.lock();
+    if (!aborted)
     {
-      float maxVal = gradMagB.at<float>(i,j);
-      gradMag.at<float>(i,j) = gradMagB.at<float>(i,j);
-      gradOrient.at<float>(i,j) = gradOrientB.at<float>(i,j);
+      aborted = true;
+      invalidImage = unreadable;
+      error = message;
+    }
+    mutex.unlock();
 
-      if (gradMagG.at<float>(i,j) > maxVal) 
-      {
-        maxVal = gradMagG.at<float>(i,j);
-        gradMag.at<float>(i,j) = gradMagG.at<float>(i,j);
-        gradOrient.at<float>(i,j) = gradOrientG.at<float>(i,j);
-      }
+    // wake every stage; the consumers drain what is left
+    decoded.close();
+    extracted.close();
+  }
 
-      if (gradMagR.at<float>(i,j) > maxVal)
-      { 
-        gradMag.at<float>(i,j) = gradMagR.at<float>(i,j);
-        gradOrient.at<float>(i,j) = gradOrientR.at<float>(i,j);
-      }
-    }
+  /// Returns true once the pipeline is stopped
+  bool isAborted()
+  {
+    mutex.lock();
+    bool retValue = aborted;
+    mutex.unlock();
+
+    return retValue;
   }
-}
 
-void HOGCVController::retrieveDescriptors(cv::Mat image, vector<float> &allDescriptorValues,int blockSizeX, int blockSizeY, int cellSizeX, int cellSizeY)
-{
-  int startY; int startX; int rangeY; int rangeX;
-  vector<float> blockDescriptorValues;
-  cv::Mat gradMag; cv::Mat gradOrient;
+  /// The images and the results for each of them
+  ExtractionJob& job;
 
-  /*
-   * preprocess image
-   *
-   * for each block
-   *   retrieveDescriptorsFromBlock(gradMagnitudes of image, gradOrientations of image, descriptorValues)
-   *   append descriptorValues to a master list of descriptor values
-   */
+  /// Number of decoding workers
+  int decodeWorkers;
 
-  calculateGradients(image,gradMag,gradOrient);
+  /// Number of extracting workers
+  int extractWorkers;
 
-  /*
-   * for now, we'll just assume that if a set of pixels cannot fit in a 
-   * block, we ignore the pixels. We'll fix this problem later most likely
-   * by allowing the user to either choose how much they want each block
-   * to overlap or having the code choose how much each block should
-   * overlap in order to use the whole picture.
-   */
-  allDescriptorValues.clear();
+  /// Number of predicting workers
+  int predictWorkers;
+
+  /// Images waiting for their descriptors
+  BoundedQueue<DecodedImage> decoded;
+
+  /// Indices of images whose nodes wait for a prediction
+  BoundedQueue<int> extracted;
 
-  rangeY=blockSizeY*cellSizeY;
-  rangeX=blockSizeX*cellSizeX;
-  startY = 0; 
+  /// Protects the counters and the error
+  Mutex mutex;
 
-  while(gradMag.rows > (startY+rangeY))
+  /// The next file to decode
+  int nextImage;
+
+  /// Decoding workers still running; the last one closes decoded
+  int activeDecoders;
+
+  /// Extracting workers still running; the last one closes extracted
+  int activeExtractors;
+
+  /// Set when an image failed
+  bool aborted;
+
+  /// Set when the first failure was a file that could not be decoded
+  bool invalidImage;
+
+  /// Message of the first failure
+  std::string error;
+};
+
+ThreadPool* HOGCVController::threadPool()
+{
+  // a thread for every worker of every stage, predicting included, so the
+  // pool is kept between training and classifying
+  Parameters* params = Parameters::instance();
+  int numThreads = params->getDecodeThreads() + params->getNumThreads() + params->getPredictThreads();
+  if ((NULL == pool) || (pool->size() != numThreads))
   {
-    startX = 0;
-    while (gradMag.cols > (startX+rangeX))
-    {
-      vector<float> blockDescriptors;
-      retrieveDescriptorsFromBlock(gradMag, gradOrient, blockDescriptors, startY, startX, blockSizeX, blockSizeY, cellSizeX, cellSizeY);
-      allDescriptorValues.insert(allDescriptorValues.end(),
-        blockDescriptors.begin(), blockDescriptors.end());
-      startX += rangeX;
-    }
-    startY += rangeY;
+    delete pool;
+    pool = NULL;
+    pool = new ThreadPool(numThreads);
   }
+
+  return pool;
 }
 
-void HOGCVController::retrieveDescriptorsFromBlock(cv::Mat gradMag, cv::Mat gradOrient, vector<float> &allCellDescriptorValues,int startX,int startY, int blockSizeX, int blockSizeY, int cellSizeX, int cellSizeY)
+void HOGCVController::extractDescriptors(ExtractionJob& job)
 {
-//  int row; int col; 
-int rangeX; int rangeY;
-  allCellDescriptorValues.clear();
-  allCellDescriptorValues.assign(9,0.0);
+  Parameters* params = Parameters::instance();
+  int decodeWorkers = params->getDecodeThreads();
+  int extractWorkers = params->getNumThreads();
+  int predictWorkers = (NULL != job.model) ? params->getPredictThreads() : 0;
+  int workers = decodeWorkers + extractWorkers + predictWorkers;
+  job.dense = params->getDenseFeatures();
 
-  rangeX=blockSizeX*cellSizeX;
-  rangeY=blockSizeY*cellSizeY;
+  Pipeline pipeline(job, decodeWorkers, extractWorkers, predictWorkers, params->getQueueCapacity());
 
-  for (int i=startY;i<rangeY;i+=cellSizeY)
+  // the stages block on each other, so every worker needs its own thread;
+  // the loop fails rather than running the workers one after the other
+  threadPool()->runConcurrently(workers, &HOGCVController::runStage, &pipeline);
+
+  if (pipeline.aborted)
   {
-    for (int j=startX;j<rangeX;j+=cellSizeX)
+    for (unsigned int i = 0; i < job.nodes.size(); i++)
     {
-      vector<float> cellDescriptors;
-      cellDescriptors.assign(9,0.0);
-      retrieveDescriptorsFromCell(gradMag, gradOrient,cellDescriptors,j,i,cellSizeX,cellSizeY);
-      for (unsigned int k=0; k < cellDescriptors.size();k++)
-      {
-        allCellDescriptorValues[k] = allCellDescriptorValues[k]
-          + cellDescriptors[k];
-      }
+      delete [] job.nodes[i];
+      job.nodes[i] = NULL;
+    }
+
+    if (pipeline.invalidImage)
+    {
+      throw std::invalid_argument(pipeline.error);
     }
+    throw std::runtime_error(pipeline.error);
   }
+}
 
-  float magnitude = 0.0;
+void HOGCVController::runStage(void* context, int worker)
+{
+  Pipeline* pipeline = static_cast<Pipeline*>(context);
 
-  vector<float>::const_iterator iter;
-  for (iter = allCellDescriptorValues.begin(); 
-    iter != allCellDescriptorValues.end();iter++)
+  if (worker < pipeline->decodeWorkers)
   {
-    magnitude += pow((*iter),2);
+    decodeStage(*pipeline);
   }
-
-  if (magnitude != 0.0)
+  else if (worker < pipeline->decodeWorkers + pipeline->extractWorkers)
   {
-    magnitude = sqrt(magnitude);
-    for (unsigned int k = 0; k < allCellDescriptorValues.size();k++)
-    {
-      allCellDescriptorValues[k] = (allCellDescriptorValues[k] / magnitude) * 100;
-    }
+    extractStage(*pipeline);
+  }
+  else
+  {
+    predictStage(*pipeline);
   }
 }
 
-void HOGCVController::retrieveDescriptorsFromCell(cv::Mat gradMag, cv::Mat gradOrient, vector<float> &cellDescriptorValues, int startX, int startY, int cellSizeX, int cellSizeY)
+void HOGCVController::decodeStage(Pipeline& pipeline)
 {
+  int count = (int) pipeline.job.fileNames.size();
 
-  cellDescriptorValues.assign(9,0.0);
-
-  for (int i=startY;i < (startY+cellSizeY);i++)
+  while (true)
   {
-    for (int j=startX;j < (startX+cellSizeX);j++)
+    pipeline.mutex.lock();
+    int index = pipeline.nextImage++;
+    bool done = pipeline.aborted || (index >= count);
+    pipeline.mutex.unlock();
+
+    if (done)
+    {
+      break;
+    }
+
+    try
     {
-      if ((gradOrient.at<float>(i,j) >= 0.0) && (gradOrient.at<float>(i,j) < 20.0))
+      DecodedImage item;
+      item.index = index;
+      item.cached = false;
+
+      DescriptorCache* cache = pipeline.job.controller->cache;
+      if (NULL == cache)
       {
-        cellDescriptorValues[0] = cellDescriptorValues[0] 
-          + gradMag.at<float>(i,j);
+        item.image = imread(pipeline.job.fileNames[index].c_str());
       }
-      else if ((gradOrient.at<float>(i,j) >= 20.0) && (gradOrient.at<float>(i,j) < 40.0))
+      else
       {
-        cellDescriptorValues[1] = cellDescriptorValues[1] 
-          + gradMag.at<float>(i,j);
+        // the file is read once: its bytes give the key and, on a miss,
+        // are decoded from memory
+        vector<uchar> bytes;
+        if (readFile(pipeline.job.fileNames[index], bytes))
+        {
+          item.key = DescriptorCache::makeKey(&bytes[0], bytes.size(), configHash());
+          item.cached = cache->lookup(item.key, item.descriptors);
+          if (!item.cached)
+          {
+            item.image = imdecode(bytes, CV_LOAD_IMAGE_COLOR);
+          }
+        }
       }
-      else if ((gradOrient.at<float>(i,j) >= 40.0) && (gradOrient.at<float>(i,j) < 60.0))
+
+      if (!item.cached && !item.image.data)
       {
-        cellDescriptorValues[2] = cellDescriptorValues[2] 
-          + gradMag.at<float>(i,j);
+        pipeline.abort("An image could not be loaded", true);
+        break;
       }
-      else if ((gradOrient.at<float>(i,j) >= 60.0) && (gradOrient.at<float>(i,j) < 80.0))
+
+      // blocks while the extractors are behind
+      if (!pipeline.decoded.push(item))
       {
-        cellDescriptorValues[3] = cellDescriptorValues[3] 
-          + gradMag.at<float>(i,j);
+        break;
       }
-      else if ((gradOrient.at<float>(i,j) >= 80.0) && (gradOrient.at<float>(i,j) < 100.0))
+    }
+    catch (const std::exception& e)
+    {
+      pipeline.abort(e.what(), false);
+    }
+  }
+
+  pipeline.mutex.lock();
+  bool last = (--pipeline.activeDecoders == 0);
+  pipeline.mutex.unlock();
+
+  if (last)
+  {
+    pipeline.decoded.close();
+  }
+}
+
+void HOGCVController::extractStage(Pipeline& pipeline)
+{
+  ExtractionJob& job = pipeline.job;
+  DecodedImage item;
+
+  while (pipeline.decoded.pop(item))
+  {
+    if (pipeline.isAborted())
+    {
+      continue;
+    }
+
+    try
+    {
+      vector<float> descriptorValues;
+      DescriptorCache* cache = job.controller->cache;
+      if (item.cached)
       {
-        cellDescriptorValues[4] = cellDescriptorValues[4] 
-          + gradMag.at<float>(i,j);
+        descriptorValues.swap(item.descriptors);
       }
-      else if ((gradOrient.at<float>(i,j) >= 100.0) && (gradOrient.at<float>(i,j) < 120.0))
+      else
       {
-        cellDescriptorValues[5] = cellDescriptorValues[5] 
-          + gradMag.at<float>(i,j);
+        job.controller->retrieveDescriptors(item.image,descriptorValues,BLOCK_SIZE,BLOCK_SIZE,CELL_SIZE,CELL_SIZE);
+        item.image.release();
+
+        // a failed write only means the image is extracted again next time
+        if (NULL != cache)
+        {
+          cache->insert(item.key, descriptorValues);
+        }
       }
-      else if ((gradOrient.at<float>(i,j) >= 120.0) && (gradOrient.at<float>(i,j) < 140.0))
+
+      job.featureCounts[item.index] = descriptorValues.size();
+      job.nodes[item.index] = buildNodes(descriptorValues, job.dense);
+
+      // when classifying, the nodes are only needed for the prediction;
+      // a closed queue means the pipeline was stopped and the nodes are
+      // freed with the others
+      if (NULL != job.model)
       {
-        cellDescriptorValues[6] = cellDescriptorValues[6] 
-          + gradMag.at<float>(i,j);
+        pipeline.extracted.push(item.index);
       }
-      else if ((gradOrient.at<float>(i,j) >= 140.0) && (gradOrient.at<float>(i,j) < 160.0))
+    }
+    catch (const std::exception& e)
+    {
+      pipeline.abort(e.what(), false);
+    }
+  }
+
+  pipeline.mutex.lock();
+  bool last = (--pipeline.activeExtractors == 0);
+  pipeline.mutex.unlock();
+
+  if (last)
+  {
+    pipeline.extracted.close();
+  }
+}
+
+void HOGCVController::predictStage(Pipeline& pipeline)
+{
+  ExtractionJob& job = pipeline.job;
+  vector<int> batch;
+  vector<const struct svm_node*> rows;
+  vector<double> labels(PREDICT_BATCH_SIZE);
+  int index;
+
+  // wait for one image, then take whatever else is already waiting
+  while (pipeline.extracted.pop(index))
+  {
+    batch.assign(1, index);
+    while (((int) batch.size() < PREDICT_BATCH_SIZE) && pipeline.extracted.tryPop(index))
+    {
+      batch.push_back(index);
+    }
+
+    if (pipeline.isAborted())
+    {
+      continue;
+    }
+
+    try
+    {
+      rows.resize(batch.size());
+      for (unsigned int i = 0; i < batch.size(); i++)
       {
-        cellDescriptorValues[7] = cellDescriptorValues[7] 
-          + gradMag.at<float>(i,j);
+        rows[i] = job.nodes[batch[i]];
       }
-      else if ((gradOrient.at<float>(i,j) >= 160.0) && (gradOrient.at<float>(i,j) <= 180.0))
+
+      svm_predict_batch(job.model, &rows[0], (int) rows.size(), &labels[0], NULL);
+
+      for (unsigned int i = 0; i < batch.size(); i++)
       {
-        cellDescriptorValues[8] = cellDescriptorValues[8] 
-          + gradMag.at<float>(i,j);
+        job.predictions[batch[i]] = labels[i];
+        delete [] job.nodes[batch[i]];
+        job.nodes[batch[i]] = NULL;
       }
     }
+    catch (const std::exception& e)
+    {
+      pipeline.abort(e.what(), false);
+    }
   }
 }
 
-void HOGCVController::classify(const std::vector<string>& fileNames, const std::vector<int>& actualLabels, float& percentageCorrect, std::vector<int>& predictedLabels)
+void HOGCVController::predictBatch(const std::vector<std::vector<float> >& descriptors, std::vector<int>& predictedLabels)
 {
-  // must supply at least one file to classify
-  if (fileNames.size() < 1) 
+  if (NULL == model)
   {
-    throw std::invalid_argument("Must select one or more images to classify");
+    throw std::logic_error("Model not trained");
   }
 
-  // since we're calculating the percentage correct, we assume that
-  // an actual label is associated with each file
-  if (actualLabels.size() != fileNames.size()) 
+  bool dense = Parameters::instance()->getDenseFeatures();
+  vector<struct svm_node*> rows(descriptors.size(), (struct svm_node*) NULL);
+  vector<double> labels(descriptors.size());
+
+  for (unsigned int i = 0; i < descriptors.size(); i++)
   {
-    throw std::invalid_argument("Number of labels must equal number of files");
+    rows[i] = buildNodes(descriptors[i], dense);
+  }
+
+  if (!rows.empty())
+  {
+    svm_predict_batch(model, &rows[0], (int) rows.size(), &labels[0], NULL);
   }
 
-  // each file must be readable and valid according to opencv
-  // and the labels provided must be valid
-  for (unsigned int i=0;i < fileNames.size();i++)
+  for (unsigned int i = 0; i < rows.size(); i++)
   {
-    cv::Mat image = imread(fileNames[i].c_str());
-    if (!image.data)
+    delete [] rows[i];
+    predictedLabels.push_back((int) labels[i]);
+  }
+}
+
+struct svm_node* HOGCVController::buildNodes(const vector<float>& descriptorValues, bool dense)
+{
+  // a dense row keeps the floats as they are, packed behind a header node
+  if (dense)
+  {
+    int dim = (int) descriptorValues.size();
+    struct svm_node* x = new struct svm_node[svm_dense_row_nodes(dim)];
+    svm_fill_dense_row(x, dim ? &descriptorValues[0] : NULL, dim);
+    return x;
+  }
+
+  // build a sparse vector of svm_nodes, one for each nonzero descriptor
+  // value, terminated by an index of -1
+  size_t nonzero = 0;
+  for (unsigned int j = 0; j < descriptorValues.size();j++)
+  {
+    if (descriptorValues[j] != 0)
     {
-      throw std::invalid_argument("An image could not be loaded");
+      nonzero++;
     }
-    if ((actualLabels[i] != HOGCVController::PERSON_IN_IMAGE) && (actualLabels[i] != HOGCVController::NO_PERSON_IN_IMAGE))
+  }
+
+  struct svm_node* x = new struct svm_node[nonzero+1];
+  size_t k = 0;
+  for (unsigned int j = 0; j < descriptorValues.size();j++)
+  {
+    if (descriptorValues[j] != 0)
     {
-      throw std::invalid_argument("Invalid label");
+      x[k].index = j;
+      x[k].value = descriptorValues[j];
+      k++;
     }
   }
+  x[nonzero].index = -1;
+  x[nonzero].value = -1;
 
-  // we need to have a trained model before classifying
-  if (NULL == model)
+  return x;
+}
+
+void HOGCVController::calculateGradients(const cv::Mat& image, cv::Mat& gradMag, cv::Mat& gradBin)
+{
+  // the fused kernel reads the interleaved image once, picks the
+  // strongest channel per pixel and bins its orientation without any
+  // trigonometry
+  GradientKernel::computeBinned(image, gradMag, gradBin, HOGCVController::ORIENTATION_BINS);
+}
+
+uint64_t HOGCVController::configHash()
+{
+  // bump the version whenever the extraction changes in a way the other
+  // settings do not capture
+  const int settings[] = { 1,
+                           HOGCVController::BLOCK_SIZE, HOGCVController::BLOCK_SIZE,
+                           HOGCVController::CELL_SIZE, HOGCVController::CELL_SIZE,
+                           HOGCVController::ORIENTATION_BINS,
+                           std::max(HOGCVController::BLOCK_SIZE / 2, 1),
+                           (int) CellHistograms::HARD,
+                           (int) BlockDescriptors::L2_HYS };
+
+  return DescriptorCache::hash(settings, sizeof(settings));
+}
+
+void HOGCVController::setDescriptorCache(const std::string& path)
+{
+  DescriptorCache* newCache = NULL;
+  if (!path.empty())
   {
-    throw std::logic_error("Model not trained");
+    newCache = new DescriptorCache(path);
   }
 
-  double predictedLabel; 
+  delete cache;
+  cache = newCache;
+}
+
+void HOGCVController::buildIntegralHistogram(const cv::Mat& image, IntegralHistogram& integral)
+{
+  cv::Mat gradMag; cv::Mat gradBin;
+
+  calculateGradients(image,gradMag,gradBin);
+  integral.compute(gradMag, gradBin, HOGCVController::ORIENTATION_BINS);
+}
+
+void HOGCVController::retrieveDescriptors(cv::Mat image, vector<float> &allDescriptorValues,int blockSizeX, int blockSizeY, int cellSizeX, int cellSizeY)
+{
+  cv::Mat gradMag; cv::Mat gradBin;
+
+  /*
+   * preprocess image
+   *
+   * compute the histogram of every cell once
+   * for each block, stepping half a block at a time
+   *   concatenate the histograms of the cells in the block and normalize
+   *   append the block to a master list of descriptor values
+   *
+   * pixels to the right of or below the last complete cell are ignored
+   */
+
+  calculateGradients(image,gradMag,gradBin);
+
+  CellHistograms cells;
+  cells.compute(gradMag, gradBin, cellSizeX, cellSizeY, HOGCVController::ORIENTATION_BINS, CellHistograms::HARD);
+
+  BlockDescriptors blocks(blockSizeX, blockSizeY,
+                          std::max(blockSizeX / 2, 1), std::max(blockSizeY / 2, 1),
+                          BlockDescriptors::L2_HYS);
+  blocks.compute(cells, allDescriptorValues);
+}
 
-  std::vector<string>::const_iterator iter;
-  for (iter = fileNames.begin();iter != fileNames.end();iter++)
+void HOGCVController::classify(const std::vector<string>& fileNames, const std::vector<int>& actualLabels, float& percentageCorrect, std::vector<int>& predictedLabels)
+{
+  // must supply at least one file to classify
+  if (fileNames.size() < 1) 
   {
-    vector<float> descriptorValues;
-    struct svm_node *x;
-    string fileName = (*iter);
-    cv::Mat image = imread(fileName.c_str());
+    throw std::invalid_argument("Must select one or more images to classify");
+  }
 
-    retrieveDescriptors(image,descriptorValues,6,6,3,3);
+  // since we're calculating the percentage correct, we assume that
+  // an actual label is associated with each file
+  if (actualLabels.size() != fileNames.size()) 
+  {
+    throw std::invalid_argument("Number of labels must equal number of files");
+  }
 
-    // build a sparse matrix of svm_nodes
-    vector<struct svm_node*> nonzero_nodes;
-    for (unsigned int j = 0; j < descriptorValues.size();j++)
+  // the labels provided must be valid
+  validateLabels(actualLabels);
+
+  // we need to have a trained model before classifying. Unreadable files
+  // are still reported first, so this is the only path that decodes the
+  // files without extracting them.
+  if (NULL == model)
+  {
+    for (unsigned int i=0;i < fileNames.size();i++)
     {
-      if (descriptorValues[j] != 0)
+      cv::Mat image = imread(fileNames[i].c_str());
+      if (!image.data)
       {
-        struct svm_node *new_node = new struct svm_node;
-        new_node->index = j;
-        new_node->value = descriptorValues[j];
-        nonzero_nodes.push_back(new_node);
+        throw std::invalid_argument("An image could not be loaded");
       }
     }
-    x = new struct svm_node[nonzero_nodes.size()+1];
-    for (unsigned int j = 0;j < nonzero_nodes.size();j++)
-    {
-      x[j].index = nonzero_nodes[j]->index;
-      x[j].value = nonzero_nodes[j]->value;
-    }
-    x[nonzero_nodes.size()].index = -1;
-    x[nonzero_nodes.size()].value = -1;
+    throw std::logic_error("Model not trained");
+  }
 
-    // clean up the temporary vector
-    for (unsigned int j=0;j<nonzero_nodes.size();j++)
-    {
-      delete nonzero_nodes[j];
-    }
+  // decode, extract and predict as a pipeline; the predictions are
+  // stored at the index of their file. A file that is not readable by
+  // opencv stops the pipeline with std::invalid_argument.
+  ExtractionJob job(this, fileNames, model);
+  extractDescriptors(job);
 
-    predictedLabel = svm_predict(model,x);
-    predictedLabels.push_back(predictedLabel);
-    delete x;
+  for (unsigned int i = 0;i < job.predictions.size();i++)
+  {
+    predictedLabels.push_back(job.predictions[i]);
   }
 
   int numberCorrect;
@@ -534,12 +826,19 @@ HOGCVController::HOGCVController()
   problem.l = 0;
   problem.y = NULL;
   problem.x = NULL;
+  problemNodes = NULL;
 
   model = NULL;
+
+  pool = NULL;
+
+  cache = NULL;
 }
 
 HOGCVController::~HOGCVController()
 {
+  delete pool;
+  delete cache;
 }
 
 void HOGCVController::cleanUpSvmModel()
@@ -547,13 +846,12 @@ void HOGCVController::cleanUpSvmModel()
   if (problem.l > 0)
   {
     delete [] problem.y;
-
-    for (int i = 0; i < problem.l; i++)
-    {
-      delete [] problem.x[i];
-    }
-
     delete [] problem.x;
+    delete [] problemNodes;
+    problem.y = NULL;
+    problem.x = NULL;
+    problemNodes = NULL;
+    problemOffsets.clear();
     problem.l = 0;
   }
 
@@ -0,0 +1,104 @@
+#include "IntegralHistogram.hpp"
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "opencv2/core/core.hpp"
+
+IntegralHistogram::IntegralHistogram()
+: numRows(0), numCols(0), numBins(0)
+{
+}
+
+void IntegralHistogram::compute(const cv::Mat& gradMag, const cv::Mat& gradOrient, int nbins)
+{
+  if ((gradMag.type() != CV_32F) ||
+      ((gradOrient.type() != CV_8U) && (gradOrient.type() != CV_32F)))
+  {
+    throw std::invalid_argument("Unsupported gradient matrix type");
+  }
+
+  if ((gradMag.rows != gradOrient.rows) || (gradMag.cols != gradOrient.cols))
+  {
+    throw std::invalid_argument("Gradient matrices must have the same size");
+  }
+
+  if ((nbins < 1) || (nbins > 255))
+  {
+    throw std::invalid_argument("Number of orientation bins must be between 1 and 255");
+  }
+
+  numRows = gradMag.rows;
+  numCols = gradMag.cols;
+  numBins = nbins;
+
+  size_t rowStride = (size_t) (numCols + 1) * numBins;
+  float binsPerDegree = numBins / 180.0f;
+
+  // the first row and column of the integral are 0
+  data.assign((size_t) (numRows + 1) * rowStride, 0.0);
+
+  std::vector<double> rowSum(numBins);
+  std::vector<uchar> binBuffer(numCols);
+
+  for (int i = 0; i < numRows; i++)
+  {
+    const float* magRow = gradMag.ptr<float>(i);
+    const double* above = &data[(size_t) i * rowStride];
+    double* current = &data[(size_t) (i + 1) * rowStride];
+    const uchar* binRow;
+
+    if (gradOrient.type() == CV_8U)
+    {
+      binRow = gradOrient.ptr<uchar>(i);
+    }
+    else
+    {
+      const float* orientRow = gradOrient.ptr<float>(i);
+      for (int j = 0; j < numCols; j++)
+      {
+        int bin = (int) (orientRow[j] * binsPerDegree);
+        binBuffer[j] = (uchar) ((bin >= numBins) ? bin - numBins : bin);
+      }
+      binRow = &binBuffer[0];
+    }
+
+    std::fill(rowSum.begin(), rowSum.end(), 0.0);
+
+    for (int j = 0; j < numCols; j++)
+    {
+      if (binRow[j] < numBins)
+      {
+        rowSum[binRow[j]] += magRow[j];
+      }
+
+      // entry j+1 of this row is the entry above plus the sums of the row
+      // so far
+      const double* up = above + (size_t) (j + 1) * numBins;
+      double* out = current + (size_t) (j + 1) * numBins;
+      for (int b = 0; b < numBins; b++)
+      {
+        out[b] = up[b] + rowSum[b];
+      }
+    }
+  }
+}
+
+void IntegralHistogram::histogram(const cv::Rect& region, float* histogram) const
+{
+  if ((region.x < 0) || (region.y < 0) || (region.width < 0) || (region.height < 0) ||
+      (region.x + region.width > numCols) || (region.y + region.height > numRows))
+  {
+    throw std::invalid_argument("Region must lie inside the image");
+  }
+
+  size_t rowStride = (size_t) (numCols + 1) * numBins;
+  size_t left = (size_t) region.x * numBins;
+  size_t right = (size_t) (region.x + region.width) * numBins;
+  const double* top = &data[(size_t) region.y * rowStride];
+  const double* bottom = &data[(size_t) (region.y + region.height) * rowStride];
+
+  for (int b = 0; b < numBins; b++)
+  {
+    histogram[b] = (float) (bottom[right + b] - bottom[left + b] - top[right + b] + top[left + b]);
+  }
+}
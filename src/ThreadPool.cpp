@@ -0,0 +1,274 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <string>
+#include <stdexcept>
+
+ThreadPool::ThreadPool(int numThreads)
+: loops(NULL), stopping(false)
+{
+  if (numThreads < 1)
+  {
+    throw std::invalid_argument("Number of threads must be positive");
+  }
+
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&workAvailable, NULL);
+  pthread_cond_init(&workDone, NULL);
+
+  for (int i = 1; i < numThreads; i++)
+  {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &ThreadPool::workerMain, this) != 0)
+    {
+      shutdown();
+      throw std::runtime_error("Could not start a worker thread");
+    }
+    workers.push_back(thread);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  shutdown();
+}
+
+void ThreadPool::shutdown()
+{
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  pthread_cond_broadcast(&workAvailable);
+  pthread_mutex_unlock(&mutex);
+
+  for (unsigned int i = 0; i < workers.size(); i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+  workers.clear();
+
+  pthread_cond_destroy(&workDone);
+  pthread_cond_destroy(&workAvailable);
+  pthread_mutex_destroy(&mutex);
+}
+
+void* ThreadPool::workerMain(void* pool)
+{
+  static_cast<ThreadPool*>(pool)->workerLoop();
+  return NULL;
+}
+
+void ThreadPool::workerLoop()
+{
+  pthread_mutex_lock(&mutex);
+  while (true)
+  {
+    Loop* loop = NULL;
+    while (!stopping && ((loop = findLoop()) == NULL))
+    {
+      pthread_cond_wait(&workAvailable, &mutex);
+    }
+
+    if (stopping)
+    {
+      break;
+    }
+
+    loop->joinedWorkers++;
+    loop->activeWorkers++;
+    pthread_mutex_unlock(&mutex);
+
+    runIterations(*loop);
+
+    pthread_mutex_lock(&mutex);
+    loop->activeWorkers--;
+    if (loop->activeWorkers == 0)
+    {
+      pthread_cond_broadcast(&workDone);
+    }
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+ThreadPool::Loop* ThreadPool::findLoop()
+{
+  // the oldest loops go first, so the threads of a concurrent loop are not
+  // taken by the loops its iterations start
+  for (Loop* loop = loops; loop != NULL; loop = loop->nextLoop)
+  {
+    if ((loop->next < loop->count) && (loop->joinedWorkers < loop->maxWorkers))
+    {
+      return loop;
+    }
+  }
+  return NULL;
+}
+
+void ThreadPool::runIterations(Loop& loop)
+{
+  while (true)
+  {
+    pthread_mutex_lock(&mutex);
+    int index = loop.next++;
+    pthread_mutex_unlock(&mutex);
+
+    if (index >= loop.count)
+    {
+      return;
+    }
+
+    try
+    {
+      loop.task(loop.context, index);
+    }
+    catch (const std::exception& e)
+    {
+      recordError(loop, e.what());
+    }
+    catch (...)
+    {
+      recordError(loop, "Unknown error in a parallel loop");
+    }
+  }
+}
+
+void ThreadPool::recordError(Loop& loop, const std::string& message)
+{
+  pthread_mutex_lock(&mutex);
+  if (!loop.failed)
+  {
+    loop.failed = true;
+    loop.error = message;
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void ThreadPool::parallelFor(int count, Task task, void* context)
+{
+  parallelFor(count, task, context, size());
+}
+
+void ThreadPool::parallelFor(int count, Task task, void* context, int maxThreads)
+{
+  if (count <= 0)
+  {
+    return;
+  }
+
+  // the loop may not use the workers, so run it on the calling thread
+  if (workers.empty() || (maxThreads < 2))
+  {
+    runSerially(count, task, context);
+    return;
+  }
+
+  runOnWorkers(count, task, context, std::min(maxThreads, size()) - 1, false);
+}
+
+void ThreadPool::runConcurrently(int count, Task task, void* context)
+{
+  if (count <= 0)
+  {
+    return;
+  }
+
+  if (count > size())
+  {
+    throw std::logic_error("More concurrent iterations than threads in the pool");
+  }
+
+  if (count == 1)
+  {
+    runSerially(count, task, context);
+    return;
+  }
+
+  // with no other loop every worker is free, and a thread holds one
+  // iteration at a time, so every iteration is claimed while the others
+  // block
+  runOnWorkers(count, task, context, count - 1, true);
+}
+
+void ThreadPool::runSerially(int count, Task task, void* context)
+{
+  std::string message;
+  bool serialFailed = false;
+
+  for (int i = 0; i < count; i++)
+  {
+    try
+    {
+      task(context, i);
+    }
+    catch (const std::exception& e)
+    {
+      if (!serialFailed)
+      {
+        serialFailed = true;
+        message = e.what();
+      }
+    }
+    catch (...)
+    {
+      if (!serialFailed)
+      {
+        serialFailed = true;
+        message = "Unknown error in a parallel loop";
+      }
+    }
+  }
+
+  if (serialFailed)
+  {
+    throw std::runtime_error(message);
+  }
+}
+
+void ThreadPool::runOnWorkers(int count, Task task, void* context, int maxWorkers,
+                              bool exclusive)
+{
+  Loop loop;
+  loop.task = task;
+  loop.context = context;
+  loop.count = count;
+  loop.next = 0;
+  loop.maxWorkers = maxWorkers;
+  loop.joinedWorkers = 0;
+  loop.activeWorkers = 0;
+  loop.failed = false;
+  loop.nextLoop = NULL;
+
+  pthread_mutex_lock(&mutex);
+  if (exclusive && (loops != NULL))
+  {
+    pthread_mutex_unlock(&mutex);
+    throw std::logic_error("The thread pool is already running a loop");
+  }
+  Loop** last = &loops;
+  while (*last != NULL)
+  {
+    last = &(*last)->nextLoop;
+  }
+  *last = &loop;
+  pthread_cond_broadcast(&workAvailable);
+  pthread_mutex_unlock(&mutex);
+
+  runIterations(loop);
+
+  // the loop belongs to the caller until every worker has left it
+  pthread_mutex_lock(&mutex);
+  while (loop.activeWorkers > 0)
+  {
+    pthread_cond_wait(&workDone, &mutex);
+  }
+  last = &loops;
+  while (*last != &loop)
+  {
+    last = &(*last)->nextLoop;
+  }
+  *last = loop.nextLoop;
+  pthread_mutex_unlock(&mutex);
+
+  if (loop.failed)
+  {
+    throw std::runtime_error(loop.error);
+  }
+}
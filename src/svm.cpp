@@ -40,7 +40,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "svm.h"
+#include "SVMThreadPool.hpp"
 int libsvm_version = LIBSVM_VERSION;
 typedef float Qfloat;
 typedef signed char schar;
@@ -91,6 +97,9 @@ static void info(const char *fmt,...)
 static void info(const char *fmt,...) {}
 #endif
 
+// slots a reservation looks at for one to spare
+#define RESERVE_SCAN 16
+
 //
 // Kernel Cache
 //
@@ -108,242 +117,1494 @@ public:
 	// (p >= len if nothing needs to be filled)
 	int get_data(const int index, Qfloat **data, int len);
 	void swap_index(int i, int j);	
+
+	// whether get_data is likely to need nothing filled
+	bool cached(int index, int len) const
+	{
+		return head[index].slot >= 0 && head[index].len >= len;
+	}
+
+	// the slot of column index, whose entries [*start,len) the caller
+	// fills from another thread, or NULL if no slot is to spare. The column
+	// stays in its slot until unreserved with the length then filled,
+	// which must happen before it is requested or any entries are swapped
+	Qfloat *reserve(int index, int len, int *start);
+	void unreserve(int index, int len);
 private:
 	int l;
-	long int size;
 	struct head_t
 	{
-		head_t *prev, *next;	// a circular list
 		Qfloat *data;
 		int len;		// data[0,len) is cached in this entry
+		int slot;		// slot holding the column, or -1
+		long int replayed;	// swaps of the log applied to data
 	};
 
 	head_t *head;
-	head_t lru_head;
-	void lru_delete(head_t *h);
-	void lru_insert(head_t *h);
+
+	// the columns live in fixed slots of l entries in one slab, so a
+	// column grows in place and nothing is allocated after construction
+	Qfloat *slab;
+	size_t slab_bytes;
+	bool slab_mapped;
+	long int stride;
+
+	// CLOCK eviction: the hand passes over referenced slots once before
+	// evicting them, and never evicts the slot returned last, which the
+	// caller may still be reading
+	int nr_slots;
+	int *slot_owner;	// column in each slot, or -1 if free
+	char *referenced;
+	int hand;
+	int pinned;
+	int take_slot();
+
+	// reserved slots are skipped by the hand; two slots are always left
+	// unreserved for the columns the caller reads
+	char *reserved;
+	int nr_reserved;
+	int spare_slot();
+	void release(head_t *h);
+
+	// swaps of entries are logged and applied to a column only when it is
+	// requested again, instead of to every cached column at once
+	int *swap_log;		// pairs i<j
+	int log_len, log_cap;
+	long int log_base;	// number of swaps before swap_log[0]
+	void replay(head_t *h);
+	void compact_log();
+};
+
+Cache::Cache(int l_,long int size_):l(l_)
+{
+	head = (head_t *)calloc(l,sizeof(head_t));	// initialized to 0
+	for(int i=0;i<l;i++)
+		head[i].slot = -1;
+	long int size = size_ / sizeof(Qfloat);
+	size -= l * sizeof(head_t) / sizeof(Qfloat);
+
+	// cache must be large enough for two columns, and never needs more
+	// than one slot per column
+	stride = max(l,1);
+	nr_slots = (int)min(size / stride,(long int)l);
+	nr_slots = max(nr_slots,2);
+	slab_bytes = sizeof(Qfloat)*(size_t)stride*nr_slots;
+
+	// the slab is mapped so its pages are only committed once used, and
+	// may be backed by huge pages
+	slab_mapped = false;
+	slab = NULL;
+#ifdef MAP_ANONYMOUS
+	void *address = mmap(NULL,slab_bytes,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	if(address != MAP_FAILED)
+	{
+		slab = (Qfloat *)address;
+		slab_mapped = true;
+#ifdef MADV_HUGEPAGE
+		madvise(address,slab_bytes,MADV_HUGEPAGE);
+#endif
+	}
+#endif
+	if(slab == NULL)
+		slab = (Qfloat *)malloc(slab_bytes);
+
+	slot_owner = Malloc(int,nr_slots);
+	referenced = Malloc(char,nr_slots);
+	reserved = Malloc(char,nr_slots);
+	for(int k=0;k<nr_slots;k++)
+	{
+		slot_owner[k] = -1;
+		referenced[k] = 0;
+		reserved[k] = 0;
+	}
+	nr_reserved = 0;
+	hand = 0;
+	pinned = -1;
+
+	// a solve makes fewer than 2l swaps, since shrinking only lowers the
+	// active size until the one unshrink, so a log of 2l swaps would never
+	// be compacted; a quarter of l keeps the swaps a column replays few
+	log_cap = max(l/4,1);
+	swap_log = Malloc(int,2*log_cap);
+	log_len = 0;
+	log_base = 0;
+}
+
+Cache::~Cache()
+{
+#ifdef MAP_ANONYMOUS
+	if(slab_mapped)
+		munmap(slab,slab_bytes);
+	else
+#endif
+		free(slab);
+	free(slot_owner);
+	free(referenced);
+	free(reserved);
+	free(swap_log);
+	free(head);
+}
+
+// a free slot, or the slot of a column not referenced since the hand
+// last passed it
+int Cache::take_slot()
+{
+	for(;;)
+	{
+		int k = hand;
+		hand = (hand+1 == nr_slots) ? 0 : hand+1;
+		if(slot_owner[k] < 0)
+			return k;
+		if(k == pinned || reserved[k])
+			continue;
+		if(referenced[k])
+		{
+			referenced[k] = 0;
+			continue;
+		}
+		release(&head[slot_owner[k]]);
+		return k;
+	}
+}
+
+// a free slot, or the slot of a column not referenced lately, among the
+// next few of the hand, or -1; the hand and the references are left alone
+// so a reservation does not evict the columns in use
+int Cache::spare_slot()
+{
+	int n = min(nr_slots,RESERVE_SCAN);
+	for(int m=0,k=hand;m<n;m++,k=(k+1 == nr_slots) ? 0 : k+1)
+	{
+		if(slot_owner[k] < 0)
+			return k;
+		if(k != pinned && !reserved[k] && !referenced[k])
+		{
+			release(&head[slot_owner[k]]);
+			return k;
+		}
+	}
+	return -1;
+}
+
+void Cache::release(head_t *h)
+{
+	slot_owner[h->slot] = -1;
+	referenced[h->slot] = 0;
+	h->slot = -1;
+	h->data = 0;
+	h->len = 0;
+}
+
+// apply the logged swaps a column has not seen; a swap with an entry the
+// column lacks cuts the column short before it
+void Cache::replay(head_t *h)
+{
+	int len = h->len;
+	Qfloat *data = h->data;
+	for(int k=(int)(h->replayed-log_base);k<log_len;k++)
+	{
+		int i = swap_log[2*k], j = swap_log[2*k+1];
+		if(len > j)
+			swap(data[i],data[j]);
+		else if(len > i)
+			len = i;
+	}
+	h->len = len;
+	h->replayed = log_base+log_len;
+	if(len == 0)
+		release(h);
+}
+
+// a full log is cleared: the columns referenced lately are brought up to
+// date and the others, which are about to be evicted anyway, are dropped
+void Cache::compact_log()
+{
+	for(int k=0;k<nr_slots;k++)
+	{
+		if(slot_owner[k] < 0)
+			continue;
+		head_t *h = &head[slot_owner[k]];
+		if(h->replayed == log_base+log_len)
+			continue;
+		if(referenced[k] || k == pinned)
+			replay(h);
+		else
+			release(h);
+	}
+	log_base += log_len;
+	log_len = 0;
+}
+
+int Cache::get_data(const int index, Qfloat **data, int len)
+{
+	head_t *h = &head[index];
+	if(h->slot >= 0)
+		replay(h);
+
+	if(h->slot < 0)
+	{
+		int k = take_slot();
+		slot_owner[k] = index;
+		h->slot = k;
+		h->data = slab+stride*k;
+		h->len = 0;
+		h->replayed = log_base+log_len;
+	}
+	referenced[h->slot] = 1;
+	pinned = h->slot;
+
+	// the slot holds a whole column, so it grows without moving
+	if(len > h->len)
+		swap(h->len,len);
+
+	*data = h->data;
+	return len;
+}
+
+Qfloat *Cache::reserve(int index, int len, int *start)
+{
+	if(nr_reserved+2 >= nr_slots)
+		return NULL;
+	head_t *h = &head[index];
+	if(h->slot >= 0)
+		replay(h);
+
+	if(h->slot < 0)
+	{
+		int k = spare_slot();
+		if(k < 0)
+			return NULL;
+		slot_owner[k] = index;
+		h->slot = k;
+		h->data = slab+stride*k;
+		h->len = 0;
+		h->replayed = log_base+log_len;
+	}
+	reserved[h->slot] = 1;
+	nr_reserved++;
+	*start = min(h->len,len);
+	return h->data;
+}
+
+void Cache::unreserve(int index, int len)
+{
+	head_t *h = &head[index];
+	reserved[h->slot] = 0;
+	nr_reserved--;
+	referenced[h->slot] = 1;
+	h->len = max(h->len,len);
+	if(h->len == 0)
+		release(h);
+}
+
+void Cache::swap_index(int i, int j)
+{
+	if(i==j) return;
+
+	swap(head[i],head[j]);
+	if(head[i].slot >= 0) slot_owner[head[i].slot] = i;
+	if(head[j].slot >= 0) slot_owner[head[j].slot] = j;
+
+	if(log_len == log_cap)
+		compact_log();
+	if(i>j) swap(i,j);
+	swap_log[2*log_len] = i;
+	swap_log[2*log_len+1] = j;
+	log_len++;
+}
+
+//
+// Dense rows
+//
+// the float features of a dense row are packed in the nodes following its
+// header, so the row is still an array of svm_node and every pointer to a
+// row stays valid
+//
+static inline bool is_dense(const svm_node *x)
+{
+	return x->index == SVM_DENSE_INDEX;
+}
+
+static inline int dense_dim(const svm_node *x)
+{
+	return (int)x->value;
+}
+
+static inline const float *dense_values(const svm_node *x)
+{
+	return (const float *)(x+1);
+}
+
+// number of nodes holding dim floats
+static inline int dense_slots(int dim)
+{
+	int per_node = (int)(sizeof(svm_node)/sizeof(float));
+	return (dim+per_node-1)/per_node;
+}
+
+// the products are summed in double precision like the sparse dot product
+static double dense_dot(const float *x, const float *y, int n)
+{
+	double sum = 0;
+	int i = 0;
+#ifdef __SSE2__
+	__m128d sum_lo = _mm_setzero_pd();
+	__m128d sum_hi = _mm_setzero_pd();
+	for(;i+4<=n;i+=4)
+	{
+		__m128 vx = _mm_loadu_ps(x+i);
+		__m128 vy = _mm_loadu_ps(y+i);
+		sum_lo = _mm_add_pd(sum_lo,_mm_mul_pd(_mm_cvtps_pd(vx),_mm_cvtps_pd(vy)));
+		sum_hi = _mm_add_pd(sum_hi,_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(vx,vx)),
+						      _mm_cvtps_pd(_mm_movehl_ps(vy,vy))));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes,_mm_add_pd(sum_lo,sum_hi));
+	sum = lanes[0]+lanes[1];
+#endif
+	for(;i<n;i++)
+		sum += (double)x[i]*y[i];
+	return sum;
+}
+
+// squared euclidean distance of two dense vectors
+static double dense_distance(const float *x, const float *y, int n)
+{
+	double sum = 0;
+	int i = 0;
+#ifdef __SSE2__
+	__m128d sum_lo = _mm_setzero_pd();
+	__m128d sum_hi = _mm_setzero_pd();
+	for(;i+4<=n;i+=4)
+	{
+		__m128 vx = _mm_loadu_ps(x+i);
+		__m128 vy = _mm_loadu_ps(y+i);
+		__m128d d_lo = _mm_sub_pd(_mm_cvtps_pd(vx),_mm_cvtps_pd(vy));
+		__m128d d_hi = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(vx,vx)),
+					  _mm_cvtps_pd(_mm_movehl_ps(vy,vy)));
+		sum_lo = _mm_add_pd(sum_lo,_mm_mul_pd(d_lo,d_lo));
+		sum_hi = _mm_add_pd(sum_hi,_mm_mul_pd(d_hi,d_hi));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes,_mm_add_pd(sum_lo,sum_hi));
+	sum = lanes[0]+lanes[1];
+#endif
+	for(;i<n;i++)
+	{
+		double d = (double)x[i]-y[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+// dot product of a sparse row and a dense row; sparse indices are sorted
+static double sparse_dense_dot(const svm_node *px, const float *y, int n)
+{
+	double sum = 0;
+	for(;px->index != -1 && px->index < n;++px)
+		if(px->index >= 0)
+			sum += px->value * y[px->index];
+	return sum;
+}
+
+// dot product of a short sparse row with a long one of ny nodes, finding
+// each index of the short row with an exponential then a binary search
+static double gallop_dot(const svm_node *px, const svm_node *py, int ny)
+{
+	double sum = 0;
+	int lo = 0;
+	for(;px->index != -1 && lo < ny;++px)
+	{
+		int target = px->index;
+
+		// every node before lo has a smaller index
+		int hi = lo, step = 1;
+		while(hi < ny && py[hi].index < target)
+		{
+			lo = hi+1;
+			hi = lo+step;
+			step *= 2;
+		}
+		hi = min(hi,ny);
+		while(lo < hi)
+		{
+			int mid = lo+(hi-lo)/2;
+			if(py[mid].index < target)
+				lo = mid+1;
+			else
+				hi = mid;
+		}
+
+		if(lo < ny && py[lo].index == target)
+		{
+			sum += px->value * py[lo].value;
+			++lo;
+		}
+	}
+	return sum;
+}
+
+// squared distance of two rows, at least one of them dense
+static double mixed_distance(const svm_node *x, const svm_node *y)
+{
+	if(is_dense(x) && is_dense(y))
+	{
+		int nx = dense_dim(x), ny = dense_dim(y);
+		int n = min(nx,ny);
+		const float *vx = dense_values(x);
+		const float *vy = dense_values(y);
+		double sum = dense_distance(vx,vy,n);
+		if(nx > n)
+			sum += dense_dot(vx+n,vx+n,nx-n);
+		if(ny > n)
+			sum += dense_dot(vy+n,vy+n,ny-n);
+		return sum;
+	}
+
+	if(is_dense(x))
+		swap(x,y);
+
+	// x is sparse: start from |y|^2 and correct the features present in x
+	int n = dense_dim(y);
+	const float *vy = dense_values(y);
+	double sum = dense_dot(vy,vy,n);
+	for(;x->index != -1;++x)
+	{
+		if(x->index >= 0 && x->index < n)
+		{
+			double d = x->value - vy[x->index];
+			sum += d*d - (double)vy[x->index]*vy[x->index];
+		}
+		else
+			sum += x->value * x->value;
+	}
+	return sum;
+}
+
+// dot product of a row with a weight vector, as if the vector were
+// padded with zeros
+static double weight_dot(const svm_node *x, const double *w, int w_dim)
+{
+	double sum = 0;
+	if(is_dense(x))
+	{
+		int n = min(dense_dim(x),w_dim);
+		const float *values = dense_values(x);
+		int i = 0;
+#ifdef __SSE2__
+		__m128d sum_lo = _mm_setzero_pd();
+		__m128d sum_hi = _mm_setzero_pd();
+		for(;i+4<=n;i+=4)
+		{
+			__m128 v = _mm_loadu_ps(values+i);
+			sum_lo = _mm_add_pd(sum_lo,_mm_mul_pd(_mm_cvtps_pd(v),_mm_loadu_pd(w+i)));
+			sum_hi = _mm_add_pd(sum_hi,_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(v,v)),_mm_loadu_pd(w+i+2)));
+		}
+		double lanes[2];
+		_mm_storeu_pd(lanes,_mm_add_pd(sum_lo,sum_hi));
+		sum = lanes[0]+lanes[1];
+#endif
+		for(;i<n;i++)
+			sum += values[i]*w[i];
+		return sum;
+	}
+
+	for(;x->index != -1 && x->index < w_dim;++x)
+		if(x->index >= 0)
+			sum += x->value * w[x->index];
+	return sum;
+}
+
+// add coef*x to a weight vector of length w_dim
+static void add_to_weight(double *w, int w_dim, double coef, const svm_node *x)
+{
+	if(is_dense(x))
+	{
+		int n = min(dense_dim(x),w_dim);
+		const float *values = dense_values(x);
+		for(int i=0;i<n;i++)
+			w[i] += coef*values[i];
+		return;
+	}
+
+	for(;x->index != -1 && x->index < w_dim;++x)
+		if(x->index >= 0)
+			w[x->index] += coef*x->value;
+}
+
+// threads of libsvm made by svm_set_num_threads, NULL for one thread
+static ThreadPool *column_pool = NULL;
+
+// budget of the kernel store in MB, set by svm_set_cv_cache_size
+static double cv_cache_size = 0;
+
+class KernelStore;
+
+// what the problems of one call are solved with. It is carried from the
+// public function down to each kernel and solver instead of being kept in
+// a global, so calls on other threads neither see nor change it
+struct solve_env
+{
+	ThreadPool *pool;	// splits the loops of a problem, or NULL
+	int nr_threads;		// of the pool the loops may use
+	KernelStore *store;	// holds the kernel of the rows, or NULL
+	double store_size;	// budget in MB of a store cross validation makes
+};
+
+// the env of a public call on up to nr_threads threads of pool, with the
+// store budget set by svm_set_cv_cache_size
+static solve_env pool_env(ThreadPool *pool, int nr_threads)
+{
+	solve_env env;
+	env.pool = NULL;
+	env.nr_threads = 1;
+	env.store = NULL;
+	env.store_size = cv_cache_size;
+	if(pool != NULL && nr_threads > 1 && pool->size() > 1)
+	{
+		env.pool = pool;
+		env.nr_threads = min(nr_threads,pool->size());
+	}
+	return env;
+}
+
+// the env of a public call, with the threads set by svm_set_num_threads
+static solve_env call_env()
+{
+	return pool_env(column_pool,svm_get_num_threads());
+}
+
+// the env of a problem solved on the calling thread alone
+static solve_env serial_env()
+{
+	solve_env env;
+	env.pool = NULL;
+	env.nr_threads = 1;
+	env.store = NULL;
+	env.store_size = 0;
+	return env;
+}
+
+// columns with fewer missing entries are filled serially
+#define PARALLEL_COLUMN_MIN 2048
+
+// entries of a column filled by one task of the pool
+#define PARALLEL_COLUMN_CHUNK 512
+
+// loops of the solver over fewer variables run serially
+#define PARALLEL_SOLVER_MIN 32768
+
+// variables of a solver loop handled by one task of the pool
+#define PARALLEL_SOLVER_CHUNK 8192
+
+// columns computed ahead by the prefetcher
+#define PREFETCH_COLUMNS 2
+
+// sparse rows with larger indices are not scattered into a dense scratch,
+// which keeps a scratch row within 2MB
+#define SCRATCH_MAX_INDEX (1<<18)
+
+// a sparse row this many times longer than the other is searched instead
+// of merged
+#define GALLOP_RATIO 16
+
+//
+// Kernel evaluation
+//
+// the static method k_function is for doing single kernel evaluation
+// the constructor of Kernel prepares to calculate the l*l kernel matrix
+// the member function get_Q is for getting one column from the Q Matrix
+//
+class QMatrix {
+public:
+	virtual Qfloat *get_Q(int column, int len) const = 0;
+	virtual double *get_QD() const = 0;
+	virtual void swap_index(int i, int j) const = 0;
+
+	// the env the loops of the solver run in
+	virtual const solve_env& get_env() const = 0;
+
+	// columns the solver is likely to ask for next, computed in the
+	// background if the matrix can
+	virtual bool prefetching() const { return false; }
+	virtual void prefetch(const int *, int, int) const {}
+	virtual ~QMatrix() {}
+};
+
+class ColumnPrefetcher;
+
+class Kernel: public QMatrix {
+public:
+	// a shared kernel is read by several threads at once, so it keeps no
+	// scratch row and no prefetcher
+	Kernel(int l, svm_node * const * x, const svm_parameter& param,
+	       const solve_env& env, bool shared = false);
+	virtual ~Kernel();
+
+	static double k_function(const svm_node *x, const svm_node *y,
+				 const svm_parameter& param);
+	static double k_function(const svm_node *x, double x_square,
+				 const svm_node *y, double y_square,
+				 const svm_parameter& param);
+
+	// k_function for a kernel type known at compile time, so loops over
+	// many rows are dispatched once and the kernel inlined into them
+	template<int type>
+	static double k_value(const svm_node *x, const svm_node *y,
+			      const svm_parameter& param);
+	template<int type>
+	static double k_value(const svm_node *x, double x_square,
+			      const svm_node *y, double y_square,
+			      const svm_parameter& param);
+	static double square(const svm_node *x)
+	{
+		return dot(x,x);
+	}
+	virtual Qfloat *get_Q(int column, int len) const = 0;
+	virtual double *get_QD() const = 0;
+	const solve_env& get_env() const { return env; }
+	virtual void swap_index(int i, int j) const	// no so const...
+	{
+		// columns being prefetched use the old order
+		cancel_prefetch();
+		swap(x[i],x[j]);
+		swap(x_len[i],x_len[j]);
+		if(x_square) swap(x_square[i],x_square[j]);
+		if(x_id) swap(x_id[i],x_id[j]);
+	}
+protected:
+
+	double (Kernel::*kernel_function)(int i, int j) const;
+
+	// data[j] = y[i]*y[j]*K(i,j), or K(i,j) if y is NULL, for j in
+	// [start,len); a column of the kernel store is gathered, and long
+	// columns are split across the pool
+	void fill_column(int i, int start, int len, Qfloat *data, const schar *y) const;
+
+	// the columns of the matrix, made by the derived class
+	Cache *cache;
+
+	// bytes of param.cache_size left to the cache once the scratch rows of
+	// the kernel and its prefetcher are taken out
+	long int cache_bytes(const svm_parameter& param) const;
+
+	// fill the given columns [0,len) of the cache in the background, if
+	// the kernel has a thread for it. A column must be finished before it
+	// is read from the cache, and the request cancelled before the data
+	// the columns read, y included, changes
+	bool prefetcher_running() const { return prefetcher != NULL; }
+	void prefetch_columns(const int *columns, int n, int len, const schar *y) const;
+	void finish_prefetch(int i) const;
+	void cancel_prefetch() const;
+
+private:
+	friend class ColumnPrefetcher;
+	friend class KernelStore;
+
+	const svm_node **x;
+	double *x_square;
+
+	// the store holding the kernel of the rows, and the index of each row
+	// in it, or NULL
+	KernelStore *store;
+	int *x_id;
+
+	// number of nodes of each sparse row, -1 for a dense row
+	int *x_len;
+
+	// zeros, where a column scatters its sparse row i indexed by feature,
+	// so each dot only walks row j
+	double *scratch;
+	int scratch_len;
+	const double *scatter(int i, double *row) const;
+	void unscatter(int i, double *row) const;
+
+	// a column being filled by the pool
+	struct column_job
+	{
+		const Kernel *kernel;
+		int i, start, len;
+		Qfloat *data;
+		const schar *y;
+		const double *row_i;
+	};
+	static void fill_chunk(void *job, int chunk);
+	void fill_range(int i, int start, int end, Qfloat *data, const schar *y,
+			const double *row_i) const;
+	template<int type>
+	void fill_range_of(int i, int start, int end, Qfloat *data, const schar *y,
+			   const double *row_i) const;
+
+	solve_env env;
+	ColumnPrefetcher *prefetcher;
+
+	// svm_parameter
+	const int kernel_type;
+	const int degree;
+	const double gamma;
+	const double coef0;
+
+	static double dot(const svm_node *px, const svm_node *py);
+	static double sparse_distance(const svm_node *x, const svm_node *y);
+	double dot_rows(int i, int j, const double *row_i) const;
+
+	// the kernel of a given type, with row i scattered in row_i or NULL;
+	// the switch is resolved at compile time
+	template<int type>
+	double kernel_of(int i, int j, const double *row_i) const
+	{
+		switch(type)
+		{
+			case LINEAR:
+				return dot_rows(i,j,row_i);
+			case POLY:
+				return powi(gamma*dot_rows(i,j,row_i)+coef0,degree);
+			case RBF:
+				return exp(-gamma*(x_square[i]+x_square[j]-2*dot_rows(i,j,row_i)));
+			case SIGMOID:
+				return tanh(gamma*dot_rows(i,j,row_i)+coef0);
+			default:
+				return x[i][(int)(x[j][0].value)].value;
+		}
+	}
+	template<int type>
+	double kernel_at(int i, int j) const
+	{
+		return kernel_of<type>(i,j,NULL);
+	}
+};
+
+//
+// Column prefetching
+//
+// a background thread fills the slots of the cache reserved for the
+// columns the solver is expected to ask for next, while the solver is busy
+// with the current ones. A column is unreserved when the solver asks for
+// it, after waiting if it is being filled, or when the request is dropped,
+// keeping what was filled so far. Columns are computed exactly as
+// Kernel::fill_column would, so training gives the same model with or
+// without the prefetcher.
+//
+class ColumnPrefetcher
+{
+public:
+	ColumnPrefetcher(const Kernel *kernel, int scratch_len);
+	~ColumnPrefetcher();
+	bool started() const { return running; }
+
+	// fill entries [start[k],len) of each column columns[k] into data[k],
+	// in order; the previous request must have been cancelled
+	void request(const int *columns, Qfloat * const *data, const int *start,
+		     int n, int len, const schar *y);
+
+	// wait for column i if it is being filled, and drop it from the
+	// request; returns the length of it filled, or -1 if it was not
+	// requested
+	int finish(int i);
+
+	// drop the request and wait for the thread to stop writing; returns
+	// the number of columns still requested, and the length of each filled
+	int cancel(int *columns, int *filled);
+
+private:
+	static void *thread_main(void *prefetcher);
+	void run();
+
+	const Kernel *kernel;
+	double *scratch;	// zeros, like Kernel::scratch
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+	bool running;
+	bool stopping;
+
+	// the request, changed by the caller's thread only and protected by
+	// mutex
+	int column[PREFETCH_COLUMNS];	// -1 once finished
+	Qfloat *data[PREFETCH_COLUMNS];
+	int filled[PREFETCH_COLUMNS];	// entries [0,filled) are in data
+	int nr_requested;
+	int len;
+	const schar *y;
+	int current;		// request being filled, or -1
+};
+
+ColumnPrefetcher::ColumnPrefetcher(const Kernel *kernel_, int scratch_len)
+:kernel(kernel_),running(false),stopping(false),nr_requested(0),len(0),
+ y(NULL),current(-1)
+{
+	scratch = NULL;
+	if(scratch_len > 0)
+	{
+		scratch = new double[scratch_len];
+		for(int k=0;k<scratch_len;k++)
+			scratch[k] = 0;
+	}
+
+	pthread_mutex_init(&mutex,NULL);
+	pthread_cond_init(&changed,NULL);
+	running = (pthread_create(&thread,NULL,&ColumnPrefetcher::thread_main,this) == 0);
+}
+
+ColumnPrefetcher::~ColumnPrefetcher()
+{
+	if(running)
+	{
+		pthread_mutex_lock(&mutex);
+		stopping = true;
+		pthread_cond_broadcast(&changed);
+		pthread_mutex_unlock(&mutex);
+		pthread_join(thread,NULL);
+	}
+	pthread_cond_destroy(&changed);
+	pthread_mutex_destroy(&mutex);
+	delete[] scratch;
+}
+
+void ColumnPrefetcher::request(const int *columns, Qfloat * const *data_,
+			       const int *start, int n, int len_, const schar *y_)
+{
+	pthread_mutex_lock(&mutex);
+	nr_requested = min(n,PREFETCH_COLUMNS);
+	for(int k=0;k<nr_requested;k++)
+	{
+		column[k] = columns[k];
+		data[k] = data_[k];
+		filled[k] = start[k];
+	}
+	len = len_;
+	y = y_;
+	pthread_cond_broadcast(&changed);
+	pthread_mutex_unlock(&mutex);
+}
+
+int ColumnPrefetcher::finish(int i)
+{
+	// the request is only changed on this thread, so it is read unlocked
+	int k = 0;
+	while(k < nr_requested && column[k] != i)
+		k++;
+	if(k == nr_requested)
+		return -1;
+
+	pthread_mutex_lock(&mutex);
+	while(current == k)
+		pthread_cond_wait(&changed,&mutex);
+	column[k] = -1;
+	int n = filled[k];
+	pthread_mutex_unlock(&mutex);
+	return n;
+}
+
+int ColumnPrefetcher::cancel(int *columns, int *filled_)
+{
+	if(nr_requested == 0)
+		return 0;
+
+	pthread_mutex_lock(&mutex);
+	int requested = nr_requested;
+	nr_requested = 0;
+	while(current >= 0)
+		pthread_cond_wait(&changed,&mutex);
+	int n = 0;
+	for(int k=0;k<requested;k++)
+		if(column[k] >= 0)
+		{
+			columns[n] = column[k];
+			filled_[n] = filled[k];
+			n++;
+		}
+	pthread_mutex_unlock(&mutex);
+	return n;
+}
+
+void *ColumnPrefetcher::thread_main(void *prefetcher)
+{
+	((ColumnPrefetcher *)prefetcher)->run();
+	return NULL;
+}
+
+void ColumnPrefetcher::run()
+{
+	pthread_mutex_lock(&mutex);
+	while(!stopping)
+	{
+		int k = 0;
+		while(k < nr_requested && (column[k] < 0 || filled[k] >= len))
+			k++;
+		if(k == nr_requested)
+		{
+			pthread_cond_wait(&changed,&mutex);
+			continue;
+		}
+
+		int i = column[k];
+		int start = filled[k], n = len;
+		const schar *y_ = y;
+		Qfloat *out = data[k];
+		current = k;
+		pthread_mutex_unlock(&mutex);
+
+		// the column is filled in chunks so a dropped request is noticed
+		// soon, and what was filled before is kept
+		const double *row_i = kernel->scatter(i,scratch);
+		bool dropped = false;
+		while(start < n && !dropped)
+		{
+			int end = min(start+PARALLEL_COLUMN_CHUNK,n);
+			kernel->fill_range(i,start,end,out,y_,row_i);
+			start = end;
+			pthread_mutex_lock(&mutex);
+			filled[k] = end;
+			dropped = (nr_requested == 0 || stopping);
+			pthread_mutex_unlock(&mutex);
+		}
+		if(row_i)
+			kernel->unscatter(i,scratch);
+
+		pthread_mutex_lock(&mutex);
+		current = -1;
+		pthread_cond_broadcast(&changed);
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+//
+// Kernel store
+//
+// the kernel over a whole problem, shared by the kernels of problems made
+// of its rows, such as the folds of cross validation and the probability
+// folds within them, which would otherwise compute the same entries once
+// per fold. Each column is computed once, by the first kernel to ask for
+// it, and kept until the store is destroyed; once the budget is used up
+// the kernels compute the columns they need themselves.
+//
+class KernelStore: public Kernel
+{
+public:
+	KernelStore(const svm_problem& prob, const svm_parameter& param, long int size);
+	~KernelStore();
+
+	// whether param gives the kernel of the store
+	bool serves(const svm_parameter& param) const;
+
+	// index in the problem of each of the n rows, or false if one of them
+	// is not a row of the problem
+	bool find_rows(int n, const svm_node * const *rows, int *index) const;
+
+	// column i, or NULL if there is no room left for it; other callers
+	// wait while the first one computes it
+	const Qfloat *column(int i);
+
+	// the store is only read through column
+	Qfloat *get_Q(int, int) const { return NULL; }
+	double *get_QD() const { return NULL; }
+	void swap_index(int, int) const {}
+private:
+	int l;
+	svm_parameter param;
+
+	struct row_index
+	{
+		const svm_node *row;
+		int index;
+	};
+	row_index *rows;	// sorted by address
+	static int compare_rows(const void *a, const void *b);
+
+	enum { MISSING, COMPUTING, COMPUTED };
+	Qfloat **columns;
+	char *state;		// of each column, protected by mutex
+	int nr_columns, max_columns;
+	pthread_mutex_t mutex;
+	pthread_cond_t computed;
 };
 
-Cache::Cache(int l_,long int size_):l(l_),size(size_)
+KernelStore::KernelStore(const svm_problem& prob, const svm_parameter& param_, long int size)
+:Kernel(prob.l,prob.x,param_,serial_env(),true),l(prob.l),param(param_)
+{
+	rows = Malloc(row_index,l);
+	for(int i=0;i<l;i++)
+	{
+		rows[i].row = prob.x[i];
+		rows[i].index = i;
+	}
+	qsort(rows,l,sizeof(row_index),&KernelStore::compare_rows);
+
+	columns = Malloc(Qfloat *,l);
+	state = Malloc(char,l);
+	for(int i=0;i<l;i++)
+	{
+		columns[i] = NULL;
+		state[i] = MISSING;
+	}
+	nr_columns = 0;
+	max_columns = (int)min(size/((long int)sizeof(Qfloat)*max(l,1)),(long int)l);
+	pthread_mutex_init(&mutex,NULL);
+	pthread_cond_init(&computed,NULL);
+}
+
+KernelStore::~KernelStore()
+{
+	pthread_cond_destroy(&computed);
+	pthread_mutex_destroy(&mutex);
+	for(int i=0;i<l;i++)
+		free(columns[i]);
+	free(columns);
+	free(state);
+	free(rows);
+}
+
+int KernelStore::compare_rows(const void *a, const void *b)
+{
+	size_t x = (size_t)((const row_index *)a)->row;
+	size_t y = (size_t)((const row_index *)b)->row;
+	return (x < y) ? -1 : (x > y);
+}
+
+bool KernelStore::serves(const svm_parameter& param_) const
+{
+	if(param_.kernel_type != param.kernel_type)
+		return false;
+	switch(param.kernel_type)
+	{
+		case POLY:
+			return param_.degree == param.degree &&
+			       param_.gamma == param.gamma && param_.coef0 == param.coef0;
+		case RBF:
+			return param_.gamma == param.gamma;
+		case SIGMOID:
+			return param_.gamma == param.gamma && param_.coef0 == param.coef0;
+		default:
+			return true;
+	}
+}
+
+bool KernelStore::find_rows(int n, const svm_node * const *x, int *index) const
+{
+	for(int i=0;i<n;i++)
+	{
+		row_index key;
+		key.row = x[i];
+		const row_index *found = (const row_index *)
+			bsearch(&key,rows,l,sizeof(row_index),&KernelStore::compare_rows);
+		if(found == NULL)
+			return false;
+		index[i] = found->index;
+	}
+	return true;
+}
+
+const Qfloat *KernelStore::column(int i)
+{
+	pthread_mutex_lock(&mutex);
+	while(state[i] == COMPUTING)
+		pthread_cond_wait(&computed,&mutex);
+	if(state[i] == COMPUTED || nr_columns == max_columns)
+	{
+		pthread_mutex_unlock(&mutex);
+		return columns[i];
+	}
+	state[i] = COMPUTING;
+	nr_columns++;
+	pthread_mutex_unlock(&mutex);
+
+	// without a scattered row, which the callers would share; the entries
+	// are the same either way
+	Qfloat *data = Malloc(Qfloat,l);
+	fill_range(i,0,l,data,NULL,NULL);
+
+	pthread_mutex_lock(&mutex);
+	columns[i] = data;
+	state[i] = COMPUTED;
+	pthread_cond_broadcast(&computed);
+	pthread_mutex_unlock(&mutex);
+	return data;
+}
+
+Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param,
+	       const solve_env& env_, bool shared)
+:env(env_), kernel_type(param.kernel_type), degree(param.degree),
+ gamma(param.gamma), coef0(param.coef0)
+{
+	switch(kernel_type)
+	{
+		case LINEAR:
+			kernel_function = &Kernel::kernel_at<LINEAR>;
+			break;
+		case POLY:
+			kernel_function = &Kernel::kernel_at<POLY>;
+			break;
+		case RBF:
+			kernel_function = &Kernel::kernel_at<RBF>;
+			break;
+		case SIGMOID:
+			kernel_function = &Kernel::kernel_at<SIGMOID>;
+			break;
+		case PRECOMPUTED:
+			kernel_function = &Kernel::kernel_at<PRECOMPUTED>;
+			break;
+	}
+
+	clone(x,x_,l);
+	cache = NULL;
+
+	// the kernel of rows of the store's problem is read from the store
+	store = NULL;
+	x_id = NULL;
+	if(!shared && env.store != NULL && env.store->serves(param))
+	{
+		x_id = new int[l];
+		if(env.store->find_rows(l,x,x_id))
+			store = env.store;
+		else
+		{
+			delete[] x_id;
+			x_id = NULL;
+		}
+	}
+
+	// the scratch covers every feature of the sparse rows, unless the
+	// indices are too large for a dense copy to pay off
+	x_len = new int[l];
+	int max_index = -1;
+	for(int i=0;i<l;i++)
+	{
+		if(is_dense(x[i]) || kernel_type == PRECOMPUTED)
+		{
+			x_len[i] = -1;
+			continue;
+		}
+		int n = 0;
+		for(;x[i][n].index != -1;n++)
+			max_index = max(max_index,x[i][n].index);
+		x_len[i] = n;
+	}
+	scratch = 0;
+	scratch_len = 0;
+	if(!shared && max_index >= 0 && max_index < SCRATCH_MAX_INDEX)
+	{
+		scratch_len = max_index+1;
+		scratch = new double[scratch_len];
+		for(int k=0;k<scratch_len;k++)
+			scratch[k] = 0;
+	}
+
+	if(kernel_type == RBF)
+	{
+		x_square = new double[l];
+		for(int i=0;i<l;i++)
+			x_square[i] = dot(x[i],x[i]);
+	}
+	else
+		x_square = 0;
+
+	// one of the threads of the pool computes the next columns instead of
+	// taking part in the loops, unless the columns are gathered from the
+	// store or the loops would be left with a single thread
+	prefetcher = NULL;
+	if(env.pool != NULL && env.nr_threads >= 3 && !shared && store == NULL)
+	{
+		prefetcher = new ColumnPrefetcher(this,scratch_len);
+		if(prefetcher->started())
+			env.nr_threads--;
+		else
+		{
+			delete prefetcher;
+			prefetcher = NULL;
+		}
+	}
+}
+
+Kernel::~Kernel()
+{
+	delete prefetcher;
+	delete[] x;
+	delete[] x_square;
+	delete[] x_len;
+	delete[] x_id;
+	delete[] scratch;
+}
+
+// returns row, or NULL if row i is not scattered
+const double *Kernel::scatter(int i, double *row) const
+{
+	if(row == 0 || x_len[i] < 0)
+		return NULL;
+	for(const svm_node *p = x[i];p->index != -1;++p)
+		if(p->index >= 0)
+			row[p->index] = p->value;
+	return row;
+}
+
+void Kernel::unscatter(int i, double *row) const
 {
-	head = (head_t *)calloc(l,sizeof(head_t));	// initialized to 0
-	size /= sizeof(Qfloat);
-	size -= l * sizeof(head_t) / sizeof(Qfloat);
-	size = max(size, 2 * (long int) l);	// cache must be large enough for two columns
-	lru_head.next = lru_head.prev = &lru_head;
+	for(const svm_node *p = x[i];p->index != -1;++p)
+		if(p->index >= 0)
+			row[p->index] = 0;
 }
 
-Cache::~Cache()
+template<int type>
+void Kernel::fill_range_of(int i, int start, int end, Qfloat *data, const schar *y,
+			   const double *row_i) const
 {
-	for(head_t *h = lru_head.next; h != &lru_head; h=h->next)
-		free(h->data);
-	free(head);
+	int j;
+	if(y != NULL)
+		for(j=start;j<end;j++)
+			data[j] = (Qfloat)(y[i]*y[j]*kernel_of<type>(i,j,row_i));
+	else
+		for(j=start;j<end;j++)
+			data[j] = (Qfloat)kernel_of<type>(i,j,row_i);
 }
 
-void Cache::lru_delete(head_t *h)
+void Kernel::fill_range(int i, int start, int end, Qfloat *data, const schar *y,
+			const double *row_i) const
 {
-	// delete from current location
-	h->prev->next = h->next;
-	h->next->prev = h->prev;
+	switch(kernel_type)
+	{
+		case LINEAR:
+			fill_range_of<LINEAR>(i,start,end,data,y,row_i);
+			break;
+		case POLY:
+			fill_range_of<POLY>(i,start,end,data,y,row_i);
+			break;
+		case RBF:
+			fill_range_of<RBF>(i,start,end,data,y,row_i);
+			break;
+		case SIGMOID:
+			fill_range_of<SIGMOID>(i,start,end,data,y,row_i);
+			break;
+		case PRECOMPUTED:
+			fill_range_of<PRECOMPUTED>(i,start,end,data,y,row_i);
+			break;
+	}
 }
 
-void Cache::lru_insert(head_t *h)
+void Kernel::fill_chunk(void *context, int chunk)
 {
-	// insert to last position
-	h->next = &lru_head;
-	h->prev = lru_head.prev;
-	h->prev->next = h;
-	h->next->prev = h;
+	const column_job *job = (const column_job *)context;
+	int start = job->start+chunk*PARALLEL_COLUMN_CHUNK;
+	int end = min(start+PARALLEL_COLUMN_CHUNK,job->len);
+	job->kernel->fill_range(job->i,start,end,job->data,job->y,job->row_i);
 }
 
-int Cache::get_data(const int index, Qfloat **data, int len)
+void Kernel::fill_column(int i, int start, int len, Qfloat *data, const schar *y) const
 {
-	head_t *h = &head[index];
-	if(h->len) lru_delete(h);
-	int more = len - h->len;
-
-	if(more > 0)
+	const Qfloat *column = store ? store->column(x_id[i]) : NULL;
+	if(column != NULL)
 	{
-		// free old space
-		while(size < more)
-		{
-			head_t *old = lru_head.next;
-			lru_delete(old);
-			free(old->data);
-			size += old->len;
-			old->data = 0;
-			old->len = 0;
-		}
-
-		// allocate new space
-		h->data = (Qfloat *)realloc(h->data,sizeof(Qfloat)*len);
-		size -= more;
-		swap(h->len,len);
+		int j;
+		if(y != NULL)
+			for(j=start;j<len;j++)
+				data[j] = y[i]*y[j]*column[x_id[j]];
+		else
+			for(j=start;j<len;j++)
+				data[j] = column[x_id[j]];
+		return;
 	}
 
-	lru_insert(h);
-	*data = h->data;
-	return len;
+	// the scattered row is only read while the column is filled, so the
+	// chunks can share it
+	const double *row_i = scatter(i,scratch);
+	ThreadPool *pool = env.pool;
+	if(pool == NULL || len-start < PARALLEL_COLUMN_MIN)
+		fill_range(i,start,len,data,y,row_i);
+	else
+	{
+		column_job job;
+		job.kernel = this;
+		job.i = i;
+		job.start = start;
+		job.len = len;
+		job.data = data;
+		job.y = y;
+		job.row_i = row_i;
+		int chunks = (len-start+PARALLEL_COLUMN_CHUNK-1)/PARALLEL_COLUMN_CHUNK;
+		pool->parallelFor(chunks,&Kernel::fill_chunk,&job,env.nr_threads);
+	}
+	if(row_i)
+		unscatter(i,scratch);
 }
 
-void Cache::swap_index(int i, int j)
+long int Kernel::cache_bytes(const svm_parameter& param) const
 {
-	if(i==j) return;
+	long int scratch_bytes = (long int)sizeof(double)*scratch_len;
+	if(prefetcher)
+		scratch_bytes *= 2;
+	return max((long int)(param.cache_size*(1<<20))-scratch_bytes,0L);
+}
 
-	if(head[i].len) lru_delete(&head[i]);
-	if(head[j].len) lru_delete(&head[j]);
-	swap(head[i].data,head[j].data);
-	swap(head[i].len,head[j].len);
-	if(head[i].len) lru_insert(&head[i]);
-	if(head[j].len) lru_insert(&head[j]);
+void Kernel::prefetch_columns(const int *columns, int n, int len, const schar *y) const
+{
+	cancel_prefetch();
 
-	if(i>j) swap(i,j);
-	for(head_t *h = lru_head.next; h!=&lru_head; h=h->next)
+	int column[PREFETCH_COLUMNS], start[PREFETCH_COLUMNS], m = 0;
+	Qfloat *data[PREFETCH_COLUMNS];
+	for(int k=0;k<n && m<PREFETCH_COLUMNS;k++)
 	{
-		if(h->len > i)
-		{
-			if(h->len > j)
-				swap(h->data[i],h->data[j]);
-			else
-			{
-				// give up
-				lru_delete(h);
-				free(h->data);
-				size += h->len;
-				h->data = 0;
-				h->len = 0;
-			}
-		}
+		int i = columns[k], c = 0;
+		while(c < m && column[c] != i)
+			c++;
+		if(c < m || cache->cached(i,len))
+			continue;
+		data[m] = cache->reserve(i,len,&start[m]);
+		if(data[m] == NULL)
+			break;
+		column[m++] = i;
 	}
+	if(m > 0)
+		prefetcher->request(column,data,start,m,len,y);
 }
 
-//
-// Kernel evaluation
-//
-// the static method k_function is for doing single kernel evaluation
-// the constructor of Kernel prepares to calculate the l*l kernel matrix
-// the member function get_Q is for getting one column from the Q Matrix
-//
-class QMatrix {
-public:
-	virtual Qfloat *get_Q(int column, int len) const = 0;
-	virtual double *get_QD() const = 0;
-	virtual void swap_index(int i, int j) const = 0;
-	virtual ~QMatrix() {}
-};
-
-class Kernel: public QMatrix {
-public:
-	Kernel(int l, svm_node * const * x, const svm_parameter& param);
-	virtual ~Kernel();
-
-	static double k_function(const svm_node *x, const svm_node *y,
-				 const svm_parameter& param);
-	virtual Qfloat *get_Q(int column, int len) const = 0;
-	virtual double *get_QD() const = 0;
-	virtual void swap_index(int i, int j) const	// no so const...
+void Kernel::finish_prefetch(int i) const
+{
+	if(prefetcher)
 	{
-		swap(x[i],x[j]);
-		if(x_square) swap(x_square[i],x_square[j]);
+		int len = prefetcher->finish(i);
+		if(len >= 0)
+			cache->unreserve(i,len);
 	}
-protected:
+}
 
-	double (Kernel::*kernel_function)(int i, int j) const;
+// the columns keep the entries filled so far
+void Kernel::cancel_prefetch() const
+{
+	if(prefetcher)
+	{
+		int column[PREFETCH_COLUMNS], filled[PREFETCH_COLUMNS];
+		int n = prefetcher->cancel(column,filled);
+		for(int k=0;k<n;k++)
+			cache->unreserve(column[k],filled[k]);
+	}
+}
 
-private:
-	const svm_node **x;
-	double *x_square;
+double Kernel::dot_rows(int i, int j, const double *row_i) const
+{
+	if(x_len[i] >= 0 && x_len[j] >= 0)
+	{
+		// look the nodes of a short row up in a much longer one
+		if(x_len[j] >= GALLOP_RATIO*x_len[i])
+			return gallop_dot(x[i],x[j],x_len[j]);
+		if(x_len[i] >= GALLOP_RATIO*x_len[j])
+			return gallop_dot(x[j],x[i],x_len[i]);
+
+		// gather row j from the scattered row i
+		if(row_i != NULL)
+		{
+			double sum = 0;
+			for(const svm_node *p = x[j];p->index != -1;++p)
+				if(p->index >= 0)
+					sum += row_i[p->index] * p->value;
+			return sum;
+		}
+	}
 
-	// svm_parameter
-	const int kernel_type;
-	const int degree;
-	const double gamma;
-	const double coef0;
+	return dot(x[i],x[j]);
+}
 
-	static double dot(const svm_node *px, const svm_node *py);
-	double kernel_linear(int i, int j) const
+double Kernel::dot(const svm_node *px, const svm_node *py)
+{
+	if(is_dense(px) || is_dense(py))
 	{
-		return dot(x[i],x[j]);
+		if(is_dense(px) && is_dense(py))
+			return dense_dot(dense_values(px),dense_values(py),
+					 min(dense_dim(px),dense_dim(py)));
+		if(is_dense(px))
+			swap(px,py);
+		return sparse_dense_dot(px,dense_values(py),dense_dim(py));
 	}
-	double kernel_poly(int i, int j) const
+
+	// both pointers advance without a branch; only matching indices
+	// contribute a product
+	double sum = 0;
+	while(px->index != -1 && py->index != -1)
 	{
-		return powi(gamma*dot(x[i],x[j])+coef0,degree);
+		int ix = px->index;
+		int iy = py->index;
+		double product = px->value * py->value;
+		sum += (ix == iy) ? product : 0.0;
+		px += (ix <= iy);
+		py += (iy <= ix);
 	}
-	double kernel_rbf(int i, int j) const
+	return sum;
+}
+
+// squared distance of two sparse rows
+double Kernel::sparse_distance(const svm_node *x, const svm_node *y)
+{
+	// the difference of matching nodes, or the lone node of the row with
+	// the smaller index, without branching
+	double sum = 0;
+	while(x->index != -1 && y->index !=-1)
 	{
-		return exp(-gamma*(x_square[i]+x_square[j]-2*dot(x[i],x[j])));
+		int ix = x->index;
+		int iy = y->index;
+		bool take_x = (ix <= iy);
+		bool take_y = (iy <= ix);
+		double d = (take_x ? x->value : 0.0) - (take_y ? y->value : 0.0);
+		sum += d*d;
+		x += take_x;
+		y += take_y;
 	}
-	double kernel_sigmoid(int i, int j) const
+
+	while(x->index != -1)
 	{
-		return tanh(gamma*dot(x[i],x[j])+coef0);
+		sum += x->value * x->value;
+		++x;
 	}
-	double kernel_precomputed(int i, int j) const
+
+	while(y->index != -1)
 	{
-		return x[i][(int)(x[j][0].value)].value;
+		sum += y->value * y->value;
+		++y;
 	}
-};
 
-Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
-:kernel_type(param.kernel_type), degree(param.degree),
- gamma(param.gamma), coef0(param.coef0)
+	return sum;
+}
+
+template<int type>
+double Kernel::k_value(const svm_node *x, const svm_node *y,
+		       const svm_parameter& param)
 {
-	switch(kernel_type)
+	switch(type)
 	{
 		case LINEAR:
-			kernel_function = &Kernel::kernel_linear;
-			break;
+			return dot(x,y);
 		case POLY:
-			kernel_function = &Kernel::kernel_poly;
-			break;
+			return powi(param.gamma*dot(x,y)+param.coef0,param.degree);
 		case RBF:
-			kernel_function = &Kernel::kernel_rbf;
-			break;
+			if(is_dense(x) || is_dense(y))
+				return exp(-param.gamma*mixed_distance(x,y));
+			return exp(-param.gamma*sparse_distance(x,y));
 		case SIGMOID:
-			kernel_function = &Kernel::kernel_sigmoid;
-			break;
-		case PRECOMPUTED:
-			kernel_function = &Kernel::kernel_precomputed;
-			break;
-	}
-
-	clone(x,x_,l);
-
-	if(kernel_type == RBF)
-	{
-		x_square = new double[l];
-		for(int i=0;i<l;i++)
-			x_square[i] = dot(x[i],x[i]);
+			return tanh(param.gamma*dot(x,y)+param.coef0);
+		case PRECOMPUTED:  //x: test (validation), y: SV
+			return x[(int)(y->value)].value;
+		default:
+			return 0;  // Unreachable 
 	}
-	else
-		x_square = 0;
 }
 
-Kernel::~Kernel()
+// with the squared norms of both rows known, the RBF distance only needs
+// a dot product; other kernels ignore the norms
+template<int type>
+double Kernel::k_value(const svm_node *x, double x_square,
+		       const svm_node *y, double y_square,
+		       const svm_parameter& param)
 {
-	delete[] x;
-	delete[] x_square;
+	if(type == RBF)
+		return exp(-param.gamma*max(x_square+y_square-2*dot(x,y),0.0));
+	return k_value<type>(x,y,param);
 }
 
-double Kernel::dot(const svm_node *px, const svm_node *py)
+double Kernel::k_function(const svm_node *x, double x_square,
+			  const svm_node *y, double y_square,
+			  const svm_parameter& param)
 {
-	double sum = 0;
-	while(px->index != -1 && py->index != -1)
-	{
-		if(px->index == py->index)
-		{
-			sum += px->value * py->value;
-			++px;
-			++py;
-		}
-		else
-		{
-			if(px->index > py->index)
-				++py;
-			else
-				++px;
-		}			
-	}
-	return sum;
+	if(param.kernel_type == RBF)
+		return k_value<RBF>(x,x_square,y,y_square,param);
+	return k_function(x,y,param);
 }
 
 double Kernel::k_function(const svm_node *x, const svm_node *y,
@@ -352,59 +1613,104 @@ double Kernel::k_function(const svm_node *x, const svm_node *y,
 	switch(param.kernel_type)
 	{
 		case LINEAR:
-			return dot(x,y);
+			return k_value<LINEAR>(x,y,param);
 		case POLY:
-			return powi(param.gamma*dot(x,y)+param.coef0,param.degree);
+			return k_value<POLY>(x,y,param);
 		case RBF:
-		{
-			double sum = 0;
-			while(x->index != -1 && y->index !=-1)
-			{
-				if(x->index == y->index)
-				{
-					double d = x->value - y->value;
-					sum += d*d;
-					++x;
-					++y;
-				}
-				else
-				{
-					if(x->index > y->index)
-					{	
-						sum += y->value * y->value;
-						++y;
-					}
-					else
-					{
-						sum += x->value * x->value;
-						++x;
-					}
-				}
-			}
-
-			while(x->index != -1)
-			{
-				sum += x->value * x->value;
-				++x;
-			}
-
-			while(y->index != -1)
-			{
-				sum += y->value * y->value;
-				++y;
-			}
-			
-			return exp(-param.gamma*sum);
-		}
+			return k_value<RBF>(x,y,param);
 		case SIGMOID:
-			return tanh(param.gamma*dot(x,y)+param.coef0);
-		case PRECOMPUTED:  //x: test (validation), y: SV
-			return x[(int)(y->value)].value;
+			return k_value<SIGMOID>(x,y,param);
+		case PRECOMPUTED:
+			return k_value<PRECOMPUTED>(x,y,param);
 		default:
 			return 0;  // Unreachable 
 	}
 }
 
+// G[k] += Q_a[k]*a + Q_b[k]*b, or G[k] += Q_a[k]*a if Q_b is NULL, for k
+// in [begin,end); the vector and scalar paths round alike
+static void add_columns_range(double *G, const Qfloat *Q_a, double a,
+			      const Qfloat *Q_b, double b, int begin, int end)
+{
+	int k = begin;
+	if(Q_b != NULL)
+	{
+#ifdef __SSE2__
+		__m128d va = _mm_set1_pd(a);
+		__m128d vb = _mm_set1_pd(b);
+		for(;k+4<=end;k+=4)
+		{
+			__m128 qa = _mm_loadu_ps(Q_a+k);
+			__m128 qb = _mm_loadu_ps(Q_b+k);
+			__m128d d_lo = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(qa),va),
+						  _mm_mul_pd(_mm_cvtps_pd(qb),vb));
+			__m128d d_hi = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(qa,qa)),va),
+						  _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(qb,qb)),vb));
+			_mm_storeu_pd(G+k,_mm_add_pd(_mm_loadu_pd(G+k),d_lo));
+			_mm_storeu_pd(G+k+2,_mm_add_pd(_mm_loadu_pd(G+k+2),d_hi));
+		}
+#endif
+		for(;k<end;k++)
+			G[k] += Q_a[k]*a + Q_b[k]*b;
+	}
+	else
+	{
+#ifdef __SSE2__
+		__m128d va = _mm_set1_pd(a);
+		for(;k+4<=end;k+=4)
+		{
+			__m128 qa = _mm_loadu_ps(Q_a+k);
+			__m128d d_lo = _mm_mul_pd(_mm_cvtps_pd(qa),va);
+			__m128d d_hi = _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(qa,qa)),va);
+			_mm_storeu_pd(G+k,_mm_add_pd(_mm_loadu_pd(G+k),d_lo));
+			_mm_storeu_pd(G+k+2,_mm_add_pd(_mm_loadu_pd(G+k+2),d_hi));
+		}
+#endif
+		for(;k<end;k++)
+			G[k] += Q_a[k]*a;
+	}
+}
+
+// add_columns_range split across the pool
+struct add_columns_job
+{
+	double *G;
+	const Qfloat *Q_a, *Q_b;
+	double a, b;
+	int begin, end;
+};
+
+static void add_columns_chunk(void *context, int chunk)
+{
+	const add_columns_job *job = (const add_columns_job *)context;
+	int begin = job->begin+chunk*PARALLEL_SOLVER_CHUNK;
+	int end = min(begin+PARALLEL_SOLVER_CHUNK,job->end);
+	add_columns_range(job->G,job->Q_a,job->a,job->Q_b,job->b,begin,end);
+}
+
+// every entry is updated by one task, so the result does not depend on
+// the number of threads
+static void add_columns(const solve_env& env, double *G, const Qfloat *Q_a, double a,
+			const Qfloat *Q_b, double b, int begin, int end)
+{
+	ThreadPool *pool = env.pool;
+	if(pool == NULL || end-begin < PARALLEL_SOLVER_MIN)
+	{
+		add_columns_range(G,Q_a,a,Q_b,b,begin,end);
+		return;
+	}
+	add_columns_job job;
+	job.G = G;
+	job.Q_a = Q_a;
+	job.Q_b = Q_b;
+	job.a = a;
+	job.b = b;
+	job.begin = begin;
+	job.end = end;
+	int chunks = (end-begin+PARALLEL_SOLVER_CHUNK-1)/PARALLEL_SOLVER_CHUNK;
+	pool->parallelFor(chunks,&add_columns_chunk,&job,env.nr_threads);
+}
+
 // An SMO algorithm in Fan et al., JMLR 6(2005), p. 1889--1918
 // Solves:
 //
@@ -476,10 +1782,70 @@ protected:
 	virtual int select_working_set(int &i, int &j);
 	virtual double calculate_rho();
 	virtual void do_shrinking();
+
+	// what a loop split by for_chunks found in one chunk of variables
+	struct chunk_result
+	{
+		double max1, max2;	// largest values, and their last indices
+		int max1_idx, max2_idx;
+		double min;		// smallest value, and its last index
+		int min_idx;
+	};
+	chunk_result *chunks;
+
+	// run loop over [0,n), in chunks on the pool when n is large enough;
+	// returns the number of chunks, whose results are in chunks in order
+	typedef void (Solver::*chunk_loop)(int begin, int end, chunk_result& r);
+	int for_chunks(int n, chunk_loop loop);
+
+	// arguments of the second pass of the working set selection: the
+	// variables i picked by the first pass, their columns and violations
+	int select_i[2];
+	const Qfloat *select_Q[2];
+	double select_Gmax[2];
+
+	// variables besides the working set likely to be selected next, found
+	// by the passes of select_working_set, or -1
+	int likely[2];
 private:
 	bool be_shrunk(int i, double Gmax1, double Gmax2);	
+
+	struct chunk_job
+	{
+		Solver *solver;
+		chunk_loop loop;
+		int n;
+	};
+	static void run_chunk(void *job, int chunk);
+	void max_violation(int begin, int end, chunk_result& r);
+	void min_obj_diff(int begin, int end, chunk_result& r);
 };
 
+void Solver::run_chunk(void *context, int chunk)
+{
+	const chunk_job *job = (const chunk_job *)context;
+	int begin = chunk*PARALLEL_SOLVER_CHUNK;
+	int end = min(begin+PARALLEL_SOLVER_CHUNK,job->n);
+	(job->solver->*job->loop)(begin,end,job->solver->chunks[chunk]);
+}
+
+int Solver::for_chunks(int n, chunk_loop loop)
+{
+	const solve_env& env = Q->get_env();
+	if(env.pool == NULL || n < PARALLEL_SOLVER_MIN)
+	{
+		(this->*loop)(0,n,chunks[0]);
+		return 1;
+	}
+	chunk_job job;
+	job.solver = this;
+	job.loop = loop;
+	job.n = n;
+	int count = (n+PARALLEL_SOLVER_CHUNK-1)/PARALLEL_SOLVER_CHUNK;
+	env.pool->parallelFor(count,&Solver::run_chunk,&job,env.nr_threads);
+	return count;
+}
+
 void Solver::swap_index(int i, int j)
 {
 	Q->swap_index(i,j);
@@ -527,9 +1893,7 @@ void Solver::reconstruct_gradient()
 			if(is_free(i))
 			{
 				const Qfloat *Q_i = Q->get_Q(i,l);
-				double alpha_i = alpha[i];
-				for(j=active_size;j<l;j++)
-					G[j] += alpha_i * Q_i[j];
+				add_columns(Q->get_env(),G,Q_i,alpha[i],NULL,0,active_size,l);
 			}
 	}
 }
@@ -566,6 +1930,7 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 
 	// initialize gradient
 	{
+		chunks = new chunk_result[max((l+PARALLEL_SOLVER_CHUNK-1)/PARALLEL_SOLVER_CHUNK,1)];
 		G = new double[l];
 		G_bar = new double[l];
 		int i;
@@ -578,13 +1943,9 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 			if(!is_lower_bound(i))
 			{
 				const Qfloat *Q_i = Q.get_Q(i,l);
-				double alpha_i = alpha[i];
-				int j;
-				for(j=0;j<l;j++)
-					G[j] += alpha_i*Q_i[j];
+				add_columns(Q.get_env(),G,Q_i,alpha[i],NULL,0,0,l);
 				if(is_upper_bound(i))
-					for(j=0;j<l;j++)
-						G_bar[j] += get_C(i) * Q_i[j];
+					add_columns(Q.get_env(),G_bar,Q_i,get_C(i),NULL,0,0,l);
 			}
 	}
 
@@ -626,6 +1987,18 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		const Qfloat *Q_i = Q.get_Q(i,active_size);
 		const Qfloat *Q_j = Q.get_Q(j,active_size);
 
+		// the columns likely to be needed next are computed while this
+		// pair is updated
+		if(Q.prefetching())
+		{
+			int columns[2], n = 0;
+			for(int k=0;k<2;k++)
+				if(likely[k] != -1 && likely[k] != i && likely[k] != j)
+					columns[n++] = likely[k];
+			if(n > 0)
+				Q.prefetch(columns,n,active_size);
+		}
+
 		double C_i = get_C(i);
 		double C_j = get_C(j);
 
@@ -724,10 +2097,7 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 		double delta_alpha_i = alpha[i] - old_alpha_i;
 		double delta_alpha_j = alpha[j] - old_alpha_j;
 		
-		for(int k=0;k<active_size;k++)
-		{
-			G[k] += Q_i[k]*delta_alpha_i + Q_j[k]*delta_alpha_j;
-		}
+		add_columns(Q.get_env(),G,Q_i,delta_alpha_i,Q_j,delta_alpha_j,0,active_size);
 
 		// update alpha_status and G_bar
 
@@ -736,27 +2106,16 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 			bool uj = is_upper_bound(j);
 			update_alpha_status(i);
 			update_alpha_status(j);
-			int k;
 			if(ui != is_upper_bound(i))
 			{
 				Q_i = Q.get_Q(i,l);
-				if(ui)
-					for(k=0;k<l;k++)
-						G_bar[k] -= C_i * Q_i[k];
-				else
-					for(k=0;k<l;k++)
-						G_bar[k] += C_i * Q_i[k];
+				add_columns(Q.get_env(),G_bar,Q_i,ui ? -C_i : C_i,NULL,0,0,l);
 			}
 
 			if(uj != is_upper_bound(j))
 			{
 				Q_j = Q.get_Q(j,l);
-				if(uj)
-					for(k=0;k<l;k++)
-						G_bar[k] -= C_j * Q_j[k];
-				else
-					for(k=0;k<l;k++)
-						G_bar[k] += C_j * Q_j[k];
+				add_columns(Q.get_env(),G_bar,Q_j,uj ? -C_j : C_j,NULL,0,0,l);
 			}
 		}
 	}
@@ -813,6 +2172,7 @@ void Solver::Solve(int l, const QMatrix& Q, const double *p_, const schar *y_,
 	delete[] active_set;
 	delete[] G;
 	delete[] G_bar;
+	delete[] chunks;
 }
 
 // return 1 if already optimal, return 0 otherwise
@@ -823,39 +2183,126 @@ int Solver::select_working_set(int &out_i, int &out_j)
 	// j: minimizes the decrease of obj value
 	//    (if quadratic coefficeint <= 0, replace it with tau)
 	//    -y_j*grad(f)_j < -y_i*grad(f)_i, j in I_low(\alpha)
-	
+
+	// the chunks are combined in order, keeping the last index on ties
+	// like a single pass does, so the pick does not depend on the threads
 	double Gmax = -INF;
-	double Gmax2 = -INF;
 	int Gmax_idx = -1;
+	int n = for_chunks(active_size,&Solver::max_violation);
+	for(int c=0;c<n;c++)
+		if(chunks[c].max1_idx != -1 && chunks[c].max1 >= Gmax)
+		{
+			Gmax = chunks[c].max1;
+			Gmax_idx = chunks[c].max1_idx;
+		}
+
+	// the runner-up of I_up is likely to be the next i
+	double Gnext = -INF;
+	likely[0] = -1;
+	for(int c=0;c<n;c++)
+	{
+		if(chunks[c].max1_idx != -1 && chunks[c].max1_idx != Gmax_idx &&
+		   chunks[c].max1 >= Gnext)
+		{
+			Gnext = chunks[c].max1;
+			likely[0] = chunks[c].max1_idx;
+		}
+		if(chunks[c].max2_idx != -1 && chunks[c].max2 >= Gnext)
+		{
+			Gnext = chunks[c].max2;
+			likely[0] = chunks[c].max2_idx;
+		}
+	}
+
+	int i = Gmax_idx;
+	const Qfloat *Q_i = NULL;
+	if(i != -1) // NULL Q_i not accessed: Gmax=-INF if i=-1
+		Q_i = Q->get_Q(i,active_size);
+
+	select_i[0] = i;
+	select_Q[0] = Q_i;
+	select_Gmax[0] = Gmax;
+	double Gmax2 = -INF;
 	int Gmin_idx = -1;
 	double obj_diff_min = INF;
+	likely[1] = -1;
+	n = for_chunks(active_size,&Solver::min_obj_diff);
+	for(int c=0;c<n;c++)
+	{
+		// the extreme of I_low is likely to be the next j
+		if(chunks[c].max1 > Gmax2)
+		{
+			Gmax2 = chunks[c].max1;
+			likely[1] = chunks[c].max1_idx;
+		}
+		if(chunks[c].min_idx != -1 && chunks[c].min <= obj_diff_min)
+		{
+			obj_diff_min = chunks[c].min;
+			Gmin_idx = chunks[c].min_idx;
+		}
+	}
+
+	if(Gmax+Gmax2 < eps)
+		return 1;
 
-	for(int t=0;t<active_size;t++)
+	out_i = Gmax_idx;
+	out_j = Gmin_idx;
+	return 0;
+}
+
+// first pass of select_working_set: the largest -y_t*grad(f)_t in I_up,
+// and the runner-up
+void Solver::max_violation(int begin, int end, chunk_result& r)
+{
+	double Gmax = -INF, Gnext = -INF;
+	int Gmax_idx = -1, Gnext_idx = -1;
+	for(int t=begin;t<end;t++)
+	{
+		double v;
 		if(y[t]==+1)	
 		{
-			if(!is_upper_bound(t))
-				if(-G[t] >= Gmax)
-				{
-					Gmax = -G[t];
-					Gmax_idx = t;
-				}
+			if(is_upper_bound(t))
+				continue;
+			v = -G[t];
 		}
 		else
 		{
-			if(!is_lower_bound(t))
-				if(G[t] >= Gmax)
-				{
-					Gmax = G[t];
-					Gmax_idx = t;
-				}
+			if(is_lower_bound(t))
+				continue;
+			v = G[t];
+		}
+		if(v >= Gmax)
+		{
+			Gnext = Gmax;
+			Gnext_idx = Gmax_idx;
+			Gmax = v;
+			Gmax_idx = t;
+		}
+		else if(v >= Gnext)
+		{
+			Gnext = v;
+			Gnext_idx = t;
 		}
+	}
+	r.max1 = Gmax;
+	r.max1_idx = Gmax_idx;
+	r.max2 = Gnext;
+	r.max2_idx = Gnext_idx;
+}
 
-	int i = Gmax_idx;
-	const Qfloat *Q_i = NULL;
-	if(i != -1) // NULL Q_i not accessed: Gmax=-INF if i=-1
-		Q_i = Q->get_Q(i,active_size);
+// second pass of select_working_set: the largest y_t*grad(f)_t in I_low,
+// and the j decreasing the objective most with the i of the first pass
+void Solver::min_obj_diff(int begin, int end, chunk_result& r)
+{
+	int i = select_i[0];
+	const Qfloat *Q_i = select_Q[0];
+	double Gmax = select_Gmax[0];
+	double Gmax2 = -INF;
+	int Gmax2_idx = -1;
+	int Gmin_idx = -1;
+	double obj_diff_min = INF;
 
-	for(int j=0;j<active_size;j++)
+	for(int j=begin;j<end;j++)
 	{
 		if(y[j]==+1)
 		{
@@ -863,7 +2310,10 @@ int Solver::select_working_set(int &out_i, int &out_j)
 			{
 				double grad_diff=Gmax+G[j];
 				if (G[j] >= Gmax2)
+				{
 					Gmax2 = G[j];
+					Gmax2_idx = j;
+				}
 				if (grad_diff > 0)
 				{
 					double obj_diff; 
@@ -887,7 +2337,10 @@ int Solver::select_working_set(int &out_i, int &out_j)
 			{
 				double grad_diff= Gmax-G[j];
 				if (-G[j] >= Gmax2)
+				{
 					Gmax2 = -G[j];
+					Gmax2_idx = j;
+				}
 				if (grad_diff > 0)
 				{
 					double obj_diff; 
@@ -906,13 +2359,10 @@ int Solver::select_working_set(int &out_i, int &out_j)
 			}
 		}
 	}
-
-	if(Gmax+Gmax2 < eps)
-		return 1;
-
-	out_i = Gmax_idx;
-	out_j = Gmin_idx;
-	return 0;
+	r.max1 = Gmax2;
+	r.max1_idx = Gmax2_idx;
+	r.min = obj_diff_min;
+	r.min_idx = Gmin_idx;
 }
 
 bool Solver::be_shrunk(int i, double Gmax1, double Gmax2)
@@ -1056,6 +2506,8 @@ private:
 	double calculate_rho();
 	bool be_shrunk(int i, double Gmax1, double Gmax2, double Gmax3, double Gmax4);
 	void do_shrinking();
+	void max_violations(int begin, int end, chunk_result& r);
+	void min_obj_diff_nu(int begin, int end, chunk_result& r);
 };
 
 // return 1 if already optimal, return 0 otherwise
@@ -1067,18 +2519,91 @@ int Solver_NU::select_working_set(int &out_i, int &out_j)
 	//    (if quadratic coefficeint <= 0, replace it with tau)
 	//    -y_j*grad(f)_j < -y_i*grad(f)_i, j in I_low(\alpha)
 
+	// the chunks are combined in order, keeping the last index on ties
+	// like a single pass does
 	double Gmaxp = -INF;
-	double Gmaxp2 = -INF;
 	int Gmaxp_idx = -1;
-
 	double Gmaxn = -INF;
-	double Gmaxn2 = -INF;
 	int Gmaxn_idx = -1;
+	int n = for_chunks(active_size,static_cast<chunk_loop>(&Solver_NU::max_violations));
+	for(int c=0;c<n;c++)
+	{
+		if(chunks[c].max1_idx != -1 && chunks[c].max1 >= Gmaxp)
+		{
+			Gmaxp = chunks[c].max1;
+			Gmaxp_idx = chunks[c].max1_idx;
+		}
+		if(chunks[c].max2_idx != -1 && chunks[c].max2 >= Gmaxn)
+		{
+			Gmaxn = chunks[c].max2;
+			Gmaxn_idx = chunks[c].max2_idx;
+		}
+	}
+
+	int ip = Gmaxp_idx;
+	int in = Gmaxn_idx;
+	const Qfloat *Q_ip = NULL;
+	const Qfloat *Q_in = NULL;
+	if(ip != -1) // NULL Q_ip not accessed: Gmaxp=-INF if ip=-1
+		Q_ip = Q->get_Q(ip,active_size);
+	if(in != -1)
+		Q_in = Q->get_Q(in,active_size);
 
+	select_i[0] = ip;
+	select_Q[0] = Q_ip;
+	select_Gmax[0] = Gmaxp;
+	select_i[1] = in;
+	select_Q[1] = Q_in;
+	select_Gmax[1] = Gmaxn;
+	double Gmaxp2 = -INF;
+	double Gmaxn2 = -INF;
 	int Gmin_idx = -1;
 	double obj_diff_min = INF;
+	likely[0] = likely[1] = -1;
+	n = for_chunks(active_size,static_cast<chunk_loop>(&Solver_NU::min_obj_diff_nu));
+	for(int c=0;c<n;c++)
+	{
+		// the columns of both i are read every iteration, so the extremes
+		// of I_low of each class are the ones likely to be needed next
+		if(chunks[c].max1 > Gmaxp2)
+		{
+			Gmaxp2 = chunks[c].max1;
+			likely[0] = chunks[c].max1_idx;
+		}
+		if(chunks[c].max2 > Gmaxn2)
+		{
+			Gmaxn2 = chunks[c].max2;
+			likely[1] = chunks[c].max2_idx;
+		}
+		if(chunks[c].min_idx != -1 && chunks[c].min <= obj_diff_min)
+		{
+			obj_diff_min = chunks[c].min;
+			Gmin_idx = chunks[c].min_idx;
+		}
+	}
+
+	if(max(Gmaxp+Gmaxp2,Gmaxn+Gmaxn2) < eps)
+		return 1;
+
+	if (y[Gmin_idx] == +1)
+		out_i = Gmaxp_idx;
+	else
+		out_i = Gmaxn_idx;
+	out_j = Gmin_idx;
+
+	return 0;
+}
+
+// first pass of select_working_set: the largest -y_t*grad(f)_t in I_up,
+// for each class
+void Solver_NU::max_violations(int begin, int end, chunk_result& r)
+{
+	double Gmaxp = -INF;
+	int Gmaxp_idx = -1;
+	double Gmaxn = -INF;
+	int Gmaxn_idx = -1;
 
-	for(int t=0;t<active_size;t++)
+	for(int t=begin;t<end;t++)
 		if(y[t]==+1)
 		{
 			if(!is_upper_bound(t))
@@ -1097,17 +2622,28 @@ int Solver_NU::select_working_set(int &out_i, int &out_j)
 					Gmaxn_idx = t;
 				}
 		}
+	r.max1 = Gmaxp;
+	r.max1_idx = Gmaxp_idx;
+	r.max2 = Gmaxn;
+	r.max2_idx = Gmaxn_idx;
+}
 
-	int ip = Gmaxp_idx;
-	int in = Gmaxn_idx;
-	const Qfloat *Q_ip = NULL;
-	const Qfloat *Q_in = NULL;
-	if(ip != -1) // NULL Q_ip not accessed: Gmaxp=-INF if ip=-1
-		Q_ip = Q->get_Q(ip,active_size);
-	if(in != -1)
-		Q_in = Q->get_Q(in,active_size);
+// second pass of select_working_set: the largest y_t*grad(f)_t in I_low
+// for each class, and the j decreasing the objective most with the i of
+// its class
+void Solver_NU::min_obj_diff_nu(int begin, int end, chunk_result& r)
+{
+	int ip = select_i[0], in = select_i[1];
+	const Qfloat *Q_ip = select_Q[0], *Q_in = select_Q[1];
+	double Gmaxp = select_Gmax[0], Gmaxn = select_Gmax[1];
+	double Gmaxp2 = -INF;
+	double Gmaxn2 = -INF;
+	int Gmaxp2_idx = -1;
+	int Gmaxn2_idx = -1;
+	int Gmin_idx = -1;
+	double obj_diff_min = INF;
 
-	for(int j=0;j<active_size;j++)
+	for(int j=begin;j<end;j++)
 	{
 		if(y[j]==+1)
 		{
@@ -1115,7 +2651,10 @@ int Solver_NU::select_working_set(int &out_i, int &out_j)
 			{
 				double grad_diff=Gmaxp+G[j];
 				if (G[j] >= Gmaxp2)
+				{
 					Gmaxp2 = G[j];
+					Gmaxp2_idx = j;
+				}
 				if (grad_diff > 0)
 				{
 					double obj_diff; 
@@ -1139,7 +2678,10 @@ int Solver_NU::select_working_set(int &out_i, int &out_j)
 			{
 				double grad_diff=Gmaxn-G[j];
 				if (-G[j] >= Gmaxn2)
+				{
 					Gmaxn2 = -G[j];
+					Gmaxn2_idx = j;
+				}
 				if (grad_diff > 0)
 				{
 					double obj_diff; 
@@ -1158,17 +2700,12 @@ int Solver_NU::select_working_set(int &out_i, int &out_j)
 			}
 		}
 	}
-
-	if(max(Gmaxp+Gmaxp2,Gmaxn+Gmaxn2) < eps)
-		return 1;
-
-	if (y[Gmin_idx] == +1)
-		out_i = Gmaxp_idx;
-	else
-		out_i = Gmaxn_idx;
-	out_j = Gmin_idx;
-
-	return 0;
+	r.max1 = Gmaxp2;
+	r.max1_idx = Gmaxp2_idx;
+	r.max2 = Gmaxn2;
+	r.max2_idx = Gmaxn2_idx;
+	r.min = obj_diff_min;
+	r.min_idx = Gmin_idx;
 }
 
 bool Solver_NU::be_shrunk(int i, double Gmax1, double Gmax2, double Gmax3, double Gmax4)
@@ -1299,11 +2836,12 @@ double Solver_NU::calculate_rho()
 class SVC_Q: public Kernel
 { 
 public:
-	SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_)
-	:Kernel(prob.l, prob.x, param)
+	SVC_Q(const svm_problem& prob, const svm_parameter& param, const schar *y_,
+	      const solve_env& env)
+	:Kernel(prob.l, prob.x, param, env)
 	{
 		clone(y,y_,prob.l);
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(prob.l,cache_bytes(param));
 		QD = new double[prob.l];
 		for(int i=0;i<prob.l;i++)
 			QD[i] = (this->*kernel_function)(i,i);
@@ -1312,47 +2850,57 @@ public:
 	Qfloat *get_Q(int i, int len) const
 	{
 		Qfloat *data;
-		int start, j;
+		int start;
+		finish_prefetch(i);
 		if((start = cache->get_data(i,&data,len)) < len)
-		{
-			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(y[i]*y[j]*(this->*kernel_function)(i,j));
-		}
+			fill_column(i,start,len,data,y);
 		return data;
 	}
 
+	bool prefetching() const
+	{
+		return prefetcher_running();
+	}
+
+	void prefetch(const int *columns, int n, int len) const
+	{
+		prefetch_columns(columns,n,len,y);
+	}
+
 	double *get_QD() const
 	{
 		return QD;
 	}
 
+	// the kernel cancels the columns being prefetched before the cache
+	// logs the swap
 	void swap_index(int i, int j) const
 	{
-		cache->swap_index(i,j);
 		Kernel::swap_index(i,j);
+		cache->swap_index(i,j);
 		swap(y[i],y[j]);
 		swap(QD[i],QD[j]);
 	}
 
 	~SVC_Q()
 	{
+		cancel_prefetch();
 		delete[] y;
 		delete cache;
 		delete[] QD;
 	}
 private:
 	schar *y;
-	Cache *cache;
 	double *QD;
 };
 
 class ONE_CLASS_Q: public Kernel
 {
 public:
-	ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param)
-	:Kernel(prob.l, prob.x, param)
+	ONE_CLASS_Q(const svm_problem& prob, const svm_parameter& param, const solve_env& env)
+	:Kernel(prob.l, prob.x, param, env)
 	{
-		cache = new Cache(prob.l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(prob.l,cache_bytes(param));
 		QD = new double[prob.l];
 		for(int i=0;i<prob.l;i++)
 			QD[i] = (this->*kernel_function)(i,i);
@@ -1361,15 +2909,23 @@ public:
 	Qfloat *get_Q(int i, int len) const
 	{
 		Qfloat *data;
-		int start, j;
+		int start;
+		finish_prefetch(i);
 		if((start = cache->get_data(i,&data,len)) < len)
-		{
-			for(j=start;j<len;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(i,j);
-		}
+			fill_column(i,start,len,data,NULL);
 		return data;
 	}
 
+	bool prefetching() const
+	{
+		return prefetcher_running();
+	}
+
+	void prefetch(const int *columns, int n, int len) const
+	{
+		prefetch_columns(columns,n,len,NULL);
+	}
+
 	double *get_QD() const
 	{
 		return QD;
@@ -1377,29 +2933,29 @@ public:
 
 	void swap_index(int i, int j) const
 	{
-		cache->swap_index(i,j);
 		Kernel::swap_index(i,j);
+		cache->swap_index(i,j);
 		swap(QD[i],QD[j]);
 	}
 
 	~ONE_CLASS_Q()
 	{
+		cancel_prefetch();
 		delete cache;
 		delete[] QD;
 	}
 private:
-	Cache *cache;
 	double *QD;
 };
 
 class SVR_Q: public Kernel
 { 
 public:
-	SVR_Q(const svm_problem& prob, const svm_parameter& param)
-	:Kernel(prob.l, prob.x, param)
+	SVR_Q(const svm_problem& prob, const svm_parameter& param, const solve_env& env)
+	:Kernel(prob.l, prob.x, param, env)
 	{
 		l = prob.l;
-		cache = new Cache(l,(long int)(param.cache_size*(1<<20)));
+		cache = new Cache(l,cache_bytes(param));
 		QD = new double[2*l];
 		sign = new schar[2*l];
 		index = new int[2*l];
@@ -1428,11 +2984,9 @@ public:
 	{
 		Qfloat *data;
 		int j, real_i = index[i];
+		finish_prefetch(real_i);
 		if(cache->get_data(real_i,&data,l) < l)
-		{
-			for(j=0;j<l;j++)
-				data[j] = (Qfloat)(this->*kernel_function)(real_i,j);
-		}
+			fill_column(real_i,0,l,data,NULL);
 
 		// reorder and copy
 		Qfloat *buf = buffer[next_buffer];
@@ -1443,6 +2997,20 @@ public:
 		return buf;
 	}
 
+	bool prefetching() const
+	{
+		return prefetcher_running();
+	}
+
+	// whole columns of the kernel, which is not reordered, are computed
+	void prefetch(const int *columns, int n, int) const
+	{
+		int real[PREFETCH_COLUMNS], m = 0;
+		for(int k=0;k<n && m<PREFETCH_COLUMNS;k++)
+			real[m++] = index[columns[k]];
+		prefetch_columns(real,m,l,NULL);
+	}
+
 	double *get_QD() const
 	{
 		return QD;
@@ -1450,6 +3018,7 @@ public:
 
 	~SVR_Q()
 	{
+		cancel_prefetch();
 		delete cache;
 		delete[] sign;
 		delete[] index;
@@ -1459,7 +3028,6 @@ public:
 	}
 private:
 	int l;
-	Cache *cache;
 	schar *sign;
 	int *index;
 	mutable int next_buffer;
@@ -1470,9 +3038,12 @@ private:
 //
 // construct and solve various formulations
 //
+// alpha0, if not NULL, is a feasible solution to start from, in the form
+// returned in alpha
 static void solve_c_svc(
 	const svm_problem *prob, const svm_parameter* param,
-	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn)
+	double *alpha, Solver::SolutionInfo* si, double Cp, double Cn,
+	const double *alpha0, const solve_env& env)
 {
 	int l = prob->l;
 	double *minus_ones = new double[l];
@@ -1485,10 +3056,12 @@ static void solve_c_svc(
 		alpha[i] = 0;
 		minus_ones[i] = -1;
 		if(prob->y[i] > 0) y[i] = +1; else y[i] = -1;
+		if(alpha0)
+			alpha[i] = min(max(alpha0[i]*y[i],0.0),(y[i] > 0) ? Cp : Cn);
 	}
 
 	Solver s;
-	s.Solve(l, SVC_Q(*prob,*param,y), minus_ones, y,
+	s.Solve(l, SVC_Q(*prob,*param,y,env), minus_ones, y,
 		alpha, Cp, Cn, param->eps, si, param->shrinking);
 
 	double sum_alpha=0;
@@ -1507,7 +3080,7 @@ static void solve_c_svc(
 
 static void solve_nu_svc(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const solve_env& env)
 {
 	int i;
 	int l = prob->l;
@@ -1542,7 +3115,7 @@ static void solve_nu_svc(
 		zeros[i] = 0;
 
 	Solver_NU s;
-	s.Solve(l, SVC_Q(*prob,*param,y), zeros, y,
+	s.Solve(l, SVC_Q(*prob,*param,y,env), zeros, y,
 		alpha, 1.0, 1.0, param->eps, si,  param->shrinking);
 	double r = si->r;
 
@@ -1562,7 +3135,7 @@ static void solve_nu_svc(
 
 static void solve_one_class(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const solve_env& env)
 {
 	int l = prob->l;
 	double *zeros = new double[l];
@@ -1585,7 +3158,7 @@ static void solve_one_class(
 	}
 
 	Solver s;
-	s.Solve(l, ONE_CLASS_Q(*prob,*param), zeros, ones,
+	s.Solve(l, ONE_CLASS_Q(*prob,*param,env), zeros, ones,
 		alpha, 1.0, 1.0, param->eps, si, param->shrinking);
 
 	delete[] zeros;
@@ -1594,7 +3167,7 @@ static void solve_one_class(
 
 static void solve_epsilon_svr(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const solve_env& env)
 {
 	int l = prob->l;
 	double *alpha2 = new double[2*l];
@@ -1614,7 +3187,7 @@ static void solve_epsilon_svr(
 	}
 
 	Solver s;
-	s.Solve(2*l, SVR_Q(*prob,*param), linear_term, y,
+	s.Solve(2*l, SVR_Q(*prob,*param,env), linear_term, y,
 		alpha2, param->C, param->C, param->eps, si, param->shrinking);
 
 	double sum_alpha = 0;
@@ -1632,7 +3205,7 @@ static void solve_epsilon_svr(
 
 static void solve_nu_svr(
 	const svm_problem *prob, const svm_parameter *param,
-	double *alpha, Solver::SolutionInfo* si)
+	double *alpha, Solver::SolutionInfo* si, const solve_env& env)
 {
 	int l = prob->l;
 	double C = param->C;
@@ -1655,7 +3228,7 @@ static void solve_nu_svr(
 	}
 
 	Solver_NU s;
-	s.Solve(2*l, SVR_Q(*prob,*param), linear_term, y,
+	s.Solve(2*l, SVR_Q(*prob,*param,env), linear_term, y,
 		alpha2, C, C, param->eps, si, param->shrinking);
 
 	info("epsilon = %f\n",-si->r);
@@ -1677,28 +3250,30 @@ struct decision_function
 	double rho;	
 };
 
+// alpha0, if not NULL, starts the solver of C-SVC from a feasible solution
+// in the form of decision_function::alpha
 static decision_function svm_train_one(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn)
+	double Cp, double Cn, const double *alpha0, const solve_env& env)
 {
 	double *alpha = Malloc(double,prob->l);
 	Solver::SolutionInfo si;
 	switch(param->svm_type)
 	{
 		case C_SVC:
-			solve_c_svc(prob,param,alpha,&si,Cp,Cn);
+			solve_c_svc(prob,param,alpha,&si,Cp,Cn,alpha0,env);
 			break;
 		case NU_SVC:
-			solve_nu_svc(prob,param,alpha,&si);
+			solve_nu_svc(prob,param,alpha,&si,env);
 			break;
 		case ONE_CLASS:
-			solve_one_class(prob,param,alpha,&si);
+			solve_one_class(prob,param,alpha,&si,env);
 			break;
 		case EPSILON_SVR:
-			solve_epsilon_svr(prob,param,alpha,&si);
+			solve_epsilon_svr(prob,param,alpha,&si,env);
 			break;
 		case NU_SVR:
-			solve_nu_svr(prob,param,alpha,&si);
+			solve_nu_svr(prob,param,alpha,&si,env);
 			break;
 	}
 
@@ -1734,6 +3309,52 @@ static decision_function svm_train_one(
 	return f;
 }
 
+// the solutions of svm_train_model for one C, which start the solver for
+// another C on the same problem; C-SVC solutions scaled by the ratio of the
+// two values of C stay feasible
+struct warm_start
+{
+	double C;		// of the solutions
+	int nr_solutions;	// 0 before the first solve
+	double **alpha;		// of each decision function
+};
+
+static void free_warm_start(warm_start *warm)
+{
+	for(int k=0;k<warm->nr_solutions;k++)
+		free(warm->alpha[k]);
+	free(warm->alpha);
+	warm->alpha = NULL;
+	warm->nr_solutions = 0;
+}
+
+// the initial alpha of decision function k, of length l, for param, or
+// NULL to start from zero
+static double *warm_alpha(const warm_start *warm, int k, int l, const svm_parameter *param)
+{
+	if(warm == NULL || k >= warm->nr_solutions || param->svm_type != C_SVC)
+		return NULL;
+	double *alpha0 = Malloc(double,l);
+	double scale = param->C/warm->C;
+	for(int i=0;i<l;i++)
+		alpha0[i] = warm->alpha[k][i]*scale;
+	return alpha0;
+}
+
+// warm takes the alphas of the n decision functions over
+static void keep_solutions(warm_start *warm, decision_function *f, int n, const svm_parameter *param)
+{
+	free_warm_start(warm);
+	warm->alpha = Malloc(double *,n);
+	for(int k=0;k<n;k++)
+	{
+		warm->alpha[k] = f[k].alpha;
+		f[k].alpha = NULL;
+	}
+	warm->nr_solutions = n;
+	warm->C = param->C;
+}
+
 // Platt's binary SVM Probablistic Output: an improvement from Lin et al.
 static void sigmoid_train(
 	int l, const double *dec_values, const double *labels, 
@@ -1922,10 +3543,150 @@ static void multiclass_probability(int k, double **r, double *p)
 	free(Qp);
 }
 
-// Cross-validation decision values for probability estimates
+// number of independent jobs run_jobs runs at once in env, which share
+// the kernel cache budget
+static int concurrent_jobs(const solve_env& env, int count)
+{
+	if(env.pool == NULL || count < 2)
+		return 1;
+	return min(count,env.nr_threads);
+}
+
+// the env the jobs of run_jobs solve their problems in: jobs run at once
+// on the pool split its threads, the loops of each problem running on the
+// workers of its share
+static solve_env jobs_env(const solve_env& env, int count)
+{
+	solve_env job_env = env;
+	int concurrent = concurrent_jobs(env,count);
+	if(concurrent > 1)
+	{
+		job_env.nr_threads = env.nr_threads/concurrent;
+		if(job_env.nr_threads < 2)
+		{
+			job_env.pool = NULL;
+			job_env.nr_threads = 1;
+		}
+	}
+	return job_env;
+}
+
+// task(context,k) for k in [0,count), at once on the pool of env if it
+// has one
+static void run_jobs(const solve_env& env, int count, ThreadPool::Task task, void *context)
+{
+	if(concurrent_jobs(env,count) == 1)
+	{
+		for(int k=0;k<count;k++)
+			task(context,k);
+		return;
+	}
+	env.pool->parallelFor(count,task,context,env.nr_threads);
+}
+
+// next random number of the stream seed, or of rand() if seed is NULL
+static unsigned int next_random(unsigned int *seed)
+{
+	if(seed == NULL)
+		return (unsigned int)rand();
+	return (unsigned int)rand_r(seed);
+}
+
+static svm_model *svm_train_model(
+	const svm_problem *prob, const svm_parameter *param, unsigned int *seed,
+	warm_start *warm, const solve_env& env);
+
+// the folds of svm_binary_svc_probability
+struct binary_fold_job
+{
+	const svm_problem *prob;
+	const svm_parameter *param;
+	double Cp, Cn;
+	int nr_fold;
+	const int *perm;
+	double *dec_values;
+	solve_env env;		// of the problem of each fold
+};
+
+// each fold writes the decision values of its own samples
+static void svm_binary_svc_fold(void *context, int fold)
+{
+	const binary_fold_job *job = (const binary_fold_job *)context;
+	const svm_problem *prob = job->prob;
+	const int *perm = job->perm;
+	double *dec_values = job->dec_values;
+
+	int begin = fold*prob->l/job->nr_fold;
+	int end = (fold+1)*prob->l/job->nr_fold;
+	int j,k;
+	struct svm_problem subprob;
+
+	subprob.l = prob->l-(end-begin);
+	subprob.x = Malloc(struct svm_node*,subprob.l);
+	subprob.y = Malloc(double,subprob.l);
+		
+	k=0;
+	for(j=0;j<begin;j++)
+	{
+		subprob.x[k] = prob->x[perm[j]];
+		subprob.y[k] = prob->y[perm[j]];
+		++k;
+	}
+	for(j=end;j<prob->l;j++)
+	{
+		subprob.x[k] = prob->x[perm[j]];
+		subprob.y[k] = prob->y[perm[j]];
+		++k;
+	}
+	int p_count=0,n_count=0;
+	for(j=0;j<k;j++)
+		if(subprob.y[j]>0)
+			p_count++;
+		else
+			n_count++;
+
+	if(p_count==0 && n_count==0)
+		for(j=begin;j<end;j++)
+			dec_values[perm[j]] = 0;
+	else if(p_count > 0 && n_count == 0)
+		for(j=begin;j<end;j++)
+			dec_values[perm[j]] = 1;
+	else if(p_count == 0 && n_count > 0)
+		for(j=begin;j<end;j++)
+			dec_values[perm[j]] = -1;
+	else
+	{
+		svm_parameter subparam = *job->param;
+		subparam.probability=0;
+		subparam.C=1.0;
+		subparam.nr_weight=2;
+		subparam.weight_label = Malloc(int,2);
+		subparam.weight = Malloc(double,2);
+		subparam.weight_label[0]=+1;
+		subparam.weight_label[1]=-1;
+		subparam.weight[0]=job->Cp;
+		subparam.weight[1]=job->Cn;
+		struct svm_model *submodel = svm_train_model(&subprob,&subparam,NULL,NULL,job->env);
+		for(j=begin;j<end;j++)
+		{
+			svm_predict_values(submodel,prob->x[perm[j]],&(dec_values[perm[j]])); 
+			// ensure +1 -1 order; reason not using CV subroutine
+			dec_values[perm[j]] *= submodel->label[0];
+		}		
+		svm_free_and_destroy_model(&submodel);
+		svm_destroy_param(&subparam);
+	}
+	free(subprob.x);
+	free(subprob.y);
+}
+
+// Cross-validation decision values for probability estimates; the folds
+// are shuffled from seed, so they do not depend on the other callers of
+// rand() or on the order of concurrent calls
 static void svm_binary_svc_probability(
 	const svm_problem *prob, const svm_parameter *param,
-	double Cp, double Cn, double& probA, double& probB)
+	double Cp, double Cn, double& probA, double& probB, unsigned int seed,
+	const solve_env& env)
 {
 	int i;
 	int nr_fold = 5;
@@ -1936,82 +3697,38 @@ static void svm_binary_svc_probability(
 	for(i=0;i<prob->l;i++) perm[i]=i;
 	for(i=0;i<prob->l;i++)
 	{
-		int j = i+rand()%(prob->l-i);
+		int j = i+rand_r(&seed)%(prob->l-i);
 		swap(perm[i],perm[j]);
 	}
-	for(i=0;i<nr_fold;i++)
-	{
-		int begin = i*prob->l/nr_fold;
-		int end = (i+1)*prob->l/nr_fold;
-		int j,k;
-		struct svm_problem subprob;
 
-		subprob.l = prob->l-(end-begin);
-		subprob.x = Malloc(struct svm_node*,subprob.l);
-		subprob.y = Malloc(double,subprob.l);
-			
-		k=0;
-		for(j=0;j<begin;j++)
-		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
-		}
-		for(j=end;j<prob->l;j++)
-		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
-		}
-		int p_count=0,n_count=0;
-		for(j=0;j<k;j++)
-			if(subprob.y[j]>0)
-				p_count++;
-			else
-				n_count++;
-
-		if(p_count==0 && n_count==0)
-			for(j=begin;j<end;j++)
-				dec_values[perm[j]] = 0;
-		else if(p_count > 0 && n_count == 0)
-			for(j=begin;j<end;j++)
-				dec_values[perm[j]] = 1;
-		else if(p_count == 0 && n_count > 0)
-			for(j=begin;j<end;j++)
-				dec_values[perm[j]] = -1;
-		else
-		{
-			svm_parameter subparam = *param;
-			subparam.probability=0;
-			subparam.C=1.0;
-			subparam.nr_weight=2;
-			subparam.weight_label = Malloc(int,2);
-			subparam.weight = Malloc(double,2);
-			subparam.weight_label[0]=+1;
-			subparam.weight_label[1]=-1;
-			subparam.weight[0]=Cp;
-			subparam.weight[1]=Cn;
-			struct svm_model *submodel = svm_train(&subprob,&subparam);
-			for(j=begin;j<end;j++)
-			{
-				svm_predict_values(submodel,prob->x[perm[j]],&(dec_values[perm[j]])); 
-				// ensure +1 -1 order; reason not using CV subroutine
-				dec_values[perm[j]] *= submodel->label[0];
-			}		
-			svm_free_and_destroy_model(&submodel);
-			svm_destroy_param(&subparam);
-		}
-		free(subprob.x);
-		free(subprob.y);
-	}		
+	// the folds train at once share the cache budget
+	svm_parameter fold_param = *param;
+	fold_param.cache_size /= concurrent_jobs(env,nr_fold);
+
+	binary_fold_job job;
+	job.prob = prob;
+	job.param = &fold_param;
+	job.Cp = Cp;
+	job.Cn = Cn;
+	job.nr_fold = nr_fold;
+	job.perm = perm;
+	job.dec_values = dec_values;
+	job.env = jobs_env(env,nr_fold);
+	run_jobs(env,nr_fold,&svm_binary_svc_fold,&job);
+
 	sigmoid_train(prob->l,dec_values,prob->y,probA,probB);
 	free(dec_values);
 	free(perm);
 }
 
+static void svm_cross_validate(
+	const svm_problem *prob, const svm_parameter *param,
+	int nr_fold, double *target, unsigned int *seed, const solve_env& env);
+
 // Return parameter of a Laplace distribution 
 static double svm_svr_probability(
-	const svm_problem *prob, const svm_parameter *param)
+	const svm_problem *prob, const svm_parameter *param, unsigned int *seed,
+	const solve_env& env)
 {
 	int i;
 	int nr_fold = 5;
@@ -2020,7 +3737,7 @@ static double svm_svr_probability(
 
 	svm_parameter newparam = *param;
 	newparam.probability = 0;
-	svm_cross_validation(prob,&newparam,nr_fold,ymv);
+	svm_cross_validate(prob,&newparam,nr_fold,ymv,seed,env);
 	for(i=0;i<prob->l;i++)
 	{
 		ymv[i]=prob->y[i]-ymv[i];
@@ -2101,14 +3818,180 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 	free(data_label);
 }
 
+// number of nodes of a row, including the one ending it
+static int row_nodes(const svm_node *x)
+{
+	if(is_dense(x))
+		return dense_slots(dense_dim(x))+2;
+	int n = 1;
+	while(x[n-1].index != -1)
+		++n;
+	return n;
+}
+
+// Copy the SVs of a trained model into one block, in the order they are
+// evaluated, so prediction reads them sequentially instead of following
+// pointers into the training problem. A loaded model already holds its
+// SVs in one block. The squared norms of the SVs are computed once for
+// the RBF kernel.
+static void svm_pack_support_vectors(svm_model *model)
+{
+	int l = model->l;
+	if(l == 0)
+		return;
+
+	if(!model->free_sv)
+	{
+		long int total = 0;
+		for(int i=0;i<l;i++)
+			total += row_nodes(model->SV[i]);
+
+		model->sv_space = Malloc(svm_node,total);
+		svm_node *p = model->sv_space;
+		for(int i=0;i<l;i++)
+		{
+			int n = row_nodes(model->SV[i]);
+			memcpy(p,model->SV[i],sizeof(svm_node)*n);
+			model->SV[i] = p;
+			p += n;
+		}
+	}
+
+	if(model->param.kernel_type == RBF)
+	{
+		model->sv_square = Malloc(double,l);
+		for(int i=0;i<l;i++)
+			model->sv_square[i] = Kernel::square(model->SV[i]);
+	}
+}
+
+// Fold the SVs of a LINEAR model into one weight vector per decision
+// function, so a prediction is a single dot product
+static void svm_build_linear_weights(svm_model *model)
+{
+	model->w = NULL;
+	model->w_dim = 0;
+
+	int nr_class = model->nr_class;
+	bool one_function = (model->param.svm_type == ONE_CLASS ||
+			     model->param.svm_type == EPSILON_SVR ||
+			     model->param.svm_type == NU_SVR);
+	int nr_decision = one_function ? 1 : nr_class*(nr_class-1)/2;
+
+	if(model->param.kernel_type != LINEAR || nr_decision == 0 || model->l == 0)
+		return;
+
+	int w_dim = 0;
+	for(int i=0;i<model->l;i++)
+	{
+		const svm_node *p = model->SV[i];
+		if(is_dense(p))
+			w_dim = max(w_dim,dense_dim(p));
+		else
+			for(;p->index != -1;++p)
+				w_dim = max(w_dim,p->index+1);
+	}
+
+	model->w_dim = w_dim;
+	model->w = Malloc(double *,nr_decision);
+	for(int p=0;p<nr_decision;p++)
+	{
+		model->w[p] = Malloc(double,w_dim);
+		for(int k=0;k<w_dim;k++)
+			model->w[p][k] = 0;
+	}
+
+	if(one_function)
+	{
+		for(int i=0;i<model->l;i++)
+			add_to_weight(model->w[0],w_dim,model->sv_coef[0][i],model->SV[i]);
+		return;
+	}
+
+	// same pairing of coefficients as svm_predict_values
+	int *start = Malloc(int,nr_class);
+	start[0] = 0;
+	for(int i=1;i<nr_class;i++)
+		start[i] = start[i-1]+model->nSV[i-1];
+
+	int p = 0;
+	for(int i=0;i<nr_class;i++)
+		for(int j=i+1;j<nr_class;j++)
+		{
+			int k;
+			for(k=0;k<model->nSV[i];k++)
+				add_to_weight(model->w[p],w_dim,model->sv_coef[j-1][start[i]+k],model->SV[start[i]+k]);
+			for(k=0;k<model->nSV[j];k++)
+				add_to_weight(model->w[p],w_dim,model->sv_coef[i][start[j]+k],model->SV[start[j]+k]);
+			++p;
+		}
+	free(start);
+}
+
 //
 // Interface functions
 //
-svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
+// the one-vs-one problems of svm_train
+struct pair_job
+{
+	const svm_parameter *param;
+	svm_node **x;
+	const int *start, *count;
+	const double *weighted_C;
+	const int *class_i, *class_j;	// classes of each pair
+	const unsigned int *seed;	// shuffles the probability folds
+	double * const *alpha0;		// initial alphas of each pair, or NULL
+	decision_function *f;
+	double *probA, *probB;
+	solve_env env;			// of the problem of each pair
+};
+
+static void svm_train_pair(void *context, int p)
+{
+	const pair_job *job = (const pair_job *)context;
+	int i = job->class_i[p], j = job->class_j[p];
+	svm_problem sub_prob;
+	int si = job->start[i], sj = job->start[j];
+	int ci = job->count[i], cj = job->count[j];
+	sub_prob.l = ci+cj;
+	sub_prob.x = Malloc(svm_node *,sub_prob.l);
+	sub_prob.y = Malloc(double,sub_prob.l);
+	int k;
+	for(k=0;k<ci;k++)
+	{
+		sub_prob.x[k] = job->x[si+k];
+		sub_prob.y[k] = +1;
+	}
+	for(k=0;k<cj;k++)
+	{
+		sub_prob.x[ci+k] = job->x[sj+k];
+		sub_prob.y[ci+k] = -1;
+	}
+
+	double Cp = job->weighted_C[i], Cn = job->weighted_C[j];
+	if(job->param->probability)
+		svm_binary_svc_probability(&sub_prob,job->param,Cp,Cn,job->probA[p],job->probB[p],job->seed[p],job->env);
+
+	job->f[p] = svm_train_one(&sub_prob,job->param,Cp,Cn,
+				  job->alpha0 ? job->alpha0[p] : NULL,job->env);
+	free(sub_prob.x);
+	free(sub_prob.y);
+}
+
+// svm_train in env, drawing its random numbers from the stream seed, or
+// from rand() if seed is NULL; with warm, the solver starts from the
+// solutions kept there, and keeps its own in their place
+static svm_model *svm_train_model(
+	const svm_problem *prob, const svm_parameter *param, unsigned int *seed,
+	warm_start *warm, const solve_env& env)
 {
 	svm_model *model = Malloc(svm_model,1);
 	model->param = *param;
 	model->free_sv = 0;	// XXX
+	model->w = NULL;
+	model->w_dim = 0;
+	model->sv_space = NULL;
+	model->sv_square = NULL;
 
 	if(param->svm_type == ONE_CLASS ||
 	   param->svm_type == EPSILON_SVR ||
@@ -2126,10 +4009,12 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 		    param->svm_type == NU_SVR))
 		{
 			model->probA = Malloc(double,1);
-			model->probA[0] = svm_svr_probability(prob,param);
+			model->probA[0] = svm_svr_probability(prob,param,seed,env);
 		}
 
-		decision_function f = svm_train_one(prob,param,0,0);
+		double *alpha0 = warm_alpha(warm,0,prob->l,param);
+		decision_function f = svm_train_one(prob,param,0,0,alpha0,env);
+		free(alpha0);
 		model->rho = Malloc(double,1);
 		model->rho[0] = f.rho;
 
@@ -2151,6 +4036,8 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 				++j;
 			}		
 
+		if(warm != NULL)
+			keep_solutions(warm,&f,1,param);
 		free(f.alpha);
 	}
 	else
@@ -2204,43 +4091,73 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 			probB=Malloc(double,nr_class*(nr_class-1)/2);
 		}
 
+		int nr_pairs = nr_class*(nr_class-1)/2;
+		int *class_i = Malloc(int,nr_pairs);
+		int *class_j = Malloc(int,nr_pairs);
+		unsigned int *pair_seed = NULL;
+		if(param->probability)
+			pair_seed = Malloc(unsigned int,nr_pairs);
 		int p = 0;
 		for(i=0;i<nr_class;i++)
 			for(int j=i+1;j<nr_class;j++)
 			{
-				svm_problem sub_prob;
-				int si = start[i], sj = start[j];
-				int ci = count[i], cj = count[j];
-				sub_prob.l = ci+cj;
-				sub_prob.x = Malloc(svm_node *,sub_prob.l);
-				sub_prob.y = Malloc(double,sub_prob.l);
-				int k;
-				for(k=0;k<ci;k++)
-				{
-					sub_prob.x[k] = x[si+k];
-					sub_prob.y[k] = +1;
-				}
-				for(k=0;k<cj;k++)
-				{
-					sub_prob.x[ci+k] = x[sj+k];
-					sub_prob.y[ci+k] = -1;
-				}
-
-				if(param->probability)
-					svm_binary_svc_probability(&sub_prob,param,weighted_C[i],weighted_C[j],probA[p],probB[p]);
-
-				f[p] = svm_train_one(&sub_prob,param,weighted_C[i],weighted_C[j]);
-				for(k=0;k<ci;k++)
-					if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
-						nonzero[si+k] = true;
-				for(k=0;k<cj;k++)
-					if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
-						nonzero[sj+k] = true;
-				free(sub_prob.x);
-				free(sub_prob.y);
+				class_i[p] = i;
+				class_j[p] = j;
+				if(pair_seed != NULL)
+					pair_seed[p] = next_random(seed);
 				++p;
 			}
 
+		// the pairs train at once share the cache budget
+		svm_parameter pair_param = *param;
+		pair_param.cache_size /= concurrent_jobs(env,nr_pairs);
+
+		double **alpha0 = NULL;
+		if(warm != NULL)
+		{
+			alpha0 = Malloc(double *,nr_pairs);
+			for(p=0;p<nr_pairs;p++)
+				alpha0[p] = warm_alpha(warm,p,count[class_i[p]]+count[class_j[p]],param);
+		}
+
+		pair_job job;
+		job.param = &pair_param;
+		job.x = x;
+		job.start = start;
+		job.count = count;
+		job.weighted_C = weighted_C;
+		job.class_i = class_i;
+		job.class_j = class_j;
+		job.seed = pair_seed;
+		job.alpha0 = alpha0;
+		job.f = f;
+		job.probA = probA;
+		job.probB = probB;
+		job.env = jobs_env(env,nr_pairs);
+		run_jobs(env,nr_pairs,&svm_train_pair,&job);
+
+		for(p=0;p<nr_pairs;p++)
+		{
+			int si = start[class_i[p]], sj = start[class_j[p]];
+			int ci = count[class_i[p]], cj = count[class_j[p]];
+			int k;
+			for(k=0;k<ci;k++)
+				if(!nonzero[si+k] && fabs(f[p].alpha[k]) > 0)
+					nonzero[si+k] = true;
+			for(k=0;k<cj;k++)
+				if(!nonzero[sj+k] && fabs(f[p].alpha[ci+k]) > 0)
+					nonzero[sj+k] = true;
+		}
+		free(class_i);
+		free(class_j);
+		free(pair_seed);
+		if(alpha0 != NULL)
+		{
+			for(p=0;p<nr_pairs;p++)
+				free(alpha0[p]);
+			free(alpha0);
+		}
+
 		// build output
 
 		model->nr_class = nr_class;
@@ -2341,22 +4258,108 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 		free(x);
 		free(weighted_C);
 		free(nonzero);
+		if(warm != NULL)
+			keep_solutions(warm,f,nr_pairs,param);
 		for(i=0;i<nr_class*(nr_class-1)/2;i++)
 			free(f[i].alpha);
 		free(f);
 		free(nz_count);
 		free(nz_start);
 	}
+	svm_pack_support_vectors(model);
+	svm_build_linear_weights(model);
 	return model;
 }
 
-// Stratified cross validation
-void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold, double *target)
+svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
+{
+	return svm_train_model(prob,param,NULL,NULL,call_env());
+}
+
+svm_model *svm_train_on(const svm_problem *prob, const svm_parameter *param,
+	ThreadPool *pool, int num_threads)
+{
+	return svm_train_model(prob,param,NULL,NULL,pool_env(pool,num_threads));
+}
+
+// the folds of svm_cross_validate
+struct cv_fold_job
+{
+	const svm_problem *prob;
+	const svm_parameter *param;
+	const int *fold_start;
+	const int *perm;
+	unsigned int *seed;	// one stream per fold
+	double *target;
+	solve_env env;		// of the problem of each fold
+};
+
+// the samples outside of perm[begin,end), which train the fold
+static void svm_fold_problem(const svm_problem *prob, const int *perm,
+	int begin, int end, svm_problem *subprob)
+{
+	int l = prob->l;
+	int j,k;
+
+	subprob->l = l-(end-begin);
+	subprob->x = Malloc(struct svm_node*,subprob->l);
+	subprob->y = Malloc(double,subprob->l);
+		
+	k=0;
+	for(j=0;j<begin;j++)
+	{
+		subprob->x[k] = prob->x[perm[j]];
+		subprob->y[k] = prob->y[perm[j]];
+		++k;
+	}
+	for(j=end;j<l;j++)
+	{
+		subprob->x[k] = prob->x[perm[j]];
+		subprob->y[k] = prob->y[perm[j]];
+		++k;
+	}
+}
+
+// each fold writes the targets of its own samples
+static void svm_cross_validation_fold(void *context, int fold)
+{
+	const cv_fold_job *job = (const cv_fold_job *)context;
+	const svm_problem *prob = job->prob;
+	const svm_parameter *param = job->param;
+	const int *perm = job->perm;
+	double *target = job->target;
+	int begin = job->fold_start[fold];
+	int end = job->fold_start[fold+1];
+	int j;
+	struct svm_problem subprob;
+	svm_fold_problem(prob,perm,begin,end,&subprob);
+
+	struct svm_model *submodel = svm_train_model(&subprob,param,&job->seed[fold],NULL,job->env);
+	if(param->probability && 
+	   (param->svm_type == C_SVC || param->svm_type == NU_SVC))
+	{
+		double *prob_estimates=Malloc(double,svm_get_nr_class(submodel));
+		for(j=begin;j<end;j++)
+			target[perm[j]] = svm_predict_probability(submodel,prob->x[perm[j]],prob_estimates);
+		free(prob_estimates);			
+	}
+	else
+		for(j=begin;j<end;j++)
+			target[perm[j]] = svm_predict(submodel,prob->x[perm[j]]);
+	svm_free_and_destroy_model(&submodel);
+	free(subprob.x);
+	free(subprob.y);
+}
+
+// the folds of cross validation, stratified for classification: fold i
+// holds the samples
+// perm[fold_start[i],fold_start[i+1]), shuffled from the stream seed, or
+// from rand() if seed is NULL
+static void svm_make_folds(const svm_problem *prob, const svm_parameter *param,
+	int nr_fold, int *fold_start, int *perm, unsigned int *seed)
 {
 	int i;
-	int *fold_start = Malloc(int,nr_fold+1);
 	int l = prob->l;
-	int *perm = Malloc(int,l);
 	int nr_class;
 
 	// stratified cv may not give leave-one-out rate
@@ -2378,7 +4381,7 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		for (c=0; c<nr_class; c++) 
 			for(i=0;i<count[c];i++)
 			{
-				int j = i+rand()%(count[c]-i);
+				int j = i+next_random(seed)%(count[c]-i);
 				swap(index[start[c]+j],index[start[c]+i]);
 			}
 		for(i=0;i<nr_fold;i++)
@@ -2415,57 +4418,259 @@ void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, i
 		for(i=0;i<l;i++) perm[i]=i;
 		for(i=0;i<l;i++)
 		{
-			int j = i+rand()%(l-i);
+			int j = i+next_random(seed)%(l-i);
 			swap(perm[i],perm[j]);
 		}
 		for(i=0;i<=nr_fold;i++)
 			fold_start[i]=i*l/nr_fold;
 	}
+}
+
+// run_jobs, with the kernels of the jobs reading one store over prob for
+// the kernel of param through job_env, the env in their context, unless
+// param is NULL, the budget of env is 0 or env already has the store of an outer
+// cross validation
+static void run_jobs_with_store(const solve_env& env, const svm_problem *prob,
+	const svm_parameter *param, solve_env& job_env, int count,
+	ThreadPool::Task task, void *context)
+{
+	KernelStore *store = NULL;
+	if(param != NULL && env.store == NULL && env.store_size > 0)
+	{
+		store = new KernelStore(*prob,*param,(long int)(env.store_size*(1<<20)));
+		job_env.store = store;
+	}
+
+	try
+	{
+		run_jobs(env,count,task,context);
+	}
+	catch(...)
+	{
+		delete store;
+		throw;
+	}
+	delete store;
+}
+
+// Stratified cross validation; the folds and the random numbers of each
+// fold come from the stream seed, or from rand() if seed is NULL, on the
+// calling thread, so the targets do not depend on the number of threads
+static void svm_cross_validate(
+	const svm_problem *prob, const svm_parameter *param,
+	int nr_fold, double *target, unsigned int *seed, const solve_env& env)
+{
+	int i;
+	int *fold_start = Malloc(int,nr_fold+1);
+	int *perm = Malloc(int,prob->l);
+	svm_make_folds(prob,param,nr_fold,fold_start,perm,seed);
 
+	unsigned int *fold_seed = Malloc(unsigned int,nr_fold);
 	for(i=0;i<nr_fold;i++)
+		fold_seed[i] = next_random(seed);
+
+	// the folds train at once share the cache budget
+	svm_parameter fold_param = *param;
+	fold_param.cache_size /= concurrent_jobs(env,nr_fold);
+
+	cv_fold_job job;
+	job.prob = prob;
+	job.param = &fold_param;
+	job.fold_start = fold_start;
+	job.perm = perm;
+	job.seed = fold_seed;
+	job.target = target;
+	job.env = jobs_env(env,nr_fold);
+	run_jobs_with_store(env,prob,param,job.env,nr_fold,&svm_cross_validation_fold,&job);
+
+	free(fold_seed);
+	free(fold_start);
+	free(perm);	
+}
+
+void svm_cross_validation(const svm_problem *prob, const svm_parameter *param, int nr_fold, double *target)
+{
+	svm_cross_validate(prob,param,nr_fold,target,NULL,call_env());
+}
+
+void svm_cross_validation_seeded(const svm_problem *prob, const svm_parameter *param, int nr_fold, double *target, unsigned int seed)
+{
+	svm_cross_validate(prob,param,nr_fold,target,&seed,call_env());
+}
+
+//
+// Grid search
+//
+// a line of the grid holds the points of every C for one gamma and one
+// nu. A job cross validates one fold of one line, with C going up, each
+// C-SVC solve starting from the solution for the previous C; the lines and
+// the folds are independent.
+//
+struct grid_job
+{
+	const svm_problem *prob;
+	const svm_parameter *param;	// cache_size shared by the jobs
+	const svm_grid *grid;
+	int nr_C, nr_gamma;		// at least 1 each
+	const int *C_order;		// indices of the values of C, ascending
+	int nr_fold;
+	const int *fold_start, *perm;
+	double *fold_score;		// of each point in each fold
+	solve_env env;			// of the problems of each job
+};
+
+static inline bool is_regression(const svm_parameter *param)
+{
+	return param->svm_type == EPSILON_SVR || param->svm_type == NU_SVR;
+}
+
+// the parameters of a point of the grid
+static svm_parameter grid_point(const svm_parameter *param, const svm_grid *grid,
+	int C, int gamma, int nu)
+{
+	svm_parameter point = *param;
+	if(grid->nr_C > 0) point.C = grid->C[C];
+	if(grid->nr_gamma > 0) point.gamma = grid->gamma[gamma];
+	if(grid->nr_nu > 0) point.nu = grid->nu[nu];
+	return point;
+}
+
+// each job writes the number of right labels, or the squared error of
+// regression, of its fold for the points of its line
+static void svm_grid_line(void *context, int index)
+{
+	const grid_job *job = (const grid_job *)context;
+	const svm_problem *prob = job->prob;
+	const int *perm = job->perm;
+	int line = index/job->nr_fold, fold = index%job->nr_fold;
+	int gamma = line%job->nr_gamma, nu = line/job->nr_gamma;
+	int begin = job->fold_start[fold];
+	int end = job->fold_start[fold+1];
+	struct svm_problem subprob;
+	svm_fold_problem(prob,perm,begin,end,&subprob);
+
+	warm_start warm;
+	warm.C = 0;
+	warm.nr_solutions = 0;
+	warm.alpha = NULL;
+	for(int c=0;c<job->nr_C;c++)
 	{
-		int begin = fold_start[i];
-		int end = fold_start[i+1];
-		int j,k;
-		struct svm_problem subprob;
+		int C = job->C_order[c];
+		svm_parameter point = grid_point(job->param,job->grid,C,gamma,nu);
+		struct svm_model *submodel = svm_train_model(&subprob,&point,NULL,&warm,job->env);
 
-		subprob.l = l-(end-begin);
-		subprob.x = Malloc(struct svm_node*,subprob.l);
-		subprob.y = Malloc(double,subprob.l);
-			
-		k=0;
-		for(j=0;j<begin;j++)
-		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
-		}
-		for(j=end;j<l;j++)
+		double score = 0;
+		for(int j=begin;j<end;j++)
 		{
-			subprob.x[k] = prob->x[perm[j]];
-			subprob.y[k] = prob->y[perm[j]];
-			++k;
+			double y = prob->y[perm[j]];
+			double v = svm_predict(submodel,prob->x[perm[j]]);
+			if(is_regression(&point))
+				score += (v-y)*(v-y);
+			else if(v == y)
+				++score;
 		}
-		struct svm_model *submodel = svm_train(&subprob,param);
-		if(param->probability && 
-		   (param->svm_type == C_SVC || param->svm_type == NU_SVC))
-		{
-			double *prob_estimates=Malloc(double,svm_get_nr_class(submodel));
-			for(j=begin;j<end;j++)
-				target[perm[j]] = svm_predict_probability(submodel,prob->x[perm[j]],prob_estimates);
-			free(prob_estimates);			
-		}
-		else
-			for(j=begin;j<end;j++)
-				target[perm[j]] = svm_predict(submodel,prob->x[perm[j]]);
+		job->fold_score[(line*job->nr_C+C)*job->nr_fold+fold] = score;
 		svm_free_and_destroy_model(&submodel);
-		free(subprob.x);
-		free(subprob.y);
-	}		
+	}
+	free_warm_start(&warm);
+	free(subprob.x);
+	free(subprob.y);
+}
+
+// seed is NULL to draw the folds from rand()
+static svm_model *svm_search_grid(const svm_problem *prob, const svm_parameter *param,
+	const svm_grid *grid, int nr_fold, double *scores, unsigned int *seed,
+	const solve_env& env)
+{
+	int l = prob->l;
+	int nr_C = max(grid->nr_C,1);
+	int nr_gamma = max(grid->nr_gamma,1);
+	int nr_nu = max(grid->nr_nu,1);
+	int nr_lines = nr_gamma*nr_nu;
+	int nr_points = nr_lines*nr_C;
+	int i,j;
+
+	// every point is cross validated on the same folds
+	int *fold_start = Malloc(int,nr_fold+1);
+	int *perm = Malloc(int,l);
+	svm_make_folds(prob,param,nr_fold,fold_start,perm,seed);
+
+	int *C_order = Malloc(int,nr_C);
+	for(i=0;i<nr_C;i++)
+	{
+		for(j=i;j>0 && grid->C[C_order[j-1]] > grid->C[i];j--)
+			C_order[j] = C_order[j-1];
+		C_order[j] = i;
+	}
+
+	// the points are scored on their labels, the probability estimates
+	// are only trained for the best one
+	int nr_jobs = nr_lines*nr_fold;
+	svm_parameter job_param = *param;
+	job_param.probability = 0;
+	job_param.cache_size /= concurrent_jobs(env,nr_jobs);
+
+	double *fold_score = Malloc(double,nr_points*nr_fold);
+	grid_job job;
+	job.prob = prob;
+	job.param = &job_param;
+	job.grid = grid;
+	job.nr_C = nr_C;
+	job.nr_gamma = nr_gamma;
+	job.C_order = C_order;
+	job.nr_fold = nr_fold;
+	job.fold_start = fold_start;
+	job.perm = perm;
+	job.fold_score = fold_score;
+	job.env = jobs_env(env,nr_jobs);
+
+	// the kernel only depends on the grid through gamma
+	svm_parameter kernel_param = grid_point(param,grid,0,0,0);
+	run_jobs_with_store(env,prob,(nr_gamma == 1) ? &kernel_param : NULL,
+			    job.env,nr_jobs,&svm_grid_line,&job);
+
+	int best = 0;
+	for(i=0;i<nr_points;i++)
+	{
+		double sum = 0;
+		for(j=0;j<nr_fold;j++)
+			sum += fold_score[i*nr_fold+j];
+		scores[i] = sum/l;
+		if(is_regression(param) ? scores[i] < scores[best] : scores[i] > scores[best])
+			best = i;
+	}
+	free(fold_score);
+	free(C_order);
 	free(fold_start);
-	free(perm);	
+	free(perm);
+
+	svm_parameter best_param = grid_point(param,grid,best%nr_C,
+		(best/nr_C)%nr_gamma,best/(nr_C*nr_gamma));
+	info("Best grid point: C = %g, gamma = %g, nu = %g, score = %g\n",
+	     best_param.C,best_param.gamma,best_param.nu,scores[best]);
+	return svm_train_model(prob,&best_param,seed,NULL,env);
 }
 
+svm_model *svm_grid_search(const svm_problem *prob, const svm_parameter *param,
+	const svm_grid *grid, int nr_fold, double *scores)
+{
+	return svm_search_grid(prob,param,grid,nr_fold,scores,NULL,call_env());
+}
+
+svm_model *svm_grid_search_seeded(const svm_problem *prob, const svm_parameter *param,
+	const svm_grid *grid, int nr_fold, double *scores, unsigned int seed)
+{
+	return svm_search_grid(prob,param,grid,nr_fold,scores,&seed,call_env());
+}
+
+svm_model *svm_grid_search_on(const svm_problem *prob, const svm_parameter *param,
+	const svm_grid *grid, int nr_fold, double *scores, unsigned int seed,
+	double store_size, ThreadPool *pool, int num_threads)
+{
+	solve_env env = pool_env(pool,num_threads);
+	env.store_size = max(store_size,0.0);
+	return svm_search_grid(prob,param,grid,nr_fold,scores,&seed,env);
+}
 
 int svm_get_svm_type(const svm_model *model)
 {
@@ -2508,7 +4713,21 @@ double svm_get_svr_probability(const svm_model *model)
 	}
 }
 
-double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+// number of decision values of a model
+static inline int nr_decision_values(const svm_model *model)
+{
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		return 1;
+	return model->nr_class*(model->nr_class-1)/2;
+}
+
+// label and decision values of x given its kernel values with every SV;
+// kvalue is not used by a model with weight vectors. start holds the
+// first SV of each class and vote has room for a count per class.
+static double predict_from_kvalue(const svm_model *model, const svm_node *x, const double *kvalue,
+				  const int *start, int *vote, double *dec_values)
 {
 	int i;
 	if(model->param.svm_type == ONE_CLASS ||
@@ -2517,8 +4736,11 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	{
 		double *sv_coef = model->sv_coef[0];
 		double sum = 0;
-		for(i=0;i<model->l;i++)
-			sum += sv_coef[i] * Kernel::k_function(x,model->SV[i],model->param);
+		if(model->w != NULL)
+			sum = weight_dot(x,model->w[0],model->w_dim);
+		else
+			for(i=0;i<model->l;i++)
+				sum += sv_coef[i] * kvalue[i];
 		sum -= model->rho[0];
 		*dec_values = sum;
 
@@ -2530,18 +4752,7 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	else
 	{
 		int nr_class = model->nr_class;
-		int l = model->l;
-		
-		double *kvalue = Malloc(double,l);
-		for(i=0;i<l;i++)
-			kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
-
-		int *start = Malloc(int,nr_class);
-		start[0] = 0;
-		for(i=1;i<nr_class;i++)
-			start[i] = start[i-1]+model->nSV[i-1];
 
-		int *vote = Malloc(int,nr_class);
 		for(i=0;i<nr_class;i++)
 			vote[i] = 0;
 
@@ -2558,10 +4769,15 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 				int k;
 				double *coef1 = model->sv_coef[j-1];
 				double *coef2 = model->sv_coef[i];
-				for(k=0;k<ci;k++)
-					sum += coef1[si+k] * kvalue[si+k];
-				for(k=0;k<cj;k++)
-					sum += coef2[sj+k] * kvalue[sj+k];
+				if(model->w != NULL)
+					sum = weight_dot(x,model->w[p],model->w_dim);
+				else
+				{
+					for(k=0;k<ci;k++)
+						sum += coef1[si+k] * kvalue[si+k];
+					for(k=0;k<cj;k++)
+						sum += coef2[sj+k] * kvalue[sj+k];
+				}
 				sum -= model->rho[p];
 				dec_values[p] = sum;
 
@@ -2577,13 +4793,146 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 			if(vote[i] > vote[vote_max_idx])
 				vote_max_idx = i;
 
-		free(kvalue);
-		free(start);
-		free(vote);
 		return model->label[vote_max_idx];
 	}
 }
 
+// squared norm of a sample, if the model has the norms of its SVs
+static inline double sample_square(const svm_model *model, const svm_node *x)
+{
+	return model->sv_square ? Kernel::square(x) : 0;
+}
+
+// kernel values of a sample with the SVs [begin,end) of a model, for a
+// kernel type known at compile time
+template<int type>
+static void sv_kernels_of(const svm_model *model, const svm_node *x, double x_square,
+			  int begin, int end, double *kvalue)
+{
+	const svm_parameter& param = model->param;
+	if(model->sv_square)
+		for(int k=begin;k<end;k++)
+			kvalue[k] = Kernel::k_value<type>(x,x_square,model->SV[k],model->sv_square[k],param);
+	else
+		for(int k=begin;k<end;k++)
+			kvalue[k] = Kernel::k_value<type>(x,model->SV[k],param);
+}
+
+// kernel values of a sample with the SVs [begin,end) of a model
+static void sv_kernels(const svm_model *model, const svm_node *x, double x_square,
+		       int begin, int end, double *kvalue)
+{
+	switch(model->param.kernel_type)
+	{
+		case LINEAR:
+			sv_kernels_of<LINEAR>(model,x,x_square,begin,end,kvalue);
+			break;
+		case POLY:
+			sv_kernels_of<POLY>(model,x,x_square,begin,end,kvalue);
+			break;
+		case RBF:
+			sv_kernels_of<RBF>(model,x,x_square,begin,end,kvalue);
+			break;
+		case SIGMOID:
+			sv_kernels_of<SIGMOID>(model,x,x_square,begin,end,kvalue);
+			break;
+		case PRECOMPUTED:
+			sv_kernels_of<PRECOMPUTED>(model,x,x_square,begin,end,kvalue);
+			break;
+	}
+}
+
+// first SV of each class, or NULL for a model without classes
+static int *class_starts(const svm_model *model)
+{
+	if(model->nSV == NULL)
+		return NULL;
+	int *start = Malloc(int,model->nr_class);
+	start[0] = 0;
+	for(int i=1;i<model->nr_class;i++)
+		start[i] = start[i-1]+model->nSV[i-1];
+	return start;
+}
+
+double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	// a linear model needs no kernel values, only its weight vectors
+	double *kvalue = NULL;
+	if(model->w == NULL)
+	{
+		double x_square = sample_square(model,x);
+		kvalue = Malloc(double,model->l);
+		sv_kernels(model,x,x_square,0,model->l,kvalue);
+	}
+
+	int *start = class_starts(model);
+	int *vote = Malloc(int,model->nr_class);
+	double label = predict_from_kvalue(model,x,kvalue,start,vote,dec_values);
+
+	free(kvalue);
+	free(start);
+	free(vote);
+	return label;
+}
+
+// samples and SVs per block of the kernel matrix in svm_predict_batch
+#define PREDICT_BLOCK_ROWS 16
+#define PREDICT_BLOCK_SVS 256
+
+void svm_predict_batch(const svm_model *model, const svm_node * const *x, int n,
+		       double *labels, double *dec_values)
+{
+	int l = model->l;
+	int nr_decision = nr_decision_values(model);
+	int *start = class_starts(model);
+	int *vote = Malloc(int,model->nr_class);
+	double *own_dec_values = NULL;
+	if(dec_values == NULL)
+		own_dec_values = Malloc(double,max(nr_decision,1));
+
+	// kernel values of a block of samples with every SV
+	double *kvalue = NULL;
+	if(model->w == NULL)
+		kvalue = Malloc(double,(long int)PREDICT_BLOCK_ROWS*max(l,1));
+
+	for(int first=0;first<n;first+=PREDICT_BLOCK_ROWS)
+	{
+		int rows = min(n-first,PREDICT_BLOCK_ROWS);
+
+		// each block of SVs is used by every sample of the block while it
+		// is still in cache
+		double x_square[PREDICT_BLOCK_ROWS];
+		if(kvalue != NULL)
+		{
+			for(int r=0;r<rows;r++)
+				x_square[r] = sample_square(model,x[first+r]);
+
+			for(int sv=0;sv<l;sv+=PREDICT_BLOCK_SVS)
+			{
+				int sv_end = min(l,sv+PREDICT_BLOCK_SVS);
+				for(int r=0;r<rows;r++)
+					sv_kernels(model,x[first+r],x_square[r],sv,sv_end,
+						   kvalue+(long int)r*l);
+			}
+		}
+
+		for(int r=0;r<rows;r++)
+		{
+			double *out = dec_values ? dec_values+(long int)(first+r)*nr_decision : own_dec_values;
+			double label = predict_from_kvalue(model,x[first+r],
+							   kvalue ? kvalue+(long int)r*l : NULL,
+							   start,vote,out);
+			if(labels != NULL)
+				labels[first+r] = label;
+		}
+	}
+
+	free(kvalue);
+	free(own_dec_values);
+	free(start);
+	free(vote);
+}
+
 double svm_predict(const svm_model *model, const svm_node *x)
 {
 	int nr_class = model->nr_class;
@@ -2726,6 +5075,14 @@ int svm_save_model(const char *model_file_name, const svm_model *model)
 
 		if(param.kernel_type == PRECOMPUTED)
 			fprintf(fp,"0:%d ",(int)(p->value));
+		else if(is_dense(p))
+		{
+			// dense rows are saved as sparse rows, loaded back as such
+			const float *values = dense_values(p);
+			for(int k=0;k<dense_dim(p);k++)
+				if(values[k] != 0)
+					fprintf(fp,"%d:%.8g ",k,values[k]);
+		}
 		else
 			while(p->index != -1)
 			{
@@ -2775,6 +5132,10 @@ svm_model *svm_load_model(const char *model_file_name)
 
 	svm_model *model = Malloc(svm_model,1);
 	svm_parameter& param = model->param;
+	model->w = NULL;
+	model->w_dim = 0;
+	model->sv_space = NULL;
+	model->sv_square = NULL;
 	model->rho = NULL;
 	model->probA = NULL;
 	model->probB = NULL;
@@ -2975,6 +5336,8 @@ svm_model *svm_load_model(const char *model_file_name)
 		return NULL;
 
 	model->free_sv = 1;	// XXX
+	svm_pack_support_vectors(model);
+	svm_build_linear_weights(model);
 	return model;
 }
 
@@ -3008,6 +5371,24 @@ void svm_free_model_content(svm_model* model_ptr)
 
 	free(model_ptr->nSV);
 	model_ptr->nSV = NULL;
+
+	if(model_ptr->w)
+	{
+		int nr_class = model_ptr->nr_class;
+		int nr_decision = (model_ptr->param.svm_type == C_SVC ||
+				   model_ptr->param.svm_type == NU_SVC) ? nr_class*(nr_class-1)/2 : 1;
+		for(int i=0;i<nr_decision;i++)
+			free(model_ptr->w[i]);
+	}
+	free(model_ptr->w);
+	model_ptr->w = NULL;
+	model_ptr->w_dim = 0;
+
+	free(model_ptr->sv_space);
+	model_ptr->sv_space = NULL;
+
+	free(model_ptr->sv_square);
+	model_ptr->sv_square = NULL;
 }
 
 void svm_free_and_destroy_model(svm_model** model_ptr_ptr)
@@ -3028,6 +5409,26 @@ void svm_destroy_param(svm_parameter* param)
         param->weight = NULL;
 }
 
+const char *svm_check_grid(const svm_problem *prob, const svm_parameter *param,
+	const svm_grid *grid, int nr_fold)
+{
+	if(nr_fold < 2)
+		return "nr_fold < 2";
+	if(grid->nr_C < 0 || grid->nr_gamma < 0 || grid->nr_nu < 0)
+		return "number of grid values < 0";
+
+	for(int nu=0;nu<max(grid->nr_nu,1);nu++)
+		for(int gamma=0;gamma<max(grid->nr_gamma,1);gamma++)
+			for(int C=0;C<max(grid->nr_C,1);C++)
+			{
+				svm_parameter point = grid_point(param,grid,C,gamma,nu);
+				const char *error_msg = svm_check_parameter(prob,&point);
+				if(error_msg)
+					return error_msg;
+			}
+	return NULL;
+}
+
 const char *svm_check_parameter(const svm_problem *prob, const svm_parameter *param)
 {
 	// svm_type
@@ -3157,6 +5558,34 @@ int svm_check_probability_model(const svm_model *model)
 		 model->probA!=NULL);
 }
 
+void svm_set_num_threads(int num_threads)
+{
+	if(num_threads < 1)
+		num_threads = 1;
+	if(num_threads == svm_get_num_threads())
+		return;
+
+	delete column_pool;
+	column_pool = NULL;
+	if(num_threads > 1)
+		column_pool = new ThreadPool(num_threads);
+}
+
+int svm_get_num_threads()
+{
+	return (column_pool != NULL) ? column_pool->size() : 1;
+}
+
+void svm_set_cv_cache_size(double cache_size)
+{
+	cv_cache_size = max(cache_size,0.0);
+}
+
+double svm_get_cv_cache_size()
+{
+	return cv_cache_size;
+}
+
 void svm_set_print_string_function(void (*print_func)(const char *))
 {
 	if(print_func == NULL)
@@ -3164,3 +5593,35 @@ void svm_set_print_string_function(void (*print_func)(const char *))
 	else
 		svm_print_string = print_func;
 }
+
+int svm_dense_row_nodes(int dim)
+{
+	return dense_slots(dim)+2;
+}
+
+void svm_fill_dense_row(svm_node *row, const float *values, int dim)
+{
+	int slots = dense_slots(dim);
+	row[0].index = SVM_DENSE_INDEX;
+	row[0].value = dim;
+	memset(row+1,0,sizeof(svm_node)*slots);
+	if(dim > 0)
+		memcpy(row+1,values,sizeof(float)*dim);
+	row[slots+1].index = -1;
+	row[slots+1].value = 0;
+}
+
+int svm_is_dense_row(const svm_node *x)
+{
+	return is_dense(x) ? 1 : 0;
+}
+
+int svm_dense_row_dim(const svm_node *x)
+{
+	return is_dense(x) ? dense_dim(x) : 0;
+}
+
+const float *svm_dense_row_values(const svm_node *x)
+{
+	return is_dense(x) ? dense_values(x) : NULL;
+}
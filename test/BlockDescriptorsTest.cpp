@@ -0,0 +1,144 @@
+#include <iostream>
+#include <math.h>
+#include <stdexcept>
+#include <BlockDescriptors.hpp>
+
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Tests for the BlockDescriptors class
+namespace TestHOGCV
+{
+  /// @brief Google test fixture class to test the block normalization stage
+  class BlockDescriptorsTest : public ::testing::Test
+  {
+    protected:
+    /// Histograms of a grid of 5 x 4 cells of 2 x 2 pixels
+    CellHistograms cells;
+
+    /// The number of orientation bins
+    static const int NBINS = 4;
+
+    /// @brief Builds cell histograms where every cell has a distinct pattern
+    virtual void SetUp()
+    {
+      cv::Mat gradMag(8, 10, CV_32F);
+      cv::Mat gradBin(8, 10, CV_8U);
+      for (int i = 0; i < gradMag.rows; i++)
+      {
+        for (int j = 0; j < gradMag.cols; j++)
+        {
+          gradMag.at<float>(i,j) = (float) (1 + (i*3 + j*5) % 7);
+          gradBin.at<uchar>(i,j) = (uchar) ((i + j*j) % NBINS);
+        }
+      }
+      cells.compute(gradMag, gradBin, 2, 2, NBINS, CellHistograms::HARD);
+    }
+  };
+
+  const int BlockDescriptorsTest::NBINS;
+
+/// @brief Overlapping blocks reuse the cell histograms in row major order
+TEST_F(BlockDescriptorsTest, testOverlappingBlockLayout)
+{
+  BlockDescriptors blocks(2, 2, 1, 1, BlockDescriptors::L2);
+  std::vector<float> descriptors;
+
+  blocks.compute(cells, descriptors);
+
+  ASSERT_EQ(4, blocks.blocksX(cells));
+  ASSERT_EQ(3, blocks.blocksY(cells));
+  ASSERT_EQ(2*2*NBINS, blocks.blockLength(cells));
+  ASSERT_EQ((size_t) 4*3*2*2*NBINS, descriptors.size());
+
+  for (int by = 0; by < 3; by++)
+  {
+    for (int bx = 0; bx < 4; bx++)
+    {
+      std::vector<float> expected;
+      for (int cy = by; cy < by + 2; cy++)
+        for (int cx = bx; cx < bx + 2; cx++)
+          for (int b = 0; b < NBINS; b++)
+            expected.push_back(cells.value(cy, cx, b));
+
+      float norm = 0.0;
+      for (unsigned int k = 0; k < expected.size(); k++)
+        norm += expected[k] * expected[k];
+      norm = sqrt(norm + BlockDescriptors::EPSILON * BlockDescriptors::EPSILON);
+
+      const float* block = &descriptors[(by*4 + bx) * blocks.blockLength(cells)];
+      for (unsigned int k = 0; k < expected.size(); k++)
+        EXPECT_NEAR(expected[k] / norm, block[k], 1e-6);
+    }
+  }
+}
+
+/// @brief The stride selects which cells start a block
+TEST_F(BlockDescriptorsTest, testStride)
+{
+  BlockDescriptors blocks(2, 2, 2, 3, BlockDescriptors::L2);
+  BlockDescriptors tooLarge(6, 1, 1, 1, BlockDescriptors::L2);
+  std::vector<float> descriptors;
+
+  EXPECT_EQ(2, blocks.blocksX(cells));
+  EXPECT_EQ(1, blocks.blocksY(cells));
+
+  tooLarge.compute(cells, descriptors);
+  EXPECT_EQ(0, tooLarge.blocksX(cells));
+  EXPECT_TRUE(descriptors.empty());
+}
+
+/// @brief L2-Hys clips large values and renormalizes
+TEST_F(BlockDescriptorsTest, testL2HysNormalization)
+{
+  BlockDescriptors blocks(1, 1, 1, 1, BlockDescriptors::L2_HYS);
+  float block[] = {10.0, 1.0, 1.0, 0.0};
+
+  blocks.normalize(block, 4);
+
+  // after clipping the values are 0.2, 0.0995, 0.0995 and 0
+  float clipped = 1.0 / sqrt(102.0 + 1e-6);
+  float norm = sqrt(0.2*0.2 + 2.0*clipped*clipped);
+  EXPECT_NEAR(0.2 / norm, block[0], 1e-5);
+  EXPECT_NEAR(clipped / norm, block[1], 1e-5);
+  EXPECT_NEAR(clipped / norm, block[2], 1e-5);
+  EXPECT_EQ(0.0, block[3]);
+}
+
+/// @brief L1-sqrt takes the square root of the L1 normalized values
+TEST_F(BlockDescriptorsTest, testL1SqrtNormalization)
+{
+  BlockDescriptors blocks(1, 1, 1, 1, BlockDescriptors::L1_SQRT);
+  float block[] = {9.0, 4.0, 3.0, 0.0};
+
+  blocks.normalize(block, 4);
+
+  EXPECT_NEAR(sqrt(9.0 / 16.0), block[0], 1e-4);
+  EXPECT_NEAR(sqrt(4.0 / 16.0), block[1], 1e-4);
+  EXPECT_NEAR(sqrt(3.0 / 16.0), block[2], 1e-4);
+  EXPECT_EQ(0.0, block[3]);
+}
+
+/// @brief Empty blocks stay finite
+TEST_F(BlockDescriptorsTest, testEmptyBlock)
+{
+  float block[] = {0.0, 0.0, 0.0, 0.0};
+  BlockDescriptors l2Hys(1, 1, 1, 1, BlockDescriptors::L2_HYS);
+  BlockDescriptors l1Sqrt(1, 1, 1, 1, BlockDescriptors::L1_SQRT);
+
+  l2Hys.normalize(block, 4);
+  l1Sqrt.normalize(block, 4);
+
+  for (int k = 0; k < 4; k++)
+    EXPECT_EQ(0.0, block[k]);
+}
+
+/// @brief Invalid block sizes and strides are rejected
+TEST_F(BlockDescriptorsTest, testConstructorWithInvalidArguments)
+{
+  EXPECT_THROW(BlockDescriptors(0, 2, 1, 1, BlockDescriptors::L2), std::invalid_argument);
+  EXPECT_THROW(BlockDescriptors(2, 0, 1, 1, BlockDescriptors::L2), std::invalid_argument);
+  EXPECT_THROW(BlockDescriptors(2, 2, 0, 1, BlockDescriptors::L2), std::invalid_argument);
+  EXPECT_THROW(BlockDescriptors(2, 2, 1, 0, BlockDescriptors::L2), std::invalid_argument);
+}
+}
@@ -0,0 +1,123 @@
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <BoundedQueue.hpp>
+#include <ThreadPool.hpp>
+
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Tests for the BoundedQueue class
+namespace TestHOGCV
+{
+  /// @brief Google test fixture class to test the bounded queue
+  class BoundedQueueTest : public ::testing::Test
+  {
+    protected:
+    /// @brief A producer and a consumer connected by a small queue
+    struct ProducerConsumer
+    {
+      /// @brief Constructor
+      ProducerConsumer(int count, size_t capacity)
+      : count(count), queue(capacity)
+      {
+      }
+
+      /// The number of items produced
+      int count;
+
+      /// The queue between the two threads
+      BoundedQueue<int> queue;
+
+      /// The items in the order they were consumed
+      std::vector<int> consumed;
+
+      /// @brief Worker 0 produces, worker 1 consumes
+      void operator()(int worker)
+      {
+        if (worker == 0)
+        {
+          for (int i = 0; i < count; i++)
+            queue.push(i);
+          queue.close();
+        }
+        else
+        {
+          int item;
+          while (queue.pop(item))
+            consumed.push_back(item);
+        }
+      }
+    };
+  };
+
+/// @brief Items come out in the order they were added
+TEST_F(BoundedQueueTest, testFirstInFirstOut)
+{
+  BoundedQueue<int> queue(3);
+  int item;
+
+  EXPECT_EQ((size_t) 3, queue.capacity());
+  EXPECT_TRUE(queue.push(1));
+  EXPECT_TRUE(queue.push(2));
+  EXPECT_TRUE(queue.push(3));
+
+  EXPECT_TRUE(queue.pop(item));
+  EXPECT_EQ(1, item);
+  EXPECT_TRUE(queue.push(4));
+
+  EXPECT_TRUE(queue.pop(item));
+  EXPECT_EQ(2, item);
+  EXPECT_TRUE(queue.pop(item));
+  EXPECT_EQ(3, item);
+  EXPECT_TRUE(queue.pop(item));
+  EXPECT_EQ(4, item);
+}
+
+/// @brief A closed queue is drained and then reports that it is done
+TEST_F(BoundedQueueTest, testClose)
+{
+  BoundedQueue<int> queue(2);
+  int item;
+
+  queue.push(7);
+  queue.close();
+
+  EXPECT_FALSE(queue.push(8));
+  EXPECT_TRUE(queue.pop(item));
+  EXPECT_EQ(7, item);
+  EXPECT_FALSE(queue.pop(item));
+}
+
+/// @brief Taking from an empty queue without waiting fails
+TEST_F(BoundedQueueTest, testTryPop)
+{
+  BoundedQueue<int> queue(2);
+  int item;
+
+  EXPECT_FALSE(queue.tryPop(item));
+  queue.push(5);
+  EXPECT_TRUE(queue.tryPop(item));
+  EXPECT_EQ(5, item);
+  EXPECT_FALSE(queue.tryPop(item));
+}
+
+/// @brief A producer blocked on a full queue hands over every item
+TEST_F(BoundedQueueTest, testProducerAndConsumer)
+{
+  ThreadPool pool(2);
+  ProducerConsumer pipeline(1000, 2);
+
+  pool.parallelFor(2, pipeline);
+
+  ASSERT_EQ((size_t) 1000, pipeline.consumed.size());
+  for (int i = 0; i < 1000; i++)
+    EXPECT_EQ(i, pipeline.consumed[i]);
+}
+
+/// @brief A queue without room is rejected
+TEST_F(BoundedQueueTest, testConstructorWithInvalidCapacity)
+{
+  EXPECT_THROW(BoundedQueue<int>(0), std::invalid_argument);
+}
+}
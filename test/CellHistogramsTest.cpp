@@ -0,0 +1,188 @@
+#include <iostream>
+#include <math.h>
+#include <stdexcept>
+#include <CellHistograms.hpp>
+
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Tests for the CellHistograms class
+namespace TestHOGCV
+{
+  /// @brief Google test fixture class to test the cell histogram stage
+  class CellHistogramsTest : public ::testing::Test
+  {
+    protected:
+    /// Gradient magnitudes
+    cv::Mat gradMag;
+
+    /// Gradient orientations in degrees
+    cv::Mat gradOrient;
+
+    /// Gradient orientation bins
+    cv::Mat gradBin;
+
+    /// The number of orientation bins
+    static const int NBINS = 9;
+
+    /// @brief Fills the gradient planes with a pattern that hits every bin
+    virtual void SetUp()
+    {
+      gradMag = cv::Mat(7, 10, CV_32F);
+      gradOrient = cv::Mat(7, 10, CV_32F);
+      gradBin = cv::Mat(7, 10, CV_8U);
+      for (int i = 0; i < gradMag.rows; i++)
+      {
+        for (int j = 0; j < gradMag.cols; j++)
+        {
+          gradMag.at<float>(i,j) = (float) ((i*7 + j*3) % 11);
+          gradOrient.at<float>(i,j) = (float) ((i*41 + j*17) % 180) + 0.5f;
+          gradBin.at<uchar>(i,j) = (uchar) ((i*5 + j) % NBINS);
+        }
+      }
+    }
+  };
+
+  const int CellHistogramsTest::NBINS;
+
+/// @brief Hard votes are the sums of the magnitudes of each bin in a cell
+TEST_F(CellHistogramsTest, testHardMatchesSums)
+{
+  CellHistograms cells;
+  int cellSizeX = 2;
+  int cellSizeY = 3;
+
+  cells.compute(gradMag, gradBin, cellSizeX, cellSizeY, NBINS, CellHistograms::HARD);
+
+  ASSERT_EQ(5, cells.cellsX());
+  ASSERT_EQ(2, cells.cellsY());
+  ASSERT_EQ(NBINS, cells.bins());
+
+  for (int cy = 0; cy < cells.cellsY(); cy++)
+  {
+    for (int cx = 0; cx < cells.cellsX(); cx++)
+    {
+      float expected[NBINS] = {0};
+      float histogram[NBINS];
+
+      for (int i = cy*cellSizeY; i < (cy+1)*cellSizeY; i++)
+        for (int j = cx*cellSizeX; j < (cx+1)*cellSizeX; j++)
+          expected[gradBin.at<uchar>(i,j)] += gradMag.at<float>(i,j);
+
+      cells.histogram(cy, cx, histogram);
+      for (int b = 0; b < NBINS; b++)
+      {
+        EXPECT_FLOAT_EQ(expected[b], cells.value(cy, cx, b));
+        EXPECT_FLOAT_EQ(expected[b], cells.plane(b)[cy*cells.cellsX() + cx]);
+        EXPECT_FLOAT_EQ(expected[b], histogram[b]);
+      }
+    }
+  }
+}
+
+/// @brief Hard votes from orientations in degrees use the containing bin
+TEST_F(CellHistogramsTest, testHardWithDegrees)
+{
+  CellHistograms fromDegrees;
+  CellHistograms fromBins;
+  cv::Mat bins(gradOrient.rows, gradOrient.cols, CV_8U);
+
+  for (int i = 0; i < gradOrient.rows; i++)
+    for (int j = 0; j < gradOrient.cols; j++)
+      bins.at<uchar>(i,j) = (uchar) (((int) (gradOrient.at<float>(i,j) * NBINS / 180.0)) % NBINS);
+
+  fromDegrees.compute(gradMag, gradOrient, 3, 3, NBINS, CellHistograms::HARD);
+  fromBins.compute(gradMag, bins, 3, 3, NBINS, CellHistograms::HARD);
+
+  for (int cy = 0; cy < fromBins.cellsY(); cy++)
+    for (int cx = 0; cx < fromBins.cellsX(); cx++)
+      for (int b = 0; b < NBINS; b++)
+        EXPECT_FLOAT_EQ(fromBins.value(cy, cx, b), fromDegrees.value(cy, cx, b));
+}
+
+/// @brief A pixel at a cell centre with a bin centre orientation casts a
+/// single vote
+TEST_F(CellHistogramsTest, testTrilinearCentreVote)
+{
+  CellHistograms cells;
+  cv::Mat mag = cv::Mat::zeros(9, 9, CV_32F);
+  cv::Mat orient = cv::Mat::zeros(9, 9, CV_32F);
+
+  // (4,7) is the centre of cell (1,2), 50 degrees the centre of bin 2
+  mag.at<float>(4,7) = 2.0;
+  orient.at<float>(4,7) = 50.0;
+
+  cells.compute(mag, orient, 3, 3, NBINS, CellHistograms::TRILINEAR);
+
+  for (int cy = 0; cy < cells.cellsY(); cy++)
+  {
+    for (int cx = 0; cx < cells.cellsX(); cx++)
+    {
+      for (int b = 0; b < NBINS; b++)
+      {
+        float expected = ((cy == 1) && (cx == 2) && (b == 2)) ? 2.0 : 0.0;
+        EXPECT_NEAR(expected, cells.value(cy, cx, b), 1e-5);
+      }
+    }
+  }
+}
+
+/// @brief Interior votes are shared without losing any magnitude, and
+/// orientations near 0 and 180 degrees share the first and last bins
+TEST_F(CellHistogramsTest, testTrilinearConservesMagnitude)
+{
+  CellHistograms cells;
+  cv::Mat mag = cv::Mat::zeros(9, 9, CV_32F);
+  float total = 0.0;
+
+  // pixels 1 to 7 lie between the centres of the first and last cells
+  for (int i = 1; i < 8; i++)
+  {
+    for (int j = 1; j < 8; j++)
+    {
+      mag.at<float>(i,j) = (float) (1 + (i*j) % 4);
+      total += mag.at<float>(i,j);
+    }
+  }
+
+  cv::Mat orient(9, 9, CV_32F);
+  for (int i = 0; i < orient.rows; i++)
+    for (int j = 0; j < orient.cols; j++)
+      orient.at<float>(i,j) = (float) ((i*53 + j*29) % 181);
+
+  cells.compute(mag, orient, 3, 3, NBINS, CellHistograms::TRILINEAR);
+
+  float sum = 0.0;
+  for (int b = 0; b < NBINS; b++)
+    for (int k = 0; k < cells.cellsY()*cells.cellsX(); k++)
+      sum += cells.plane(b)[k];
+
+  EXPECT_NEAR(total, sum, 1e-3);
+
+  // 0 degrees is halfway between the centres of the last and first bins
+  CellHistograms wrapped;
+  cv::Mat one = cv::Mat::zeros(3, 3, CV_32F);
+  cv::Mat zero = cv::Mat::zeros(3, 3, CV_32F);
+  one.at<float>(1,1) = 1.0;
+
+  wrapped.compute(one, zero, 3, 3, NBINS, CellHistograms::TRILINEAR);
+  EXPECT_NEAR(0.5, wrapped.value(0, 0, 0), 1e-5);
+  EXPECT_NEAR(0.5, wrapped.value(0, 0, NBINS-1), 1e-5);
+}
+
+/// @brief Invalid gradient planes and parameters are rejected
+TEST_F(CellHistogramsTest, testComputeWithInvalidArguments)
+{
+  CellHistograms cells;
+  cv::Mat smaller(3, 3, CV_32F);
+  cv::Mat doubles(7, 10, CV_64F);
+
+  EXPECT_THROW(cells.compute(gradMag, smaller, 3, 3, NBINS, CellHistograms::HARD), std::invalid_argument);
+  EXPECT_THROW(cells.compute(doubles, gradOrient, 3, 3, NBINS, CellHistograms::HARD), std::invalid_argument);
+  EXPECT_THROW(cells.compute(gradMag, doubles, 3, 3, NBINS, CellHistograms::HARD), std::invalid_argument);
+  EXPECT_THROW(cells.compute(gradMag, gradOrient, 0, 3, NBINS, CellHistograms::HARD), std::invalid_argument);
+  EXPECT_THROW(cells.compute(gradMag, gradOrient, 3, 0, NBINS, CellHistograms::HARD), std::invalid_argument);
+  EXPECT_THROW(cells.compute(gradMag, gradOrient, 3, 3, 0, CellHistograms::HARD), std::invalid_argument);
+  EXPECT_THROW(cells.compute(gradMag, gradBin, 3, 3, NBINS, CellHistograms::TRILINEAR), std::invalid_argument);
+}
+}
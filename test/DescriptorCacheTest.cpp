@@ -0,0 +1,147 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <stdexcept>
+#include <stdio.h>
+#include <DescriptorCache.hpp>
+
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Tests for the DescriptorCache class
+namespace TestHOGCV
+{
+  /// @brief Google test fixture class to test the descriptor cache
+  class DescriptorCacheTest : public ::testing::Test
+  {
+    protected:
+    /// Path of the cache file used by a test
+    std::string cacheFile;
+
+    /// Contents standing in for an image file
+    std::string imageBytes;
+
+    /// Descriptors standing in for those of the image
+    std::vector<float> descriptors;
+
+    /// @brief Starts every test without a cache file
+    virtual void SetUp()
+    {
+      cacheFile = "descriptor_cache_test.hogcache";
+      remove(cacheFile.c_str());
+
+      imageBytes = "not really an image";
+      for (int i = 0; i < 100; i++)
+        descriptors.push_back(i * 0.25f);
+    }
+
+    /// @brief Removes the cache file
+    virtual void TearDown()
+    {
+      remove(cacheFile.c_str());
+    }
+
+    /// Returns the key of the image bytes for a configuration
+    DescriptorCache::Key key(uint64_t configHash)
+    {
+      return DescriptorCache::makeKey(imageBytes.data(), imageBytes.size(), configHash);
+    }
+  };
+
+/// @brief The hash is the reference 64 bit FNV-1a
+TEST_F(DescriptorCacheTest, testHash)
+{
+  EXPECT_EQ(DescriptorCache::FNV_OFFSET_BASIS, DescriptorCache::hash("", 0));
+  EXPECT_EQ(0xaf63dc4c8601ec8cULL, DescriptorCache::hash("a", 1));
+
+  // hashing in pieces gives the same result
+  uint64_t first = DescriptorCache::hash("foo", 3);
+  EXPECT_EQ(DescriptorCache::hash("foobar", 6), DescriptorCache::hash("bar", 3, first));
+}
+
+/// @brief Inserted descriptors are found again
+TEST_F(DescriptorCacheTest, testInsertAndLookup)
+{
+  DescriptorCache cache(cacheFile);
+  std::vector<float> found;
+
+  EXPECT_EQ((size_t) 0, cache.size());
+  EXPECT_FALSE(cache.lookup(key(1), found));
+
+  EXPECT_TRUE(cache.insert(key(1), descriptors));
+  EXPECT_EQ((size_t) 1, cache.size());
+  ASSERT_TRUE(cache.lookup(key(1), found));
+  EXPECT_EQ(descriptors, found);
+
+  // other settings or other contents are not found
+  EXPECT_FALSE(cache.lookup(key(2), found));
+  imageBytes = "another image";
+  EXPECT_FALSE(cache.lookup(key(1), found));
+}
+
+/// @brief Descriptors are found again after the cache is reopened
+TEST_F(DescriptorCacheTest, testReopen)
+{
+  std::vector<float> empty;
+  {
+    DescriptorCache cache(cacheFile);
+    cache.insert(key(1), descriptors);
+    cache.insert(key(2), empty);
+  }
+
+  DescriptorCache cache(cacheFile);
+  std::vector<float> found;
+
+  EXPECT_EQ((size_t) 2, cache.size());
+  ASSERT_TRUE(cache.lookup(key(1), found));
+  EXPECT_EQ(descriptors, found);
+  ASSERT_TRUE(cache.lookup(key(2), found));
+  EXPECT_TRUE(found.empty());
+
+  // records added after reopening are found next to the mapped ones
+  EXPECT_TRUE(cache.insert(key(3), descriptors));
+  ASSERT_TRUE(cache.lookup(key(3), found));
+  EXPECT_EQ(descriptors, found);
+}
+
+/// @brief A record cut short is dropped when the cache is reopened
+TEST_F(DescriptorCacheTest, testTruncatedRecord)
+{
+  {
+    DescriptorCache cache(cacheFile);
+    cache.insert(key(1), descriptors);
+    cache.insert(key(2), descriptors);
+  }
+
+  // cut the last record in the middle of its values
+  std::ifstream in(cacheFile.c_str(), std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  std::ofstream out(cacheFile.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(contents.data(), contents.size() - 10);
+  out.close();
+
+  DescriptorCache cache(cacheFile);
+  std::vector<float> found;
+
+  EXPECT_EQ((size_t) 1, cache.size());
+  EXPECT_TRUE(cache.lookup(key(1), found));
+  EXPECT_FALSE(cache.lookup(key(2), found));
+
+  // the next record replaces the partial one
+  EXPECT_TRUE(cache.insert(key(2), descriptors));
+  ASSERT_TRUE(cache.lookup(key(2), found));
+  EXPECT_EQ(descriptors, found);
+}
+
+/// @brief A file that is not a cache is rejected
+TEST_F(DescriptorCacheTest, testInvalidFile)
+{
+  std::ofstream out(cacheFile.c_str(), std::ios::binary);
+  out << "this is not a descriptor cache";
+  out.close();
+
+  EXPECT_THROW(DescriptorCache cache(cacheFile), std::invalid_argument);
+  EXPECT_THROW(DescriptorCache cache("no_such_directory/cache"), std::invalid_argument);
+}
+}
@@ -0,0 +1,233 @@
+#include <iostream>
+#include <math.h>
+#include <stdexcept>
+#include <GradientKernel.hpp>
+
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Tests for the GradientKernel class
+namespace TestHOGCV
+{
+  /// @brief Google test fixture class to test the fused gradient kernel
+  class GradientKernelTest : public ::testing::Test
+  {
+    protected:
+    /// A small BGR test image
+    cv::Mat image;
+
+    /// @brief Fills a BGR image with a pattern that exercises every channel
+    virtual void SetUp()
+    {
+      image = cv::Mat(7, 11, CV_8UC3);
+      for (int i = 0; i < image.rows; i++)
+      {
+        for (int j = 0; j < image.cols; j++)
+        {
+          image.at<cv::Vec3b>(i,j)[0] = (uchar) ((i*37 + j*11) % 256);
+          image.at<cv::Vec3b>(i,j)[1] = (uchar) ((i*i*5 + j*53) % 256);
+          image.at<cv::Vec3b>(i,j)[2] = (uchar) ((j*j*7 + i*3) % 256);
+        }
+      }
+    }
+
+    /// @brief Reflect 101 border index; a single pixel is its own
+    /// neighbour
+    static int reflect(int i, int len)
+    {
+      if (len == 1)
+        return 0;
+      return (i < 0) ? -i : ((i >= len) ? 2*len - i - 2 : i);
+    }
+
+    /// @brief Compare the fused kernel with a per channel reference
+    /// computation on an image of one or three channels
+    static void expectMatchesReference(const cv::Mat& img)
+    {
+      cv::Mat gradMag;
+      cv::Mat gradOrient;
+      int channels = img.channels();
+
+      GradientKernel::compute(img, gradMag, gradOrient);
+
+      ASSERT_EQ(CV_32F, gradMag.type());
+      ASSERT_EQ(CV_32F, gradOrient.type());
+      ASSERT_EQ(img.rows, gradMag.rows);
+      ASSERT_EQ(img.cols, gradMag.cols);
+
+      for (int i = 0; i < img.rows; i++)
+      {
+        const uchar* cur = img.ptr<uchar>(i);
+        const uchar* prev = img.ptr<uchar>(reflect(i-1, img.rows));
+        const uchar* next = img.ptr<uchar>(reflect(i+1, img.rows));
+        for (int j = 0; j < img.cols; j++)
+        {
+          float bestMag = -1;
+          float bestOrient = 0;
+          for (int c = 0; c < channels; c++)
+          {
+            float dx = (int) cur[reflect(j+1, img.cols)*channels + c] - (int) cur[reflect(j-1, img.cols)*channels + c];
+            float dy = (int) next[j*channels + c] - (int) prev[j*channels + c];
+            float mag = sqrt(dx*dx + dy*dy);
+            if (mag > bestMag)
+            {
+              bestMag = mag;
+              bestOrient = atan2(dy, dx) * 180.0 / CV_PI;
+              if (bestOrient < 0)
+                bestOrient += 180.0;
+            }
+          }
+
+          EXPECT_FLOAT_EQ(bestMag, gradMag.at<float>(i,j));
+
+          // orientations near 0 and 180 degrees describe the same direction
+          float diff = fabs(bestOrient - gradOrient.at<float>(i,j));
+          if (diff > 90.0)
+            diff = 180.0 - diff;
+          EXPECT_NEAR(0.0, diff, 0.5);
+          EXPECT_GE(gradOrient.at<float>(i,j), 0.0);
+          EXPECT_LE(gradOrient.at<float>(i,j), 180.0);
+        }
+      }
+    }
+  };
+
+/// @brief Compare the fused kernel with a per channel reference computation
+TEST_F(GradientKernelTest, testComputeMatchesReference)
+{
+  expectMatchesReference(image);
+}
+
+/// @brief Rows wide enough for several vectorized steps and a remainder
+/// give the reference gradients, including the strongest possible ones
+TEST_F(GradientKernelTest, testComputeWideRowsMatchReference)
+{
+  for (int channels = 1; channels <= 3; channels += 2)
+  {
+    for (int cols = 1; cols <= 45; cols += 11)
+    {
+      cv::Mat wide(5, cols, (channels == 1) ? CV_8UC1 : CV_8UC3);
+      unsigned int state = cols;
+      for (int i = 0; i < wide.rows; i++)
+      {
+        uchar* row = wide.ptr<uchar>(i);
+        for (int k = 0; k < cols*channels; k++)
+        {
+          state = state * 1103515245 + 12345;
+          // every fourth value is black or white, for derivatives of 255
+          // and -255
+          row[k] = (k % 4 == 0) ? (uchar) ((state >> 30) ? 255 : 0) : (uchar) (state >> 24);
+        }
+      }
+      SCOPED_TRACE(cols);
+      expectMatchesReference(wide);
+    }
+  }
+}
+
+/// @brief The derivatives are 0 along the border for a horizontal ramp
+TEST_F(GradientKernelTest, testComputeBorderIsReflected)
+{
+  cv::Mat ramp(3, 9, CV_8UC1);
+  cv::Mat gradMag;
+  cv::Mat gradOrient;
+
+  for (int i = 0; i < ramp.rows; i++)
+    for (int j = 0; j < ramp.cols; j++)
+      ramp.at<uchar>(i,j) = (uchar) (10*j);
+
+  GradientKernel::compute(ramp, gradMag, gradOrient);
+
+  for (int i = 0; i < ramp.rows; i++)
+  {
+    EXPECT_EQ(0.0, gradMag.at<float>(i,0));
+    EXPECT_EQ(0.0, gradMag.at<float>(i,ramp.cols-1));
+    for (int j = 1; j < ramp.cols-1; j++)
+    {
+      EXPECT_FLOAT_EQ(20.0, gradMag.at<float>(i,j));
+      EXPECT_NEAR(0.0, gradOrient.at<float>(i,j), 0.01);
+    }
+  }
+}
+
+/// @brief The orientation bins agree with binning the reference angles
+TEST_F(GradientKernelTest, testComputeBinnedMatchesAngles)
+{
+  cv::Mat gradMag;
+  cv::Mat gradOrient;
+  cv::Mat binMag;
+  cv::Mat gradBin;
+  int nbins = 9;
+
+  GradientKernel::compute(image, gradMag, gradOrient);
+  GradientKernel::computeBinned(image, binMag, gradBin, nbins);
+
+  ASSERT_EQ(CV_8U, gradBin.type());
+
+  for (int i = 0; i < image.rows; i++)
+  {
+    for (int j = 0; j < image.cols; j++)
+    {
+      EXPECT_FLOAT_EQ(gradMag.at<float>(i,j), binMag.at<float>(i,j));
+      ASSERT_LT(gradBin.at<uchar>(i,j), nbins);
+
+      if (gradMag.at<float>(i,j) == 0)
+      {
+        EXPECT_EQ(0, gradBin.at<uchar>(i,j));
+        continue;
+      }
+
+      // skip angles within the accuracy of the approximated orientation
+      float position = gradOrient.at<float>(i,j) * nbins / 180.0;
+      float distance = fabs(position - floor(position + 0.5));
+      if (distance * 180.0 / nbins < 0.5)
+        continue;
+
+      EXPECT_EQ(((int) position) % nbins, gradBin.at<uchar>(i,j));
+    }
+  }
+}
+
+/// @brief Gradients along the axes fall into the expected bins
+TEST_F(GradientKernelTest, testComputeBinnedAxes)
+{
+  cv::Mat horizontal(3, 5, CV_8UC1);
+  cv::Mat vertical(5, 3, CV_8UC1);
+  cv::Mat gradMag;
+  cv::Mat gradBin;
+
+  for (int i = 0; i < horizontal.rows; i++)
+    for (int j = 0; j < horizontal.cols; j++)
+      horizontal.at<uchar>(i,j) = (uchar) (200 - 40*j);
+
+  for (int i = 0; i < vertical.rows; i++)
+    for (int j = 0; j < vertical.cols; j++)
+      vertical.at<uchar>(i,j) = (uchar) (40*i);
+
+  // a gradient pointing along the negative x axis is the same unsigned
+  // orientation as one along the positive x axis
+  GradientKernel::computeBinned(horizontal, gradMag, gradBin, 9);
+  EXPECT_EQ(0, gradBin.at<uchar>(1,2));
+
+  GradientKernel::computeBinned(vertical, gradMag, gradBin, 9);
+  EXPECT_EQ(4, gradBin.at<uchar>(2,1));
+
+  GradientKernel::computeBinned(vertical, gradMag, gradBin, 4);
+  EXPECT_EQ(2, gradBin.at<uchar>(2,1));
+}
+
+/// @brief Unsupported image types are rejected
+TEST_F(GradientKernelTest, testComputeWithInvalidImage)
+{
+  cv::Mat gradMag;
+  cv::Mat gradOrient;
+  cv::Mat empty;
+  cv::Mat floatImage(4, 4, CV_32F);
+
+  EXPECT_THROW(GradientKernel::compute(empty, gradMag, gradOrient), std::invalid_argument);
+  EXPECT_THROW(GradientKernel::compute(floatImage, gradMag, gradOrient), std::invalid_argument);
+  EXPECT_THROW(GradientKernel::computeBinned(empty, gradMag, gradOrient, 9), std::invalid_argument);
+  EXPECT_THROW(GradientKernel::computeBinned(image, gradMag, gradOrient, 0), std::invalid_argument);
+  EXPECT_THROW(GradientKernel::computeBinned(image, gradMag, gradOrient, 256), std::invalid_argument);
+}
+}
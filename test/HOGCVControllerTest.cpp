@@ -2,6 +2,7 @@
 #include <HOGCVController.hpp>
 #include <svm.h>
 #include <stdexcept>
+#include <stdio.h>
 
 #include <gtest/gtest.h>
 
@@ -214,4 +215,191 @@ TEST_F(HOGCVControllerTest, testClassifyFunctionWithInvalidLabel)
 
   EXPECT_THROW(controllerInst->classify(fileNames,labels2,percentageCorrect,predictedLabels),std::invalid_argument);
 }
+
+/// @brief Test building the integral histograms of an image
+TEST_F(HOGCVControllerTest, testBuildIntegralHistogram)
+{
+  IntegralHistogram integral;
+  cv::Mat image = cv::imread(person_bike_bmp.c_str());
+  float whole[9];
+  float quarter[9];
+  float sum[9] = {0};
+
+  ASSERT_NO_THROW(controllerInst->buildIntegralHistogram(image, integral));
+  ASSERT_EQ(image.rows, integral.rows());
+  ASSERT_EQ(image.cols, integral.cols());
+
+  // the histogram of a region is the sum of the histograms of its quarters
+  integral.histogram(cv::Rect(16, 8, 64, 32), whole);
+  for (int i = 0; i < 2; i++)
+  {
+    for (int j = 0; j < 2; j++)
+    {
+      integral.histogram(cv::Rect(16 + 32*j, 8 + 16*i, 32, 16), quarter);
+      for (int b = 0; b < integral.bins(); b++)
+        sum[b] += quarter[b];
+    }
+  }
+  for (int b = 0; b < integral.bins(); b++)
+    EXPECT_NEAR(whole[b], sum[b], 1e-2);
+}
+
+/// @brief Test building the integral histograms of an empty image
+TEST_F(HOGCVControllerTest, testBuildIntegralHistogramWithEmptyImage)
+{
+  IntegralHistogram integral;
+  cv::Mat image;
+
+  EXPECT_THROW(controllerInst->buildIntegralHistogram(image, integral),std::invalid_argument);
+}
+
+/// @brief Test that an unreadable file in a training set keeps the 
+/// previous model
+TEST_F(HOGCVControllerTest, testTrainFunctionWithUnreadableFileKeepsModel)
+{
+  float percentageCorrect;
+  std::vector<int> predictedLabels;
+  std::vector<std::string> fileNames;     
+  std::vector<std::string> fileNames2;     
+  std::vector<int> labels;
+
+  svm_set_print_string_function(localPrintFunc);
+
+  fileNames.push_back(person_bike_bmp.c_str());
+  fileNames.push_back(person_bike_bmp.c_str());
+  labels.push_back(HOGCVController::PERSON_IN_IMAGE);
+  labels.push_back(HOGCVController::NO_PERSON_IN_IMAGE);
+  controllerInst->train(fileNames, labels);
+
+  fileNames2.push_back(person_bike_bmp.c_str());
+  fileNames2.push_back("");
+  EXPECT_THROW(controllerInst->train(fileNames2,labels),std::invalid_argument);
+
+  EXPECT_NO_THROW(controllerInst->classify(fileNames,labels,percentageCorrect,predictedLabels));
+  EXPECT_EQ(fileNames.size(),predictedLabels.size());
+}
+
+/// @brief Test the classify method with an unreadable file and a trained 
+/// model
+TEST_F(HOGCVControllerTest, testClassifyFunctionWithUnreadableFile)
+{
+  float percentageCorrect;
+  std::vector<int> predictedLabels;
+  std::vector<std::string> fileNames;     
+  std::vector<std::string> fileNames2;     
+  std::vector<int> labels;
+
+  svm_set_print_string_function(localPrintFunc);
+
+  fileNames.push_back(person_bike_bmp.c_str());
+  fileNames.push_back(person_bike_bmp.c_str());
+  labels.push_back(HOGCVController::PERSON_IN_IMAGE);
+  labels.push_back(HOGCVController::NO_PERSON_IN_IMAGE);
+  controllerInst->train(fileNames, labels);
+
+  fileNames2.push_back("");
+  fileNames2.push_back(person_bike_bmp.c_str());
+  EXPECT_THROW(controllerInst->classify(fileNames2,labels,percentageCorrect,predictedLabels),std::invalid_argument);
+}
+
+/// @brief Test that training and classifying from a descriptor cache
+/// gives the same predictions as extracting the images
+TEST_F(HOGCVControllerTest, testClassifyFunctionWithDescriptorCache)
+{
+  float percentageCorrect;
+  std::vector<int> predictedLabels;
+  std::vector<int> cachedLabels;
+  std::vector<std::string> fileNames;     
+  std::vector<int> labels;
+  const char* cacheFile = "controller_test.hogcache";
+
+  svm_set_print_string_function(localPrintFunc);
+  remove(cacheFile);
+
+  fileNames.push_back(person_bike_bmp.c_str());
+  fileNames.push_back(person_bike_bmp.c_str());
+  labels.push_back(HOGCVController::PERSON_IN_IMAGE);
+  labels.push_back(HOGCVController::NO_PERSON_IN_IMAGE);
+
+  // the first pass fills the cache, the second one reads from it
+  ASSERT_NO_THROW(controllerInst->setDescriptorCache(cacheFile));
+  controllerInst->train(fileNames, labels);
+  EXPECT_NO_THROW(controllerInst->classify(fileNames,labels,percentageCorrect,predictedLabels));
+
+  ASSERT_NO_THROW(controllerInst->setDescriptorCache(cacheFile));
+  controllerInst->train(fileNames, labels);
+  EXPECT_NO_THROW(controllerInst->classify(fileNames,labels,percentageCorrect,cachedLabels));
+  EXPECT_EQ(predictedLabels, cachedLabels);
+
+  // unreadable files are still reported
+  fileNames[1] = "";
+  EXPECT_THROW(controllerInst->train(fileNames,labels),std::invalid_argument);
+
+  EXPECT_NO_THROW(controllerInst->setDescriptorCache(""));
+  remove(cacheFile);
+}
+
+/// @brief Test predicting several images at once from their descriptors
+TEST_F(HOGCVControllerTest, testPredictBatchFunction)
+{
+  std::vector<std::string> fileNames;     
+  std::vector<int> labels;
+  std::vector<std::vector<float> > descriptors(3, std::vector<float>(100, 0.0f));
+  std::vector<int> predictedLabels;
+
+  svm_set_print_string_function(localPrintFunc);
+
+  controllerInst->freeModelContent();
+  EXPECT_THROW(controllerInst->predictBatch(descriptors,predictedLabels),std::logic_error);
+
+  fileNames.push_back(person_bike_bmp.c_str());
+  fileNames.push_back(person_bike_bmp.c_str());
+  labels.push_back(HOGCVController::PERSON_IN_IMAGE);
+  labels.push_back(HOGCVController::NO_PERSON_IN_IMAGE);
+  controllerInst->train(fileNames, labels);
+
+  descriptors[1][10] = 0.5f;
+  descriptors[2][20] = 0.25f;
+  EXPECT_NO_THROW(controllerInst->predictBatch(descriptors,predictedLabels));
+  ASSERT_EQ(descriptors.size(),predictedLabels.size());
+  for (unsigned int i = 0; i < predictedLabels.size(); i++)
+  {
+    EXPECT_TRUE((predictedLabels[i] == HOGCVController::PERSON_IN_IMAGE) ||
+                (predictedLabels[i] == HOGCVController::NO_PERSON_IN_IMAGE));
+  }
+}
+
+/// @brief Test searching a grid of parameters and training the best model
+TEST_F(HOGCVControllerTest, testGridSearchFunction)
+{
+  std::vector<std::string> fileNames;     
+  std::vector<int> labels;
+  std::vector<double> cValues, noValues, scores;
+  std::vector<std::vector<float> > descriptors(2, std::vector<float>(100, 0.0f));
+  std::vector<int> predictedLabels;
+
+  svm_set_print_string_function(localPrintFunc);
+
+  for (int i = 0; i < 4; i++)
+  {
+    fileNames.push_back(person_bike_bmp.c_str());
+    labels.push_back((i % 2) ? HOGCVController::NO_PERSON_IN_IMAGE : HOGCVController::PERSON_IN_IMAGE);
+  }
+  cValues.push_back(1);
+  cValues.push_back(10);
+
+  EXPECT_THROW(controllerInst->gridSearch(fileNames,labels,cValues,noValues,noValues,1,scores),std::invalid_argument);
+
+  EXPECT_NO_THROW(controllerInst->gridSearch(fileNames,labels,cValues,noValues,noValues,2,scores));
+  ASSERT_EQ(cValues.size(),scores.size());
+  for (unsigned int i = 0; i < scores.size(); i++)
+  {
+    EXPECT_GE(scores[i],0.0);
+    EXPECT_LE(scores[i],1.0);
+  }
+  EXPECT_NO_THROW(controllerInst->predictBatch(descriptors,predictedLabels));
+
+  std::vector<double> nuValues(1, 2.0);
+  EXPECT_THROW(controllerInst->gridSearch(fileNames,labels,cValues,noValues,nuValues,2,scores),std::logic_error);
+}
 }
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <math.h>
+#include <stdexcept>
+#include <IntegralHistogram.hpp>
+
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Tests for the IntegralHistogram class
+namespace TestHOGCV
+{
+  /// @brief Google test fixture class to test integral orientation histograms
+  class IntegralHistogramTest : public ::testing::Test
+  {
+    protected:
+    /// Gradient magnitudes
+    cv::Mat gradMag;
+
+    /// Gradient orientation bins
+    cv::Mat gradBin;
+
+    /// The number of orientation bins
+    static const int NBINS = 9;
+
+    /// @brief Fills the gradient planes with a pattern that hits every bin
+    virtual void SetUp()
+    {
+      gradMag = cv::Mat(13, 17, CV_32F);
+      gradBin = cv::Mat(13, 17, CV_8U);
+      for (int i = 0; i < gradMag.rows; i++)
+      {
+        for (int j = 0; j < gradMag.cols; j++)
+        {
+          gradMag.at<float>(i,j) = (float) ((i*13 + j*7) % 19) * 0.5f;
+          gradBin.at<uchar>(i,j) = (uchar) ((i*2 + j*3) % NBINS);
+        }
+      }
+    }
+
+    /// @brief Reference histogram of a rectangle by walking its pixels
+    void sumRegion(const cv::Mat& bins, const cv::Rect& region, float* histogram)
+    {
+      for (int b = 0; b < NBINS; b++)
+        histogram[b] = 0.0;
+
+      for (int i = region.y; i < region.y + region.height; i++)
+        for (int j = region.x; j < region.x + region.width; j++)
+          histogram[bins.at<uchar>(i,j)] += gradMag.at<float>(i,j);
+    }
+  };
+
+  const int IntegralHistogramTest::NBINS;
+
+/// @brief Every rectangle matches the sum over its pixels
+TEST_F(IntegralHistogramTest, testHistogramMatchesSums)
+{
+  IntegralHistogram integral;
+  integral.compute(gradMag, gradBin, NBINS);
+
+  ASSERT_EQ(gradMag.rows, integral.rows());
+  ASSERT_EQ(gradMag.cols, integral.cols());
+  ASSERT_EQ(NBINS, integral.bins());
+
+  for (int y = 0; y < gradMag.rows; y += 3)
+  {
+    for (int x = 0; x < gradMag.cols; x += 2)
+    {
+      for (int h = 0; y + h <= gradMag.rows; h += 4)
+      {
+        for (int w = 0; x + w <= gradMag.cols; w += 5)
+        {
+          float expected[NBINS];
+          float actual[NBINS];
+          cv::Rect region(x, y, w, h);
+
+          sumRegion(gradBin, region, expected);
+          integral.histogram(region, actual);
+          for (int b = 0; b < NBINS; b++)
+            EXPECT_NEAR(expected[b], actual[b], 1e-3);
+        }
+      }
+    }
+  }
+}
+
+/// @brief Orientations in degrees are binned into the containing bin
+TEST_F(IntegralHistogramTest, testHistogramWithDegrees)
+{
+  IntegralHistogram integral;
+  cv::Mat degrees(gradBin.rows, gradBin.cols, CV_32F);
+
+  for (int i = 0; i < gradBin.rows; i++)
+    for (int j = 0; j < gradBin.cols; j++)
+      degrees.at<float>(i,j) = (gradBin.at<uchar>(i,j) + 0.5f) * 180.0f / NBINS;
+
+  integral.compute(gradMag, degrees, NBINS);
+
+  float expected[NBINS];
+  float actual[NBINS];
+  cv::Rect region(3, 2, 11, 9);
+  sumRegion(gradBin, region, expected);
+  integral.histogram(region, actual);
+  for (int b = 0; b < NBINS; b++)
+    EXPECT_NEAR(expected[b], actual[b], 1e-3);
+}
+
+/// @brief Regions outside the image are rejected
+TEST_F(IntegralHistogramTest, testHistogramWithInvalidRegion)
+{
+  IntegralHistogram integral;
+  float histogram[NBINS];
+
+  integral.compute(gradMag, gradBin, NBINS);
+
+  EXPECT_NO_THROW(integral.histogram(cv::Rect(0, 0, 17, 13), histogram));
+  EXPECT_THROW(integral.histogram(cv::Rect(-1, 0, 2, 2), histogram), std::invalid_argument);
+  EXPECT_THROW(integral.histogram(cv::Rect(0, -1, 2, 2), histogram), std::invalid_argument);
+  EXPECT_THROW(integral.histogram(cv::Rect(10, 0, 8, 2), histogram), std::invalid_argument);
+  EXPECT_THROW(integral.histogram(cv::Rect(0, 10, 2, 4), histogram), std::invalid_argument);
+}
+
+/// @brief Invalid gradient planes and parameters are rejected
+TEST_F(IntegralHistogramTest, testComputeWithInvalidArguments)
+{
+  IntegralHistogram integral;
+  cv::Mat smaller(3, 3, CV_8U);
+  cv::Mat doubles(13, 17, CV_64F);
+
+  EXPECT_THROW(integral.compute(gradMag, smaller, NBINS), std::invalid_argument);
+  EXPECT_THROW(integral.compute(doubles, gradBin, NBINS), std::invalid_argument);
+  EXPECT_THROW(integral.compute(gradMag, doubles, NBINS), std::invalid_argument);
+  EXPECT_THROW(integral.compute(gradMag, gradBin, 0), std::invalid_argument);
+  EXPECT_THROW(integral.compute(gradMag, gradBin, 256), std::invalid_argument);
+}
+}
@@ -42,6 +42,12 @@ TEST_F(ParametersTest, testDefaultParameterValues)
   EXPECT_EQ(0,paramInst->getP());
   EXPECT_EQ(0,paramInst->getShrinking());
   EXPECT_EQ(0,paramInst->getProbability());
+  EXPECT_LE(1,paramInst->getNumThreads());
+  EXPECT_EQ(2,paramInst->getDecodeThreads());
+  EXPECT_EQ(1,paramInst->getPredictThreads());
+  EXPECT_EQ(16,paramInst->getQueueCapacity());
+  EXPECT_TRUE(paramInst->getDenseFeatures());
+  EXPECT_EQ(200,paramInst->getCvCacheSize());
 }
 
 /// @brief Test that the setter and getter methods function properly
@@ -85,5 +91,35 @@ TEST_F(ParametersTest, testSetters)
 
   paramInst->setProbability(1);
   EXPECT_EQ(1,paramInst->getProbability());
+
+  paramInst->setNumThreads(0);
+  EXPECT_EQ(1,paramInst->getNumThreads());
+
+  paramInst->setNumThreads(4);
+  EXPECT_EQ(4,paramInst->getNumThreads());
+
+  paramInst->setDecodeThreads(0);
+  EXPECT_EQ(1,paramInst->getDecodeThreads());
+
+  paramInst->setPredictThreads(3);
+  EXPECT_EQ(3,paramInst->getPredictThreads());
+
+  paramInst->setQueueCapacity(0);
+  EXPECT_EQ(1,paramInst->getQueueCapacity());
+
+  paramInst->setQueueCapacity(2);
+  EXPECT_EQ(2,paramInst->getQueueCapacity());
+
+  paramInst->setDenseFeatures(false);
+  EXPECT_FALSE(paramInst->getDenseFeatures());
+
+  paramInst->setDenseFeatures(true);
+  EXPECT_TRUE(paramInst->getDenseFeatures());
+
+  paramInst->setCvCacheSize(-1);
+  EXPECT_EQ(0,paramInst->getCvCacheSize());
+
+  paramInst->setCvCacheSize(50);
+  EXPECT_EQ(50,paramInst->getCvCacheSize());
 }
 }
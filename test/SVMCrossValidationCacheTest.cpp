@@ -0,0 +1,196 @@
+#include <iostream>
+#include <vector>
+#include <pthread.h>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the kernel shared by the folds of cross validation
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing cross validation with the
+  /// folds reading one shared kernel
+  class SVMCrossValidationCacheTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points
+    static const int NUM_POINTS = 300;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 3;
+
+    /// Number of classes
+    static const int NUM_CLASSES = 3;
+
+    /// Number of ways to fold the sample data
+    static const int NUM_FOLDS = 5;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds overlapping classes of points
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(2323);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        int label = i % NUM_CLASSES;
+        labels.push_back(label);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + ((label == k) ? 0.3 : 0.0);
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.nu = 0.2;
+    }
+
+    /// @brief Free the allocated memory and go back to one thread without
+    /// a shared kernel
+    virtual void TearDown()
+    {
+      svm_set_cv_cache_size(0);
+      svm_set_num_threads(1);
+      freeRows(problem);
+    }
+
+    /// @brief Expect the folds reading a shared kernel of the given size to
+    /// give exactly the targets of folds computing their own
+    void expectSameTargetsWithCache(double cacheSize)
+    {
+      std::vector<double> own(NUM_POINTS), shared(NUM_POINTS);
+
+      svm_set_cv_cache_size(0);
+      svm_cross_validation_seeded(&problem, &param, NUM_FOLDS, &own[0], 5);
+      svm_set_cv_cache_size(cacheSize);
+      svm_cross_validation_seeded(&problem, &param, NUM_FOLDS, &shared[0], 5);
+
+      expectSameTargets(own, shared);
+    }
+  };
+
+  /// @brief A cross validation run on a thread of its own
+  struct CrossValidationCall
+  {
+    /// The problem cross validated
+    const svm_problem* problem;
+
+    /// The parameters trained with
+    const svm_parameter* param;
+
+    /// Receives the target of every data point
+    double* targets;
+  };
+
+  /// @brief Thread function running the CrossValidationCall it is given
+  static void* crossValidateOnThread(void* context)
+  {
+    CrossValidationCall* call = static_cast<CrossValidationCall*>(context);
+    svm_cross_validation_seeded(call->problem, call->param, 5, call->targets, 5);
+    return NULL;
+  }
+
+  const int SVMCrossValidationCacheTest::NUM_POINTS;
+  const int SVMCrossValidationCacheTest::NUM_FEATURES;
+  const int SVMCrossValidationCacheTest::NUM_CLASSES;
+  const int SVMCrossValidationCacheTest::NUM_FOLDS;
+
+/// @brief Test setting the size of the shared kernel
+TEST_F(SVMCrossValidationCacheTest, testSetCacheSize)
+{
+  EXPECT_EQ(0, svm_get_cv_cache_size());
+  svm_set_cv_cache_size(20);
+  EXPECT_EQ(20, svm_get_cv_cache_size());
+  svm_set_cv_cache_size(-1);
+  EXPECT_EQ(0, svm_get_cv_cache_size());
+}
+
+/// @brief Test the one-vs-one problems of the folds
+TEST_F(SVMCrossValidationCacheTest, testClassification)
+{
+  expectSameTargetsWithCache(100);
+}
+
+/// @brief Test a shared kernel too small for every column
+TEST_F(SVMCrossValidationCacheTest, testSmallCache)
+{
+  expectSameTargetsWithCache(0.05);
+}
+
+/// @brief Test the folds on several threads
+TEST_F(SVMCrossValidationCacheTest, testThreads)
+{
+  svm_set_num_threads(4);
+  expectSameTargetsWithCache(100);
+  expectSameTargetsWithCache(0.05);
+}
+
+/// @brief Test the probability folds within the folds, which read the
+/// shared kernel as well
+TEST_F(SVMCrossValidationCacheTest, testProbability)
+{
+  param.probability = 1;
+  svm_set_num_threads(4);
+  expectSameTargetsWithCache(100);
+}
+
+/// @brief Test the kernels of one class SVM and of SVR with its own
+/// cross validation nested in the folds
+TEST_F(SVMCrossValidationCacheTest, testOneClassAndRegression)
+{
+  param.svm_type = ONE_CLASS;
+  expectSameTargetsWithCache(100);
+
+  param.svm_type = EPSILON_SVR;
+  param.probability = 1;
+  expectSameTargetsWithCache(100);
+}
+
+/// @brief Test the other kernel types
+TEST_F(SVMCrossValidationCacheTest, testKernelTypes)
+{
+  param.kernel_type = LINEAR;
+  expectSameTargetsWithCache(100);
+  param.kernel_type = POLY;
+  expectSameTargetsWithCache(100);
+  param.kernel_type = SIGMOID;
+  expectSameTargetsWithCache(100);
+}
+
+/// @brief Test svm_train on the rows of a cross validation running on
+/// another thread, which must not read the store of the folds
+TEST_F(SVMCrossValidationCacheTest, testConcurrentTraining)
+{
+  std::vector<double> own(NUM_POINTS), shared(NUM_POINTS);
+  svm_cross_validation_seeded(&problem, &param, NUM_FOLDS, &own[0], 5);
+  svm_model* serial = svm_train(&problem, &param);
+
+  svm_set_cv_cache_size(100);
+  CrossValidationCall call;
+  call.problem = &problem;
+  call.param = &param;
+  call.targets = &shared[0];
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, &crossValidateOnThread, &call));
+  for (int k = 0; k < 4; k++)
+  {
+    svm_model* model = svm_train(&problem, &param);
+    expectSameModel(serial, model);
+    svm_free_and_destroy_model(&model);
+  }
+  pthread_join(thread, NULL);
+
+  expectSameTargets(own, shared);
+  svm_free_and_destroy_model(&serial);
+}
+}
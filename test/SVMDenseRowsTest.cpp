@@ -0,0 +1,192 @@
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for dense rows in the svm library
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing dense rows
+  class SVMDenseRowsTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points to train the model with
+    static const int NUM_POINTS = 40;
+
+    /// Number of features of each data point, not a multiple of the
+    /// vector width so the remainder loops are covered
+    static const int NUM_FEATURES = 13;
+
+    /// The features of every data point
+    std::vector<float> features;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points as sparse rows
+    svm_problem sparse;
+
+    /// The data points as dense rows
+    svm_problem dense;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds two classes of points, with a few zero features,
+    /// stored both as sparse and as dense rows
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(12345);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        labels.push_back((i % 2) ? 1 : -1);
+        for (int k = 0; k < NUM_FEATURES; k++)
+        {
+          float value = random.uniform();
+          if (k % 5 == 2)
+            value = 0;
+          else if (i % 2)
+            value += 0.3f;
+          features.push_back(value);
+        }
+      }
+
+      sparse.l = NUM_POINTS;
+      sparse.y = &labels[0];
+      sparse.x = new svm_node*[NUM_POINTS];
+      dense.l = NUM_POINTS;
+      dense.y = &labels[0];
+      dense.x = new svm_node*[NUM_POINTS];
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        sparse.x[i] = sparseRow(&features[i*NUM_FEATURES], NUM_FEATURES);
+        dense.x[i] = denseRow(&features[i*NUM_FEATURES], NUM_FEATURES);
+      }
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.coef0 = 1;
+    }
+
+    /// @brief Free the allocated memory
+    virtual void TearDown()
+    {
+      freeRows(sparse);
+      freeRows(dense);
+    }
+
+    /// @brief Expect a model trained on dense rows to match one trained on
+    /// sparse rows, predicting from either kind of row
+    void expectSameModel(int kernelType)
+    {
+      param.kernel_type = kernelType;
+      ASSERT_TRUE(svm_check_parameter(&dense, &param) == NULL);
+
+      svm_model* sparseModel = svm_train(&sparse, &param);
+      svm_model* denseModel = svm_train(&dense, &param);
+
+      EXPECT_EQ(sparseModel->l, denseModel->l);
+      EXPECT_NEAR(sparseModel->rho[0], denseModel->rho[0], 1e-6);
+
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        double expected, fromDense, fromSparse;
+        svm_predict_values(sparseModel, sparse.x[i], &expected);
+        svm_predict_values(denseModel, dense.x[i], &fromDense);
+        svm_predict_values(denseModel, sparse.x[i], &fromSparse);
+        EXPECT_NEAR(expected, fromDense, 1e-6);
+        EXPECT_NEAR(expected, fromSparse, 1e-6);
+        EXPECT_EQ(svm_predict(sparseModel, sparse.x[i]), svm_predict(denseModel, dense.x[i]));
+      }
+
+      svm_free_and_destroy_model(&sparseModel);
+      svm_free_and_destroy_model(&denseModel);
+    }
+  };
+
+  const int SVMDenseRowsTest::NUM_POINTS;
+  const int SVMDenseRowsTest::NUM_FEATURES;
+
+/// @brief A dense row holds its values behind a header
+TEST_F(SVMDenseRowsTest, testDenseRowLayout)
+{
+  EXPECT_EQ(1, svm_is_dense_row(dense.x[0]));
+  EXPECT_EQ(0, svm_is_dense_row(sparse.x[0]));
+  EXPECT_EQ(NUM_FEATURES, svm_dense_row_dim(dense.x[0]));
+  EXPECT_EQ(0, svm_dense_row_dim(sparse.x[0]));
+  EXPECT_TRUE(svm_dense_row_values(sparse.x[0]) == NULL);
+
+  const float* values = svm_dense_row_values(dense.x[3]);
+  for (int k = 0; k < NUM_FEATURES; k++)
+    EXPECT_EQ(features[3*NUM_FEATURES+k], values[k]);
+
+  // the row is terminated like a sparse row
+  EXPECT_EQ(-1, dense.x[0][svm_dense_row_nodes(NUM_FEATURES)-1].index);
+}
+
+/// @brief Dense rows train the same models as sparse rows
+TEST_F(SVMDenseRowsTest, testDenseAndSparseModelsMatch)
+{
+  expectSameModel(LINEAR);
+  expectSameModel(POLY);
+  expectSameModel(RBF);
+  expectSameModel(SIGMOID);
+}
+
+/// @brief Rows of different lengths behave as if padded with zeros
+TEST_F(SVMDenseRowsTest, testDifferentDimensions)
+{
+  svm_node* shortRow = new svm_node[svm_dense_row_nodes(5)];
+  svm_fill_dense_row(shortRow, &features[0], 5);
+
+  svm_node padded[6];
+  int n = 0;
+  for (int k = 0; k < 5; k++)
+  {
+    if (features[k] != 0)
+    {
+      padded[n].index = k;
+      padded[n].value = features[k];
+      n++;
+    }
+  }
+  padded[n].index = -1;
+
+  svm_model* model = svm_train(&dense, &param);
+  double fromDense, fromSparse;
+  svm_predict_values(model, shortRow, &fromDense);
+  svm_predict_values(model, padded, &fromSparse);
+  EXPECT_NEAR(fromSparse, fromDense, 1e-9);
+
+  svm_free_and_destroy_model(&model);
+  delete [] shortRow;
+}
+
+/// @brief A model trained on dense rows is saved as sparse rows
+TEST_F(SVMDenseRowsTest, testSaveAndLoadDenseModel)
+{
+  const char* modelFile = "dense_rows_test.model";
+  svm_model* model = svm_train(&dense, &param);
+  ASSERT_EQ(0, svm_save_model(modelFile, model));
+
+  svm_model* loaded = svm_load_model(modelFile);
+  ASSERT_TRUE(loaded != NULL);
+  EXPECT_EQ(0, svm_is_dense_row(loaded->SV[0]));
+
+  for (int i = 0; i < NUM_POINTS; i++)
+  {
+    double expected, actual;
+    svm_predict_values(model, dense.x[i], &expected);
+    svm_predict_values(loaded, dense.x[i], &actual);
+    EXPECT_NEAR(expected, actual, 1e-6);
+  }
+
+  svm_free_and_destroy_model(&model);
+  svm_free_and_destroy_model(&loaded);
+  remove(modelFile);
+}
+}
@@ -0,0 +1,309 @@
+#include <iostream>
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+#include <svm.h>
+#include <SVMThreadPool.hpp>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the svm_grid_search and svm_check_grid functions
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing the grid search of the svm
+  /// library
+  class SVMGridSearchTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points
+    static const int NUM_POINTS = 200;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 3;
+
+    /// Number of ways to fold the sample data
+    static const int NUM_FOLDS = 4;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// The values of C tried, in no particular order
+    std::vector<double> cValues;
+
+    /// The values of gamma tried
+    std::vector<double> gammaValues;
+
+    /// The grid of C and gamma values
+    svm_grid grid;
+
+    /// @brief Builds two overlapping classes of points and a grid of 3
+    /// values of C and 2 values of gamma
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(3131);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        int label = (i % 2) ? 1 : -1;
+        labels.push_back(label);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + ((label > 0 && k == 0) ? 0.4 : 0.0);
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.nu = 0.3;
+
+      cValues.push_back(10);
+      cValues.push_back(0.1);
+      cValues.push_back(1);
+      gammaValues.push_back(0.5);
+      gammaValues.push_back(2);
+
+      grid.nr_C = cValues.size();
+      grid.C = &cValues[0];
+      grid.nr_gamma = gammaValues.size();
+      grid.gamma = &gammaValues[0];
+      grid.nr_nu = 0;
+      grid.nu = NULL;
+    }
+
+    /// @brief Free the allocated memory and go back to one thread
+    virtual void TearDown()
+    {
+      svm_set_cv_cache_size(0);
+      svm_set_num_threads(1);
+      freeRows(problem);
+    }
+
+    /// @brief Returns the accuracy, or the mean squared error of regression,
+    /// of svm_cross_validation for one point of the grid, on the folds drawn
+    /// after srand(seed), or from seed itself if seeded
+    double crossValidationScore(double C, double gamma, unsigned int seed, bool seeded = false)
+    {
+      std::vector<double> targets(NUM_POINTS);
+      svm_parameter point = param;
+      point.C = C;
+      point.gamma = gamma;
+
+      if (seeded)
+      {
+        svm_cross_validation_seeded(&problem, &point, NUM_FOLDS, &targets[0], seed);
+      }
+      else
+      {
+        srand(seed);
+        svm_cross_validation(&problem, &point, NUM_FOLDS, &targets[0]);
+      }
+
+      double score = 0;
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        if (param.svm_type == EPSILON_SVR)
+          score += (targets[i] - labels[i]) * (targets[i] - labels[i]);
+        else if (targets[i] == labels[i])
+          score++;
+      }
+      return score / NUM_POINTS;
+    }
+
+    /// @brief Expect the scores of the grid to be those of cross validating
+    /// each point on its own, within tolerance, and the model to be trained
+    /// with the best point
+    void expectCrossValidationScores(double tolerance)
+    {
+      std::vector<double> scores(cValues.size() * gammaValues.size());
+
+      srand(9);
+      svm_model* model = svm_grid_search(&problem, &param, &grid, NUM_FOLDS, &scores[0]);
+      ASSERT_TRUE(NULL != model);
+
+      int best = 0;
+      for (unsigned int g = 0; g < gammaValues.size(); g++)
+      {
+        for (unsigned int c = 0; c < cValues.size(); c++)
+        {
+          int point = g * cValues.size() + c;
+          EXPECT_NEAR(crossValidationScore(cValues[c], gammaValues[g], 9), scores[point], tolerance);
+          if ((param.svm_type == EPSILON_SVR) ? scores[point] < scores[best] : scores[point] > scores[best])
+            best = point;
+        }
+      }
+      EXPECT_EQ(cValues[best % cValues.size()], model->param.C);
+      EXPECT_EQ(gammaValues[best / cValues.size()], model->param.gamma);
+
+      svm_free_and_destroy_model(&model);
+    }
+  };
+
+  const int SVMGridSearchTest::NUM_POINTS;
+  const int SVMGridSearchTest::NUM_FEATURES;
+  const int SVMGridSearchTest::NUM_FOLDS;
+
+/// @brief Test checking the grid and each of its points
+TEST_F(SVMGridSearchTest, testCheckGrid)
+{
+  EXPECT_TRUE(NULL == svm_check_grid(&problem, &param, &grid, NUM_FOLDS));
+  EXPECT_TRUE(NULL != svm_check_grid(&problem, &param, &grid, 1));
+
+  grid.nr_gamma = -1;
+  EXPECT_TRUE(NULL != svm_check_grid(&problem, &param, &grid, NUM_FOLDS));
+  grid.nr_gamma = gammaValues.size();
+
+  cValues[1] = -1;
+  EXPECT_TRUE(NULL != svm_check_grid(&problem, &param, &grid, NUM_FOLDS));
+}
+
+/// @brief Test the scores of C-SVC, whose solves start from the solution of
+/// the previous C, against cross validating every point from scratch
+TEST_F(SVMGridSearchTest, testClassification)
+{
+  expectCrossValidationScores(0.02);
+}
+
+/// @brief Test the scores of epsilon-SVR, which are the mean squared errors
+TEST_F(SVMGridSearchTest, testRegression)
+{
+  param.svm_type = EPSILON_SVR;
+  expectCrossValidationScores(1e-9);
+}
+
+/// @brief Test the grid with the folds reading a shared kernel
+TEST_F(SVMGridSearchTest, testSharedKernel)
+{
+  grid.nr_gamma = 1;
+  gammaValues.resize(1);
+  svm_set_cv_cache_size(10);
+  expectCrossValidationScores(0.02);
+}
+
+/// @brief Test that the points and folds searched on several threads give
+/// exactly the scores found on one thread
+TEST_F(SVMGridSearchTest, testThreads)
+{
+  std::vector<double> serial(cValues.size() * gammaValues.size());
+  std::vector<double> parallel(serial.size());
+
+  svm_set_num_threads(1);
+  srand(4);
+  svm_model* serialModel = svm_grid_search(&problem, &param, &grid, NUM_FOLDS, &serial[0]);
+  svm_set_num_threads(4);
+  srand(4);
+  svm_model* parallelModel = svm_grid_search(&problem, &param, &grid, NUM_FOLDS, &parallel[0]);
+
+  for (unsigned int i = 0; i < serial.size(); i++)
+    EXPECT_EQ(serial[i], parallel[i]);
+  EXPECT_EQ(serialModel->param.C, parallelModel->param.C);
+  EXPECT_EQ(serialModel->param.gamma, parallelModel->param.gamma);
+
+  svm_free_and_destroy_model(&serialModel);
+  svm_free_and_destroy_model(&parallelModel);
+}
+
+/// @brief Test that a seeded search draws its folds from the seed alone,
+/// the same folds as cross validating from that seed
+TEST_F(SVMGridSearchTest, testSeededFolds)
+{
+  std::vector<double> first(cValues.size() * gammaValues.size());
+  std::vector<double> second(first.size());
+  param.probability = 1;
+
+  srand(1);
+  svm_model* firstModel = svm_grid_search_seeded(&problem, &param, &grid, NUM_FOLDS, &first[0], 7);
+  srand(2);
+  svm_model* secondModel = svm_grid_search_seeded(&problem, &param, &grid, NUM_FOLDS, &second[0], 7);
+
+  for (unsigned int i = 0; i < first.size(); i++)
+    EXPECT_EQ(first[i], second[i]);
+  expectSameModel(firstModel, secondModel);
+
+  // the points are scored on their labels, as cross validation without
+  // probability estimates does
+  param.probability = 0;
+  for (unsigned int g = 0; g < gammaValues.size(); g++)
+    for (unsigned int c = 0; c < cValues.size(); c++)
+      EXPECT_NEAR(crossValidationScore(cValues[c], gammaValues[g], 7, true), first[g * cValues.size() + c], 0.02);
+
+  svm_free_and_destroy_model(&firstModel);
+  svm_free_and_destroy_model(&secondModel);
+}
+
+/// @brief Test searching on threads of a pool passed by the caller, which
+/// gives the scores found on one thread
+TEST_F(SVMGridSearchTest, testThreadPool)
+{
+  std::vector<double> serial(cValues.size() * gammaValues.size());
+  std::vector<double> lent(serial.size());
+
+  svm_model* serialModel = svm_grid_search_seeded(&problem, &param, &grid, NUM_FOLDS, &serial[0], 4);
+  ThreadPool pool(4);
+  svm_model* lentModel = svm_grid_search_on(&problem, &param, &grid, NUM_FOLDS, &lent[0], 4, 0, &pool, 4);
+  EXPECT_EQ(1, svm_get_num_threads());
+
+  for (unsigned int i = 0; i < serial.size(); i++)
+    EXPECT_EQ(serial[i], lent[i]);
+  expectSameModel(serialModel, lentModel);
+
+  svm_free_and_destroy_model(&serialModel);
+  svm_free_and_destroy_model(&lentModel);
+}
+
+/// @brief Test the folds searched on a pool reading a kernel shared for
+/// the call only, which gives the scores of folds with their own caches
+TEST_F(SVMGridSearchTest, testThreadPoolSharedKernel)
+{
+  grid.nr_gamma = 1;
+  gammaValues.resize(1);
+  std::vector<double> serial(cValues.size());
+  std::vector<double> lent(serial.size());
+
+  svm_model* serialModel = svm_grid_search_seeded(&problem, &param, &grid, NUM_FOLDS, &serial[0], 4);
+  ThreadPool pool(4);
+  svm_model* lentModel = svm_grid_search_on(&problem, &param, &grid, NUM_FOLDS, &lent[0], 4, 10, &pool, 4);
+  EXPECT_EQ(0, svm_get_cv_cache_size());
+
+  for (unsigned int i = 0; i < serial.size(); i++)
+    EXPECT_EQ(serial[i], lent[i]);
+  expectSameModel(serialModel, lentModel);
+
+  svm_free_and_destroy_model(&serialModel);
+  svm_free_and_destroy_model(&lentModel);
+}
+
+/// @brief Test a grid over nu only, keeping C and gamma of the parameters,
+/// with the probability estimates trained for the best model
+TEST_F(SVMGridSearchTest, testNuGridWithProbability)
+{
+  double nuValues[] = { 0.2, 0.4 };
+  double scores[2];
+  param.svm_type = NU_SVC;
+  param.probability = 1;
+  grid.nr_C = 0;
+  grid.nr_gamma = 0;
+  grid.nr_nu = 2;
+  grid.nu = nuValues;
+
+  EXPECT_TRUE(NULL == svm_check_grid(&problem, &param, &grid, NUM_FOLDS));
+  svm_model* model = svm_grid_search(&problem, &param, &grid, NUM_FOLDS, scores);
+
+  EXPECT_EQ((scores[1] > scores[0]) ? nuValues[1] : nuValues[0], model->param.nu);
+  EXPECT_EQ(param.gamma, model->param.gamma);
+  EXPECT_EQ(1, svm_check_probability_model(model));
+  for (int i = 0; i < 2; i++)
+  {
+    EXPECT_GT(scores[i], 0.5);
+    EXPECT_LE(scores[i], 1.0);
+  }
+
+  svm_free_and_destroy_model(&model);
+}
+}
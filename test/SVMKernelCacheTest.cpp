@@ -0,0 +1,131 @@
+#include <iostream>
+#include <vector>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the kernel cache used while training
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing training with caches of any size
+  class SVMKernelCacheTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points
+    static const int NUM_POINTS = 600;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 4;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds two overlapping classes of points
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(2468);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        labels.push_back((i % 2) ? 1 : -1);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + (i % 2) * 0.1;
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.cache_size = 1;
+    }
+
+    /// @brief Free the allocated memory
+    virtual void TearDown()
+    {
+      freeRows(problem);
+    }
+
+    /// @brief Expect training with caches of each size to give exactly the
+    /// model trained with every column cached
+    void expectSameModelWithCacheSizes(const double* cacheSizes, int numSizes)
+    {
+      param.cache_size = 100;
+      svm_model* cached = svm_train(&problem, &param);
+
+      for (int s = 0; s < numSizes; s++)
+      {
+        SCOPED_TRACE(cacheSizes[s]);
+        param.cache_size = cacheSizes[s];
+        svm_model* evicted = svm_train(&problem, &param);
+        expectSameModel(cached, evicted);
+        svm_free_and_destroy_model(&evicted);
+      }
+
+      svm_free_and_destroy_model(&cached);
+    }
+
+    /// @brief Expect training with a cache too small for more than a few
+    /// columns to give exactly the model trained with every column cached
+    void expectSameModelWithSmallCache(int svmType)
+    {
+      param.svm_type = svmType;
+
+      param.cache_size = 100;
+      svm_model* cached = svm_train(&problem, &param);
+      param.cache_size = 0.01;
+      svm_model* evicted = svm_train(&problem, &param);
+
+      expectSameModel(cached, evicted);
+
+      svm_free_and_destroy_model(&cached);
+      svm_free_and_destroy_model(&evicted);
+    }
+  };
+
+  const int SVMKernelCacheTest::NUM_POINTS;
+  const int SVMKernelCacheTest::NUM_FEATURES;
+
+/// @brief Test a classification problem
+TEST_F(SVMKernelCacheTest, testClassification)
+{
+  expectSameModelWithSmallCache(C_SVC);
+}
+
+/// @brief Test a classification problem without shrinking, so columns
+/// always have every entry
+TEST_F(SVMKernelCacheTest, testClassificationWithoutShrinking)
+{
+  param.shrinking = 0;
+  expectSameModelWithSmallCache(C_SVC);
+}
+
+/// @brief Test a one class problem
+TEST_F(SVMKernelCacheTest, testOneClass)
+{
+  expectSameModelWithSmallCache(ONE_CLASS);
+}
+
+/// @brief Test a regression problem
+TEST_F(SVMKernelCacheTest, testRegression)
+{
+  expectSameModelWithSmallCache(EPSILON_SVR);
+}
+
+/// @brief Test a problem whose solve shrinks often enough to fill the log
+/// of swaps more than once, with caches from one holding every column down
+/// to one holding a few, so that compacting the log both brings columns up
+/// to date and drops them
+TEST_F(SVMKernelCacheTest, testSwapLogCompaction)
+{
+  double cacheSizes[] = { 1, 0.5, 0.1, 0.02 };
+  param.C = 1000;
+  expectSameModelWithCacheSizes(cacheSizes, sizeof(cacheSizes) / sizeof(cacheSizes[0]));
+}
+}
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the weight vectors of linear models
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing the weight vectors of linear
+  /// models
+  class SVMLinearWeightsTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points to train the model with
+    static const int NUM_POINTS = 60;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 7;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds three classes of points shifted along different
+    /// features, leaving out a few zero features
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(4321);
+      problem.l = NUM_POINTS;
+      problem.x = new svm_node*[NUM_POINTS];
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        int label = i % 3;
+        labels.push_back(label);
+        problem.x[i] = new svm_node[NUM_FEATURES+1];
+        int n = 0;
+        for (int k = 0; k < NUM_FEATURES; k++)
+        {
+          double value = random.uniform();
+          if (k == label)
+            value += 0.5;
+          if ((k + i) % 4 == 0)
+            continue;
+          problem.x[i][n].index = k + 1;
+          problem.x[i][n].value = value;
+          n++;
+        }
+        problem.x[i][n].index = -1;
+        problem.x[i][n].value = 0;
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(LINEAR, NUM_FEATURES);
+      param.degree = 1;
+    }
+
+    /// @brief Free the allocated memory
+    virtual void TearDown()
+    {
+      freeRows(problem);
+    }
+
+    /// @brief Expect the decision values from the weight vectors to match
+    /// the ones summed over the support vectors
+    void expectWeightsMatchSVs(svm_model* model, int numDecisions)
+    {
+      ASSERT_TRUE(model->w != NULL);
+      EXPECT_EQ(NUM_FEATURES + 1, model->w_dim);
+
+      std::vector<double> fromWeights(numDecisions);
+      std::vector<double> fromSVs(numDecisions);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        double labelFromWeights = svm_predict_values(model, problem.x[i], &fromWeights[0]);
+
+        // a model without weight vectors predicts from its SVs
+        double** w = model->w;
+        model->w = NULL;
+        double labelFromSVs = svm_predict_values(model, problem.x[i], &fromSVs[0]);
+        model->w = w;
+
+        EXPECT_EQ(labelFromSVs, labelFromWeights);
+        for (int p = 0; p < numDecisions; p++)
+          EXPECT_NEAR(fromSVs[p], fromWeights[p], 1e-9);
+      }
+    }
+  };
+
+  const int SVMLinearWeightsTest::NUM_POINTS;
+  const int SVMLinearWeightsTest::NUM_FEATURES;
+
+/// @brief Each pair of classes gets its own weight vector
+TEST_F(SVMLinearWeightsTest, testClassificationWeights)
+{
+  svm_model* model = svm_train(&problem, &param);
+  ASSERT_EQ(3, model->nr_class);
+  expectWeightsMatchSVs(model, 3);
+  svm_free_and_destroy_model(&model);
+}
+
+/// @brief A one class model has a single weight vector
+TEST_F(SVMLinearWeightsTest, testOneClassWeights)
+{
+  param.svm_type = ONE_CLASS;
+  svm_model* model = svm_train(&problem, &param);
+  expectWeightsMatchSVs(model, 1);
+  svm_free_and_destroy_model(&model);
+}
+
+/// @brief The weight vectors are rebuilt when a model is loaded
+TEST_F(SVMLinearWeightsTest, testLoadedModelWeights)
+{
+  const char* modelFile = "linear_weights_test.model";
+  svm_model* model = svm_train(&problem, &param);
+  ASSERT_EQ(0, svm_save_model(modelFile, model));
+  svm_free_and_destroy_model(&model);
+
+  model = svm_load_model(modelFile);
+  ASSERT_TRUE(model != NULL);
+  expectWeightsMatchSVs(model, 3);
+  svm_free_and_destroy_model(&model);
+  remove(modelFile);
+}
+
+/// @brief Other kernels have no weight vectors
+TEST_F(SVMLinearWeightsTest, testNonLinearKernel)
+{
+  param.kernel_type = RBF;
+  svm_model* model = svm_train(&problem, &param);
+  EXPECT_TRUE(model->w == NULL);
+  svm_free_and_destroy_model(&model);
+}
+}
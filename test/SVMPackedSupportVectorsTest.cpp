@@ -0,0 +1,150 @@
+#include <iostream>
+#include <vector>
+#include <stdio.h>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the packed support vectors of a model
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing the packed support vectors
+  class SVMPackedSupportVectorsTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points to train the model with
+    static const int NUM_POINTS = 30;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 5;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds two overlapping classes of points
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(99);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        labels.push_back((i % 2) ? 1 : -1);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + (i % 2) * 0.2;
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.C = 10;
+    }
+
+    /// @brief Free the allocated memory
+    virtual void TearDown()
+    {
+      freeRows(problem);
+    }
+
+    /// Returns the squared norm of a sparse row
+    static double square(const svm_node* x)
+    {
+      double sum = 0;
+      for (; x->index != -1; ++x)
+        sum += x->value * x->value;
+      return sum;
+    }
+  };
+
+  const int SVMPackedSupportVectorsTest::NUM_POINTS;
+  const int SVMPackedSupportVectorsTest::NUM_FEATURES;
+
+/// @brief A trained model holds its own copy of the SVs, back to back
+TEST_F(SVMPackedSupportVectorsTest, testTrainedModelOwnsSVs)
+{
+  svm_model* model = svm_train(&problem, &param);
+  ASSERT_LT(1, model->l);
+  ASSERT_TRUE(model->sv_space != NULL);
+  ASSERT_TRUE(model->sv_square != NULL);
+
+  const svm_node* next = model->sv_space;
+  for (int i = 0; i < model->l; i++)
+  {
+    EXPECT_EQ(next, model->SV[i]);
+    next = model->SV[i] + NUM_FEATURES + 1;
+    EXPECT_NEAR(square(model->SV[i]), model->sv_square[i], 1e-12);
+  }
+
+  std::vector<double> before(NUM_POINTS);
+  for (int i = 0; i < NUM_POINTS; i++)
+    svm_predict_values(model, problem.x[i], &before[i]);
+
+  // changing the training rows does not change the model
+  std::vector<svm_node*> rows(problem.x, problem.x + NUM_POINTS);
+  std::vector<svm_node> zeros(NUM_FEATURES+1);
+  zeros[0].index = -1;
+  for (int i = 0; i < NUM_POINTS; i++)
+    problem.x[i] = &zeros[0];
+
+  for (int i = 0; i < NUM_POINTS; i++)
+  {
+    double after;
+    svm_predict_values(model, rows[i], &after);
+    EXPECT_DOUBLE_EQ(before[i], after);
+  }
+
+  for (int i = 0; i < NUM_POINTS; i++)
+    problem.x[i] = rows[i];
+  svm_free_and_destroy_model(&model);
+}
+
+/// @brief Predictions from the norms match the full distance
+TEST_F(SVMPackedSupportVectorsTest, testNormsMatchDistance)
+{
+  svm_model* model = svm_train(&problem, &param);
+
+  double* norms = model->sv_square;
+  for (int i = 0; i < NUM_POINTS; i++)
+  {
+    double withNorms, withoutNorms;
+    svm_predict_values(model, problem.x[i], &withNorms);
+    model->sv_square = NULL;
+    svm_predict_values(model, problem.x[i], &withoutNorms);
+    model->sv_square = norms;
+    EXPECT_NEAR(withoutNorms, withNorms, 1e-9);
+  }
+
+  svm_free_and_destroy_model(&model);
+}
+
+/// @brief A loaded model gets the norms of its SVs
+TEST_F(SVMPackedSupportVectorsTest, testLoadedModel)
+{
+  const char* modelFile = "packed_support_vectors_test.model";
+  svm_model* model = svm_train(&problem, &param);
+  ASSERT_EQ(0, svm_save_model(modelFile, model));
+
+  svm_model* loaded = svm_load_model(modelFile);
+  ASSERT_TRUE(loaded != NULL);
+  ASSERT_TRUE(loaded->sv_square != NULL);
+  for (int i = 0; i < loaded->l; i++)
+    EXPECT_NEAR(square(loaded->SV[i]), loaded->sv_square[i], 1e-12);
+
+  // other kernels need no norms
+  param.kernel_type = LINEAR;
+  svm_model* linear = svm_train(&problem, &param);
+  EXPECT_TRUE(linear->sv_square == NULL);
+
+  svm_free_and_destroy_model(&model);
+  svm_free_and_destroy_model(&loaded);
+  svm_free_and_destroy_model(&linear);
+  remove(modelFile);
+}
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <vector>
+#include <svm.h>
+#include <SVMThreadPool.hpp>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for filling kernel columns on several threads
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing training on several threads
+  class SVMParallelColumnsTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points, enough for columns to be split
+    static const int NUM_POINTS = 3000;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 4;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds two overlapping classes of points
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(1357);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        labels.push_back((i % 2) ? 1 : -1);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + (i % 2) * 0.1;
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.cache_size = 1;
+    }
+
+    /// @brief Free the allocated memory and go back to one thread
+    virtual void TearDown()
+    {
+      svm_set_num_threads(1);
+      freeRows(problem);
+    }
+  };
+
+  const int SVMParallelColumnsTest::NUM_POINTS;
+  const int SVMParallelColumnsTest::NUM_FEATURES;
+
+/// @brief Test setting the number of threads
+TEST_F(SVMParallelColumnsTest, testSetNumThreads)
+{
+  EXPECT_EQ(1, svm_get_num_threads());
+  svm_set_num_threads(3);
+  EXPECT_EQ(3, svm_get_num_threads());
+  svm_set_num_threads(0);
+  EXPECT_EQ(1, svm_get_num_threads());
+}
+
+/// @brief Test training on threads of a pool passed by the caller, of
+/// which fewer than the pool has are used, leaving the threads of
+/// svm_set_num_threads as they are
+TEST_F(SVMParallelColumnsTest, testThreadPool)
+{
+  svm_model* serial = svm_train(&problem, &param);
+
+  ThreadPool pool(6);
+  svm_set_num_threads(3);
+  svm_model* lent = svm_train_on(&problem, &param, &pool, 4);
+  EXPECT_EQ(3, svm_get_num_threads());
+
+  expectSameModel(serial, lent);
+
+  svm_free_and_destroy_model(&serial);
+  svm_free_and_destroy_model(&lent);
+}
+
+/// @brief Test a classification problem
+TEST_F(SVMParallelColumnsTest, testClassification)
+{
+  param.svm_type = C_SVC;
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test a classification problem with a cache holding few columns,
+/// so most columns are computed again or taken from the prefetcher
+TEST_F(SVMParallelColumnsTest, testClassificationWithSmallCache)
+{
+  param.cache_size = 0.1;
+  param.svm_type = C_SVC;
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test a one class problem
+TEST_F(SVMParallelColumnsTest, testOneClass)
+{
+  param.svm_type = ONE_CLASS;
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test a regression problem
+TEST_F(SVMParallelColumnsTest, testRegression)
+{
+  param.svm_type = EPSILON_SVR;
+  expectSameModelOnThreads(problem, param, 4);
+}
+}
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for cross validating with the folds trained on several
+/// threads
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing cross validation on several
+  /// threads
+  class SVMParallelCrossValidationTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points
+    static const int NUM_POINTS = 300;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 3;
+
+    /// Number of classes
+    static const int NUM_CLASSES = 3;
+
+    /// Number of ways to fold the sample data
+    static const int NUM_FOLDS = 10;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds overlapping classes of points
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(1717);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        int label = i % NUM_CLASSES;
+        labels.push_back(label);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + ((label == k) ? 0.3 : 0.0);
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.nu = 0.2;
+    }
+
+    /// @brief Free the allocated memory and go back to one thread
+    virtual void TearDown()
+    {
+      svm_set_num_threads(1);
+      freeRows(problem);
+    }
+
+    /// @brief Number of targets equal to the label of their point
+    int numCorrect(const std::vector<double>& targets)
+    {
+      int correct = 0;
+      for (int i = 0; i < NUM_POINTS; i++)
+        if (targets[i] == labels[i])
+          correct++;
+      return correct;
+    }
+  };
+
+  const int SVMParallelCrossValidationTest::NUM_POINTS;
+  const int SVMParallelCrossValidationTest::NUM_FEATURES;
+  const int SVMParallelCrossValidationTest::NUM_CLASSES;
+  const int SVMParallelCrossValidationTest::NUM_FOLDS;
+
+/// @brief Test the stratified folds of C-SVC
+TEST_F(SVMParallelCrossValidationTest, testClassification)
+{
+  expectSameTargetsOnThreads(problem, param, NUM_FOLDS, 7, 4);
+}
+
+/// @brief Test the folds with their one-vs-one probability folds
+TEST_F(SVMParallelCrossValidationTest, testProbability)
+{
+  param.probability = 1;
+  expectSameTargetsOnThreads(problem, param, NUM_FOLDS, 7, 4);
+}
+
+/// @brief Test the unstratified folds of epsilon-SVR with the folds of its
+/// probability model
+TEST_F(SVMParallelCrossValidationTest, testRegression)
+{
+  param.svm_type = EPSILON_SVR;
+  param.probability = 1;
+  expectSameTargetsOnThreads(problem, param, NUM_FOLDS, 7, 4);
+}
+
+/// @brief Test that one seed always gives the same targets and that they
+/// are better than chance
+TEST_F(SVMParallelCrossValidationTest, testSameSeed)
+{
+  std::vector<double> first(NUM_POINTS), second(NUM_POINTS);
+
+  svm_set_num_threads(4);
+  svm_cross_validation_seeded(&problem, &param, NUM_FOLDS, &first[0], 11);
+  svm_cross_validation_seeded(&problem, &param, NUM_FOLDS, &second[0], 11);
+
+  expectSameTargets(first, second);
+  EXPECT_GT(numCorrect(first), NUM_POINTS / NUM_CLASSES);
+}
+
+/// @brief Test that svm_cross_validation, seeded with srand, does not
+/// depend on the number of threads
+TEST_F(SVMParallelCrossValidationTest, testUnseeded)
+{
+  std::vector<double> serial(NUM_POINTS), parallel(NUM_POINTS);
+
+  svm_set_num_threads(1);
+  srand(3);
+  svm_cross_validation(&problem, &param, NUM_FOLDS, &serial[0]);
+  svm_set_num_threads(4);
+  srand(3);
+  svm_cross_validation(&problem, &param, NUM_FOLDS, &parallel[0]);
+
+  expectSameTargets(serial, parallel);
+}
+}
@@ -0,0 +1,148 @@
+#include <iostream>
+#include <vector>
+#include <pthread.h>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for training one-vs-one problems and probability folds
+/// on several threads
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing multi class training on
+  /// several threads
+  class SVMParallelPairsTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points
+    static const int NUM_POINTS = 400;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 4;
+
+    /// Number of classes
+    static const int NUM_CLASSES = 4;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds overlapping classes of points
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(4242);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        int label = i % NUM_CLASSES;
+        labels.push_back(label);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + ((label == k) ? 0.3 : 0.0);
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.nu = 0.2;
+    }
+
+    /// @brief Free the allocated memory and go back to one thread
+    virtual void TearDown()
+    {
+      svm_set_num_threads(1);
+      freeRows(problem);
+    }
+  };
+
+  /// @brief A call of svm_train run on a thread of its own
+  struct TrainCall
+  {
+    /// The problem trained on
+    const svm_problem* problem;
+
+    /// The parameters trained with
+    const svm_parameter* param;
+
+    /// Receives the trained model
+    svm_model* model;
+  };
+
+  /// @brief Thread function running the TrainCall it is given
+  static void* trainOnThread(void* context)
+  {
+    TrainCall* call = static_cast<TrainCall*>(context);
+    call->model = svm_train(call->problem, call->param);
+    return NULL;
+  }
+
+  const int SVMParallelPairsTest::NUM_POINTS;
+  const int SVMParallelPairsTest::NUM_FEATURES;
+  const int SVMParallelPairsTest::NUM_CLASSES;
+
+/// @brief Test the one-vs-one problems of C-SVC
+TEST_F(SVMParallelPairsTest, testClassification)
+{
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test the one-vs-one problems of nu-SVC
+TEST_F(SVMParallelPairsTest, testNuClassification)
+{
+  param.svm_type = NU_SVC;
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test the one-vs-one problems with their probability folds
+TEST_F(SVMParallelPairsTest, testProbability)
+{
+  param.probability = 1;
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test the probability folds of a single pair, which are trained
+/// on several threads themselves
+TEST_F(SVMParallelPairsTest, testBinaryProbability)
+{
+  for (int i = 0; i < NUM_POINTS; i++)
+    labels[i] = (labels[i] < 2) ? 0 : 1;
+  param.probability = 1;
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test calls of svm_train on several threads at once, which share
+/// the pool but not the state of each other's pairs
+TEST_F(SVMParallelPairsTest, testConcurrentCalls)
+{
+  const int numCalls = 3;
+
+  svm_set_num_threads(1);
+  svm_model* serial = svm_train(&problem, &param);
+
+  svm_set_num_threads(4);
+  TrainCall calls[numCalls];
+  pthread_t threads[numCalls];
+  for (int t = 0; t < numCalls; t++)
+  {
+    calls[t].problem = &problem;
+    calls[t].param = &param;
+    calls[t].model = NULL;
+    ASSERT_EQ(0, pthread_create(&threads[t], NULL, &trainOnThread, &calls[t]));
+  }
+  for (int t = 0; t < numCalls; t++)
+    pthread_join(threads[t], NULL);
+
+  for (int t = 0; t < numCalls; t++)
+  {
+    expectSameModel(serial, calls[t].model);
+    svm_free_and_destroy_model(&calls[t].model);
+  }
+  svm_free_and_destroy_model(&serial);
+}
+}
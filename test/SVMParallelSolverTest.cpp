@@ -0,0 +1,78 @@
+#include <iostream>
+#include <vector>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the solver loops split across threads
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing the solver on several threads
+  class SVMParallelSolverTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points, enough for the solver loops to be split
+    static const int NUM_POINTS = 34000;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 2;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds two classes of points separated along the first
+    /// feature, so the problem is solved in few iterations
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(97);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        double label = (i % 2) ? 1 : -1;
+        labels.push_back(label);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform();
+        problem.x[i][0].value = label * (0.2 + problem.x[i][0].value);
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(LINEAR, NUM_FEATURES);
+      param.cache_size = 1;
+      param.nu = 0.01;
+    }
+
+    /// @brief Free the allocated memory and go back to one thread
+    virtual void TearDown()
+    {
+      svm_set_num_threads(1);
+      freeRows(problem);
+    }
+  };
+
+  const int SVMParallelSolverTest::NUM_POINTS;
+  const int SVMParallelSolverTest::NUM_FEATURES;
+
+/// @brief Test the working set selection of C-SVC
+TEST_F(SVMParallelSolverTest, testClassification)
+{
+  param.svm_type = C_SVC;
+  expectSameModelOnThreads(problem, param, 4);
+}
+
+/// @brief Test the working set selection of nu-SVC, picking one variable
+/// of each class
+TEST_F(SVMParallelSolverTest, testNuClassification)
+{
+  param.svm_type = NU_SVC;
+  expectSameModelOnThreads(problem, param, 4);
+}
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <vector>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the svm_predict_batch function
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing the svm_predict_batch function
+  class SVMPredictBatchTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points, not a multiple of the block size
+    static const int NUM_POINTS = 53;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 6;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points, as sparse rows
+    svm_problem problem;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds three overlapping classes of points
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(777);
+      allocateRows(problem, NUM_POINTS, NUM_FEATURES);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        int label = i % 3;
+        labels.push_back(label);
+        for (int k = 0; k < NUM_FEATURES; k++)
+          problem.x[i][k].value = random.uniform() + ((k == label) ? 0.3 : 0);
+      }
+      problem.y = &labels[0];
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.C = 10;
+    }
+
+    /// @brief Free the allocated memory
+    virtual void TearDown()
+    {
+      freeRows(problem);
+    }
+
+    /// @brief Expect a batch prediction to match predicting each sample
+    void expectBatchMatchesSingle(int numDecisions)
+    {
+      svm_model* model = svm_train(&problem, &param);
+
+      std::vector<double> batchLabels(NUM_POINTS);
+      std::vector<double> batchValues(NUM_POINTS * numDecisions);
+      svm_predict_batch(model, problem.x, NUM_POINTS, &batchLabels[0], &batchValues[0]);
+
+      std::vector<double> values(numDecisions);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        EXPECT_EQ(svm_predict_values(model, problem.x[i], &values[0]), batchLabels[i]);
+        for (int p = 0; p < numDecisions; p++)
+          EXPECT_DOUBLE_EQ(values[p], batchValues[i*numDecisions+p]);
+      }
+
+      // the decision values are optional
+      std::vector<double> labelsOnly(NUM_POINTS);
+      svm_predict_batch(model, problem.x, NUM_POINTS, &labelsOnly[0], NULL);
+      EXPECT_EQ(batchLabels, labelsOnly);
+
+      svm_free_and_destroy_model(&model);
+    }
+  };
+
+  const int SVMPredictBatchTest::NUM_POINTS;
+  const int SVMPredictBatchTest::NUM_FEATURES;
+
+/// @brief Test a batch with a multi class kernel model
+TEST_F(SVMPredictBatchTest, testClassification)
+{
+  expectBatchMatchesSingle(3);
+}
+
+/// @brief Test a batch with a linear model using its weight vectors
+TEST_F(SVMPredictBatchTest, testLinearClassification)
+{
+  param.kernel_type = LINEAR;
+  expectBatchMatchesSingle(3);
+}
+
+/// @brief Test a batch with a polynomial kernel model
+TEST_F(SVMPredictBatchTest, testPolynomialClassification)
+{
+  param.kernel_type = POLY;
+  param.degree = 3;
+  expectBatchMatchesSingle(3);
+}
+
+/// @brief Test a batch with a sigmoid kernel model
+TEST_F(SVMPredictBatchTest, testSigmoidClassification)
+{
+  param.kernel_type = SIGMOID;
+  expectBatchMatchesSingle(3);
+}
+
+/// @brief Test a batch with a model having a single decision function
+TEST_F(SVMPredictBatchTest, testOneClass)
+{
+  param.svm_type = ONE_CLASS;
+  expectBatchMatchesSingle(1);
+}
+
+/// @brief Test a batch with a regression model
+TEST_F(SVMPredictBatchTest, testRegression)
+{
+  param.svm_type = EPSILON_SVR;
+  expectBatchMatchesSingle(1);
+}
+
+/// @brief An empty batch does nothing
+TEST_F(SVMPredictBatchTest, testEmptyBatch)
+{
+  svm_model* model = svm_train(&problem, &param);
+  svm_predict_batch(model, problem.x, 0, NULL, NULL);
+  svm_free_and_destroy_model(&model);
+}
+}
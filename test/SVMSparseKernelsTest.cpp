@@ -0,0 +1,149 @@
+#include <iostream>
+#include <vector>
+#include <svm.h>
+#include <gtest/gtest.h>
+#include "SVMTestData.hpp"
+
+/// @file
+/// @brief Tests for the sparse kernel evaluations of the svm library
+namespace SVMLibraryTests
+{
+  /// @brief Google test fixture for testing the sparse kernels against the
+  /// dense ones
+  class SVMSparseKernelsTest: public ::testing::Test
+  {
+    protected:
+    /// Number of sample data points to train the model with
+    static const int NUM_POINTS = 40;
+
+    /// Number of features of each data point
+    static const int NUM_FEATURES = 200;
+
+    /// The features of every data point, mostly zeros
+    std::vector<float> features;
+
+    /// The labels of every data point
+    std::vector<double> labels;
+
+    /// The data points as sparse rows
+    svm_problem sparse;
+
+    /// The data points as dense rows
+    svm_problem dense;
+
+    /// The parameters used when training the models
+    svm_parameter param;
+
+    /// @brief Builds rows of very different lengths: every fourth row has
+    /// nearly every feature set, the others only a few
+    virtual void SetUp()
+    {
+      svm_set_print_string_function(quietPrint);
+
+      TestRandom random(2468);
+      features.assign(NUM_POINTS * NUM_FEATURES, 0.0f);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        labels.push_back((i % 2) ? 1 : -1);
+        int density = (i % 4 == 0) ? 95 : 3;
+        for (int k = 0; k < NUM_FEATURES; k++)
+        {
+          unsigned int seed = random.next();
+          if ((int) ((seed >> 16) % 100) < density)
+            features[i*NUM_FEATURES+k] = ((seed >> 8) % 100) / 100.0f + (i % 2) * 0.1f;
+        }
+      }
+
+      sparse.l = NUM_POINTS;
+      sparse.y = &labels[0];
+      sparse.x = new svm_node*[NUM_POINTS];
+      dense.l = NUM_POINTS;
+      dense.y = &labels[0];
+      dense.x = new svm_node*[NUM_POINTS];
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        sparse.x[i] = sparseRow(&features[i*NUM_FEATURES], NUM_FEATURES);
+        dense.x[i] = denseRow(&features[i*NUM_FEATURES], NUM_FEATURES);
+      }
+
+      param = defaultParameters(RBF, NUM_FEATURES);
+      param.gamma = 0.05;
+      param.coef0 = 1;
+    }
+
+    /// @brief Free the allocated memory
+    virtual void TearDown()
+    {
+      freeRows(sparse);
+      freeRows(dense);
+    }
+
+    /// @brief Expect the model trained on sparse rows to match the one
+    /// trained on dense rows
+    void expectSameModel(int svmType, int kernelType)
+    {
+      param.svm_type = svmType;
+      param.kernel_type = kernelType;
+
+      svm_model* sparseModel = svm_train(&sparse, &param);
+      svm_model* denseModel = svm_train(&dense, &param);
+
+      EXPECT_EQ(denseModel->l, sparseModel->l);
+      EXPECT_NEAR(denseModel->rho[0], sparseModel->rho[0], 1e-6);
+      for (int i = 0; i < NUM_POINTS; i++)
+      {
+        double fromSparse, fromDense;
+        svm_predict_values(sparseModel, sparse.x[i], &fromSparse);
+        svm_predict_values(denseModel, dense.x[i], &fromDense);
+        EXPECT_NEAR(fromDense, fromSparse, 1e-6);
+      }
+
+      svm_free_and_destroy_model(&sparseModel);
+      svm_free_and_destroy_model(&denseModel);
+    }
+  };
+
+  const int SVMSparseKernelsTest::NUM_POINTS;
+  const int SVMSparseKernelsTest::NUM_FEATURES;
+
+/// @brief Test the sparse kernels of a classification problem
+TEST_F(SVMSparseKernelsTest, testClassification)
+{
+  expectSameModel(C_SVC, LINEAR);
+  expectSameModel(C_SVC, POLY);
+  expectSameModel(C_SVC, RBF);
+}
+
+/// @brief Test the sparse kernels of a one class problem
+TEST_F(SVMSparseKernelsTest, testOneClass)
+{
+  expectSameModel(ONE_CLASS, RBF);
+}
+
+/// @brief Test the sparse kernels of a regression problem
+TEST_F(SVMSparseKernelsTest, testRegression)
+{
+  expectSameModel(EPSILON_SVR, RBF);
+}
+
+/// @brief Test sparse rows whose indices are too large for a dense
+/// scratch row, which are merged instead of scattered
+TEST_F(SVMSparseKernelsTest, testLargeIndices)
+{
+  svm_model* model = svm_train(&sparse, &param);
+
+  // the same rows with every index moved past the scratch
+  for (int i = 0; i < NUM_POINTS; i++)
+    for (svm_node* p = sparse.x[i]; p->index != -1; ++p)
+      p->index += 1 << 20;
+  svm_model* shifted = svm_train(&sparse, &param);
+
+  EXPECT_EQ(model->l, shifted->l);
+  EXPECT_NEAR(model->rho[0], shifted->rho[0], 1e-6);
+  for (int i = 0; i < model->l; i++)
+    EXPECT_NEAR(model->sv_coef[0][i], shifted->sv_coef[0][i], 1e-6);
+
+  svm_free_and_destroy_model(&model);
+  svm_free_and_destroy_model(&shifted);
+}
+}
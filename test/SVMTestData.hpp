@@ -0,0 +1,211 @@
+#ifndef SVM_TEST_DATA_HPP
+#define SVM_TEST_DATA_HPP
+
+#include <vector>
+#include <stdlib.h>
+#include <svm.h>
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Sample data and comparisons shared by the tests of the svm
+/// library
+namespace SVMLibraryTests
+{
+  /// @brief Stream of pseudo random numbers, the same on every platform so
+  /// the sample problems do not depend on the C library
+  class TestRandom
+  {
+    public:
+    /// @brief Constructor
+    /// @param seed
+    ///        The state the stream starts from
+    explicit TestRandom(unsigned int seed) : state(seed) {}
+
+    /// Returns the next state of the linear congruential generator
+    unsigned int next()
+    {
+      state = state * 1103515245 + 12345;
+      return state;
+    }
+
+    /// Returns the next value in [0,1), in steps of 0.001
+    double uniform()
+    {
+      return ((next() >> 16) % 1000) / 1000.0;
+    }
+
+    private:
+    /// The last state of the generator
+    unsigned int state;
+  };
+
+  /// @brief Print function suppressing the output of the svm library
+  inline void quietPrint(const char*) { }
+
+  /// @brief Returns the parameters the tests train with unless they set
+  /// others: C-SVC with C of 1 and gamma of one over the number of features
+  /// @param kernelType
+  ///        The kernel of the parameters
+  /// @param numFeatures
+  ///        The number of features of each data point
+  inline svm_parameter defaultParameters(int kernelType, int numFeatures)
+  {
+    svm_parameter param;
+    param.svm_type = C_SVC;
+    param.kernel_type = kernelType;
+    param.degree = 2;
+    param.gamma = 1.0 / numFeatures;
+    param.coef0 = 0;
+    param.cache_size = 10;
+    param.eps = 0.001;
+    param.C = 1;
+    param.nr_weight = 0;
+    param.weight_label = NULL;
+    param.weight = NULL;
+    param.nu = 0.5;
+    param.p = 0.1;
+    param.shrinking = 1;
+    param.probability = 0;
+    return param;
+  }
+
+  /// @brief Allocate the rows of a problem with every feature at indices 1
+  /// to numFeatures, valued 0
+  /// @param problem
+  ///        Receives the rows; the labels are left to the caller
+  /// @param numPoints
+  ///        The number of rows
+  /// @param numFeatures
+  ///        The number of features of each row
+  inline void allocateRows(svm_problem& problem, int numPoints, int numFeatures)
+  {
+    problem.l = numPoints;
+    problem.x = new svm_node*[numPoints];
+    for (int i = 0; i < numPoints; i++)
+    {
+      problem.x[i] = new svm_node[numFeatures+1];
+      for (int k = 0; k < numFeatures; k++)
+      {
+        problem.x[i][k].index = k + 1;
+        problem.x[i][k].value = 0;
+      }
+      problem.x[i][numFeatures].index = -1;
+      problem.x[i][numFeatures].value = 0;
+    }
+  }
+
+  /// @brief Returns a sparse row of the nonzero values, feature k at index
+  /// k, allocated with new[]
+  inline svm_node* sparseRow(const float* values, int numFeatures)
+  {
+    svm_node* row = new svm_node[numFeatures+1];
+    int n = 0;
+    for (int k = 0; k < numFeatures; k++)
+    {
+      if (values[k] != 0)
+      {
+        row[n].index = k;
+        row[n].value = values[k];
+        n++;
+      }
+    }
+    row[n].index = -1;
+    row[n].value = 0;
+    return row;
+  }
+
+  /// @brief Returns a dense row of the values, allocated with new[]
+  inline svm_node* denseRow(const float* values, int numFeatures)
+  {
+    svm_node* row = new svm_node[svm_dense_row_nodes(numFeatures)];
+    svm_fill_dense_row(row, values, numFeatures);
+    return row;
+  }
+
+  /// @brief Free the rows of a problem allocated with new[]
+  inline void freeRows(svm_problem& problem)
+  {
+    for (int i = 0; i < problem.l; i++)
+      delete [] problem.x[i];
+    delete [] problem.x;
+    problem.x = NULL;
+  }
+
+  /// @brief Expect two models to have exactly the same support vectors,
+  /// coefficients, offsets and probability estimates
+  inline void expectSameModel(const svm_model* expected, const svm_model* actual)
+  {
+    ASSERT_EQ(expected->nr_class, actual->nr_class);
+    ASSERT_EQ(expected->l, actual->l);
+
+    int numDecisions = (expected->nr_class < 2) ? 1 : expected->nr_class * (expected->nr_class - 1) / 2;
+    for (int p = 0; p < numDecisions; p++)
+      EXPECT_EQ(expected->rho[p], actual->rho[p]);
+    if (expected->probA != NULL)
+    {
+      ASSERT_TRUE(actual->probA != NULL);
+      for (int p = 0; p < numDecisions; p++)
+        EXPECT_EQ(expected->probA[p], actual->probA[p]);
+    }
+    if (expected->probB != NULL)
+    {
+      ASSERT_TRUE(actual->probB != NULL);
+      for (int p = 0; p < numDecisions; p++)
+        EXPECT_EQ(expected->probB[p], actual->probB[p]);
+    }
+
+    int numCoefs = (expected->nr_class < 2) ? 1 : expected->nr_class - 1;
+    for (int c = 0; c < numCoefs; c++)
+      for (int i = 0; i < expected->l; i++)
+        EXPECT_EQ(expected->sv_coef[c][i], actual->sv_coef[c][i]);
+    if (expected->sv_indices != NULL && actual->sv_indices != NULL)
+    {
+      for (int i = 0; i < expected->l; i++)
+        EXPECT_EQ(expected->sv_indices[i], actual->sv_indices[i]);
+    }
+  }
+
+  /// @brief Expect two runs of cross validation to give exactly the same
+  /// targets
+  inline void expectSameTargets(const std::vector<double>& expected, const std::vector<double>& actual)
+  {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (unsigned int i = 0; i < expected.size(); i++)
+      EXPECT_EQ(expected[i], actual[i]);
+  }
+
+  /// @brief Expect training on numThreads threads to give exactly the model
+  /// trained on one thread, with the same srand seed for the probability
+  /// folds; the library is left with numThreads threads
+  inline void expectSameModelOnThreads(const svm_problem& problem, const svm_parameter& param, int numThreads)
+  {
+    svm_set_num_threads(1);
+    srand(1);
+    svm_model* serial = svm_train(&problem, &param);
+    svm_set_num_threads(numThreads);
+    srand(1);
+    svm_model* parallel = svm_train(&problem, &param);
+
+    expectSameModel(serial, parallel);
+
+    svm_free_and_destroy_model(&serial);
+    svm_free_and_destroy_model(&parallel);
+  }
+
+  /// @brief Expect cross validating on numThreads threads to give exactly
+  /// the targets found on one thread from the same seed; the library is
+  /// left with numThreads threads
+  inline void expectSameTargetsOnThreads(const svm_problem& problem, const svm_parameter& param, int numFolds, unsigned int seed, int numThreads)
+  {
+    std::vector<double> serial(problem.l), parallel(problem.l);
+
+    svm_set_num_threads(1);
+    svm_cross_validation_seeded(&problem, &param, numFolds, &serial[0], seed);
+    svm_set_num_threads(numThreads);
+    svm_cross_validation_seeded(&problem, &param, numFolds, &parallel[0], seed);
+
+    expectSameTargets(serial, parallel);
+  }
+}
+
+#endif
@@ -0,0 +1,302 @@
+#include <iostream>
+#include <set>
+#include <vector>
+#include <stdexcept>
+#include <sys/time.h>
+#include <unistd.h>
+#include <ThreadPool.hpp>
+
+#include <gtest/gtest.h>
+
+/// @file
+/// @brief Tests for the ThreadPool class
+namespace TestHOGCV
+{
+  /// @brief Google test fixture class to test the thread pool
+  class ThreadPoolTest : public ::testing::Test
+  {
+    protected:
+    /// @brief Writes the square of the index into the vector passed as the
+    /// context
+    static void square(void* context, int index)
+    {
+      (*static_cast<std::vector<int>*>(context))[index] = index * index;
+    }
+
+    /// @brief Throws for odd indices
+    static void failOdd(void* context, int index)
+    {
+      (*static_cast<std::vector<int>*>(context))[index] = 1;
+      if (index % 2)
+      {
+        throw std::invalid_argument("odd");
+      }
+    }
+
+    /// @brief The threads that ran iterations of a loop
+    struct Threads
+    {
+      /// Protects ids
+      pthread_mutex_t mutex;
+
+      /// The threads seen
+      std::set<pthread_t> ids;
+    };
+
+    /// @brief Records the thread running the iteration in the Threads
+    /// passed as the context, holding it long enough for the others to
+    /// take part
+    static void recordThread(void* context, int)
+    {
+      Threads* threads = static_cast<Threads*>(context);
+      pthread_mutex_lock(&threads->mutex);
+      threads->ids.insert(pthread_self());
+      pthread_mutex_unlock(&threads->mutex);
+      usleep(1000);
+    }
+
+    /// @brief Iterations that each wait for all of them to start
+    struct Rendezvous
+    {
+      /// Protects arrived
+      pthread_mutex_t mutex;
+
+      /// Signalled when an iteration arrives
+      pthread_cond_t changed;
+
+      /// The number of iterations that arrived
+      int arrived;
+
+      /// The number of iterations
+      int count;
+
+      /// Set if an iteration gave up waiting for the others
+      bool timedOut;
+    };
+
+    /// @brief Waits up to a few seconds for every iteration of the
+    /// Rendezvous passed as the context to arrive
+    static void meet(void* context, int)
+    {
+      Rendezvous* rendezvous = static_cast<Rendezvous*>(context);
+      struct timeval now;
+      gettimeofday(&now, NULL);
+      struct timespec deadline;
+      deadline.tv_sec = now.tv_sec + 5;
+      deadline.tv_nsec = now.tv_usec * 1000;
+
+      pthread_mutex_lock(&rendezvous->mutex);
+      rendezvous->arrived++;
+      pthread_cond_broadcast(&rendezvous->changed);
+      while (rendezvous->arrived < rendezvous->count && !rendezvous->timedOut)
+      {
+        if (pthread_cond_timedwait(&rendezvous->changed, &rendezvous->mutex, &deadline) != 0)
+        {
+          rendezvous->timedOut = true;
+        }
+      }
+      pthread_mutex_unlock(&rendezvous->mutex);
+    }
+
+    /// @brief A pool and a Rendezvous for the inner loop of each iteration
+    /// of an outer loop
+    struct NestedRendezvous
+    {
+      /// The pool running both loops
+      ThreadPool* pool;
+
+      /// The rendezvous of the inner loop of each outer iteration
+      Rendezvous rendezvous[2];
+    };
+
+    /// @brief Runs an inner loop of two iterations waiting for each other
+    /// on the Rendezvous of the outer iteration
+    static void meetInInnerLoop(void* context, int index)
+    {
+      NestedRendezvous* nested = static_cast<NestedRendezvous*>(context);
+      nested->pool->parallelFor(2, &ThreadPoolTest::meet, &nested->rendezvous[index]);
+    }
+
+    /// @brief Starts a concurrent loop from inside an iteration, which
+    /// must fail
+    static void nestConcurrently(void* context, int)
+    {
+      ThreadPool* pool = static_cast<ThreadPool*>(context);
+      std::vector<int> results(2, 0);
+      EXPECT_THROW(pool->runConcurrently(2, &ThreadPoolTest::square, &results), std::logic_error);
+    }
+
+    /// @brief Functor starting an inner loop from every iteration
+    struct Nested
+    {
+      /// The pool running both loops
+      ThreadPool* pool;
+
+      /// Sums of the inner loops, one per outer iteration
+      std::vector<int> sums;
+
+      /// @brief Run an inner loop and store the sum of its results
+      void operator()(int index)
+      {
+        std::vector<int> inner(index + 1);
+        pool->parallelFor((int) inner.size(), &ThreadPoolTest::square, &inner);
+        int sum = 0;
+        for (unsigned int i = 0; i < inner.size(); i++)
+          sum += inner[i];
+        sums[index] = sum;
+      }
+    };
+  };
+
+/// @brief Every iteration runs once and writes to its own slot
+TEST_F(ThreadPoolTest, testParallelForRunsEveryIteration)
+{
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.size());
+
+  // reuse the same workers for several loops of different sizes
+  for (int count = 0; count < 200; count += 7)
+  {
+    std::vector<int> results(count, -1);
+    pool.parallelFor(count, &ThreadPoolTest::square, &results);
+    for (int i = 0; i < count; i++)
+      ASSERT_EQ(i*i, results[i]);
+  }
+}
+
+/// @brief A single threaded pool runs on the caller
+TEST_F(ThreadPoolTest, testSingleThread)
+{
+  ThreadPool pool(1);
+  std::vector<int> results(10, -1);
+
+  EXPECT_EQ(1, pool.size());
+  pool.parallelFor(10, &ThreadPoolTest::square, &results);
+  for (int i = 0; i < 10; i++)
+    EXPECT_EQ(i*i, results[i]);
+}
+
+/// @brief Loops started from an iteration run every one of their
+/// iterations once
+TEST_F(ThreadPoolTest, testNestedLoops)
+{
+  ThreadPool pool(3);
+  Nested nested;
+  nested.pool = &pool;
+  nested.sums.assign(20, -1);
+
+  pool.parallelFor(20, nested);
+
+  for (int n = 0; n < 20; n++)
+    EXPECT_EQ(n*(n+1)*(2*n+1)/6, nested.sums[n]);
+}
+
+/// @brief Loops started from iterations run on the workers the outer loop
+/// leaves free, at the same time as each other
+TEST_F(ThreadPoolTest, testNestedLoopsUseFreeWorkers)
+{
+  ThreadPool pool(4);
+  NestedRendezvous nested;
+  nested.pool = &pool;
+  for (int i = 0; i < 2; i++)
+  {
+    pthread_mutex_init(&nested.rendezvous[i].mutex, NULL);
+    pthread_cond_init(&nested.rendezvous[i].changed, NULL);
+    nested.rendezvous[i].arrived = 0;
+    nested.rendezvous[i].count = 2;
+    nested.rendezvous[i].timedOut = false;
+  }
+
+  pool.parallelFor(2, &ThreadPoolTest::meetInInnerLoop, &nested, 2);
+
+  for (int i = 0; i < 2; i++)
+  {
+    EXPECT_EQ(2, nested.rendezvous[i].arrived);
+    EXPECT_FALSE(nested.rendezvous[i].timedOut);
+    pthread_cond_destroy(&nested.rendezvous[i].changed);
+    pthread_mutex_destroy(&nested.rendezvous[i].mutex);
+  }
+}
+
+/// @brief A loop limited to fewer threads than the pool stays within them
+TEST_F(ThreadPoolTest, testThreadLimit)
+{
+  ThreadPool pool(4);
+  Threads threads;
+  pthread_mutex_init(&threads.mutex, NULL);
+
+  pool.parallelFor(40, &ThreadPoolTest::recordThread, &threads, 2);
+  EXPECT_GE(2u, threads.ids.size());
+
+  // a limit of one runs the loop on the caller
+  threads.ids.clear();
+  pool.parallelFor(10, &ThreadPoolTest::recordThread, &threads, 1);
+  ASSERT_EQ(1u, threads.ids.size());
+  EXPECT_TRUE(pthread_equal(pthread_self(), *threads.ids.begin()));
+
+  // the limit does not stay with the pool
+  std::vector<int> results(50, 0);
+  pool.parallelFor(50, &ThreadPoolTest::square, &results);
+  for (int i = 0; i < 50; i++)
+    EXPECT_EQ(i*i, results[i]);
+
+  pthread_mutex_destroy(&threads.mutex);
+}
+
+/// @brief Iterations waiting for each other each get a thread
+TEST_F(ThreadPoolTest, testRunConcurrently)
+{
+  ThreadPool pool(4);
+  Rendezvous rendezvous;
+  pthread_mutex_init(&rendezvous.mutex, NULL);
+  pthread_cond_init(&rendezvous.changed, NULL);
+
+  for (int count = 1; count <= 4; count++)
+  {
+    rendezvous.arrived = 0;
+    rendezvous.count = count;
+    rendezvous.timedOut = false;
+    pool.runConcurrently(count, &ThreadPoolTest::meet, &rendezvous);
+    EXPECT_EQ(count, rendezvous.arrived);
+    EXPECT_FALSE(rendezvous.timedOut);
+  }
+
+  pthread_cond_destroy(&rendezvous.changed);
+  pthread_mutex_destroy(&rendezvous.mutex);
+}
+
+/// @brief A concurrent loop the pool cannot give a thread per iteration
+/// fails instead of running serially
+TEST_F(ThreadPoolTest, testRunConcurrentlyWithoutThreads)
+{
+  ThreadPool pool(3);
+  std::vector<int> results(4, 0);
+
+  EXPECT_THROW(pool.runConcurrently(4, &ThreadPoolTest::square, &results), std::logic_error);
+  for (int i = 0; i < 4; i++)
+    EXPECT_EQ(0, results[i]);
+
+  pool.parallelFor(2, &ThreadPoolTest::nestConcurrently, &pool);
+}
+
+/// @brief Exceptions are reported after every iteration has run
+TEST_F(ThreadPoolTest, testExceptionsAreReported)
+{
+  ThreadPool pool(4);
+  std::vector<int> results(50, 0);
+
+  EXPECT_THROW(pool.parallelFor(50, &ThreadPoolTest::failOdd, &results), std::runtime_error);
+  for (int i = 0; i < 50; i++)
+    EXPECT_EQ(1, results[i]);
+
+  // the pool is usable after a failed loop
+  pool.parallelFor(50, &ThreadPoolTest::square, &results);
+  EXPECT_EQ(49*49, results[49]);
+}
+
+/// @brief Invalid thread counts are rejected
+TEST_F(ThreadPoolTest, testConstructorWithInvalidThreads)
+{
+  EXPECT_THROW(ThreadPool(0), std::invalid_argument);
+}
+}